@@ -7,6 +7,7 @@
 , wrapQtAppsHook
 , qtbase
 , qtquick3d
+, qtshadertools
 , qwlroots
 , wayland
 , wayland-protocols
@@ -47,6 +48,7 @@ stdenv.mkDerivation (finalAttrs: {
     pkg-config
     wayland-scanner
     wrapQtAppsHook
+    qtshadertools
   ];
 
   buildInputs = [
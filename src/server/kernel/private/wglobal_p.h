@@ -5,6 +5,8 @@
 #include "wglobal.h"
 #include <qwobject.h>
 #include <QPointer>
+#include <QVarLengthArray>
+#include <QHash>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -30,6 +32,8 @@ protected:
 
     WObject *q_ptr;
     QList<std::pair<const void*, void*>> attachedDatas;
+    // Indexed by WObject::attachedDataSlot
+    QVarLengthArray<void*, 4> attachedDataSlots;
 
     W_DECLARE_PUBLIC(WObject)
 };
@@ -52,7 +56,11 @@ protected:
     void invalidate();
     virtual void instantRelease() {}
 
-    QList<QMetaObject::Connection> connectionsWithHandle;
+    void addConnectionWithHandle(const QMetaObject::Connection &connection);
+    bool takeConnectionWithHandle(const QMetaObject::Connection &connection);
+
+    // Grouped by the receiver, and keyed by the private of QMetaObject::Connection
+    QHash<const QObject*, QHash<const void*, QMetaObject::Connection>> connectionsWithHandle;
     QPointer<QW_NAMESPACE::qw_object_basic> m_handle;
     uint invalidated:1;
 };
@@ -29,14 +29,26 @@ public:
 
     void initSocket(WSocket *socketServer);
 
+    // The handle and the global of a WServerInterface are only changed by
+    // its create/destroy, so rebuild the index after attach/detach, start/stop.
+    inline void markInterfaceIndexDirty() {
+        interfaceIndexDirty = true;
+    }
+    void ensureInterfaceIndex();
+
     W_DECLARE_PUBLIC(WServer)
     std::unique_ptr<QSocketNotifier> sockNot;
 
     QVector<WServerInterface*> interfaceList;
     WServerInterface *pendingInterface = nullptr;
+    // for WServer::findInterface
+    QHash<const wl_global*, WServerInterface*> globalIndex;
+    QHash<void*, QVector<WServerInterface*>> handleIndex;
+    bool interfaceIndexDirty = true;
 
     std::unique_ptr<QW_NAMESPACE::qw_display> display;
     wl_event_loop *loop = nullptr;
+    bool running = false;
 
     QList<WSocket*> sockets;
 
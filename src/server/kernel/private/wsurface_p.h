@@ -11,6 +11,7 @@
 
 #include <QObject>
 #include <QPointer>
+#include <QRegion>
 
 struct wlr_surface;
 struct wlr_subsurface;
@@ -62,6 +63,7 @@ public:
     QVector<WOutput*> outputs;
     QMetaObject::Connection frameDoneConnection;
     QPoint bufferOffset;
+    QRegion bufferDamage;
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -8,6 +8,8 @@
 #include <private/qobject_p_p.h>
 #include <QCursor>
 #include <QLoggingCategory>
+#include <QMutex>
+#include <QHash>
 
 #ifdef QT_DEBUG
 Q_LOGGING_CATEGORY(lcGeneral, "waylib.general", QtDebugMsg);
@@ -41,6 +43,41 @@ int WObject::indexOfAttachedData(const void *owner) const
     return d->indexOfAttachedData(owner);
 }
 
+void *WObject::attachedDataAt(int slot) const
+{
+    W_DC(WObject);
+    return slot < d->attachedDataSlots.size() ? d->attachedDataSlots.at(slot) : nullptr;
+}
+
+void WObject::setAttachedDataAt(int slot, void *data)
+{
+    W_D(WObject);
+    Q_ASSERT(slot >= 0);
+    if (slot >= d->attachedDataSlots.size()) {
+        if (!data)
+            return;
+        while (d->attachedDataSlots.size() <= slot)
+            d->attachedDataSlots.append(nullptr);
+    }
+    d->attachedDataSlots[slot] = data;
+}
+
+int WObject::registerAttachedDataSlot(const char *typeName)
+{
+    // Compare by the name, the type_info of a type maybe not unique
+    // between the libraries.
+    static QMutex mutex;
+    static QHash<QByteArray, int> typeSlots;
+
+    QMutexLocker locker(&mutex);
+    const QByteArray name(typeName);
+    auto it = typeSlots.constFind(name);
+    if (it == typeSlots.constEnd())
+        it = typeSlots.insert(name, typeSlots.size());
+
+    return it.value();
+}
+
 const QList<std::pair<const void *, void *>> &WObject::attachedDatas() const
 {
     W_DC(WObject);
@@ -136,8 +173,9 @@ void WWrapObjectPrivate::invalidate()
     }
 
     instantRelease();
-    for (const auto &connection : std::as_const(connectionsWithHandle)) {
-        QObject::disconnect(connection);
+    for (const auto &connections : std::as_const(connectionsWithHandle)) {
+        for (const auto &connection : connections)
+            QObject::disconnect(connection);
     }
     if (m_handle) {
         m_handle->disconnect(q);
@@ -148,22 +186,41 @@ void WWrapObjectPrivate::invalidate()
     Q_EMIT q->invalidated();
 }
 
+void WWrapObjectPrivate::addConnectionWithHandle(const QMetaObject::Connection &connection)
+{
+    auto c_d = getConnectionDPtr(&connection);
+    connectionsWithHandle[c_d->receiver.loadRelaxed()].insert(c_d, connection);
+}
+
+bool WWrapObjectPrivate::takeConnectionWithHandle(const QMetaObject::Connection &connection)
+{
+    auto c_d = getConnectionDPtr(&connection);
+    auto it = connectionsWithHandle.find(c_d->receiver.loadRelaxed());
+    if (it == connectionsWithHandle.end() || !it->remove(c_d)) {
+        // The receiver is cleared if the connection is disconnected
+        // by others, find it in all receivers.
+        for (it = connectionsWithHandle.begin(); it != connectionsWithHandle.end(); ++it) {
+            if (it->remove(c_d))
+                break;
+        }
+        if (it == connectionsWithHandle.end())
+            return false;
+    }
+
+    if (it->isEmpty())
+        connectionsWithHandle.erase(it);
+    return true;
+}
+
 bool WWrapObject::safeDisconnect(const QObject *receiver)
 {
     W_D(WWrapObject);
 
     bool ok = false;
-    for (int i = 0; i < d->connectionsWithHandle.size(); ++i) {
-        const QMetaObject::Connection &connection = d->connectionsWithHandle.at(i);
-        auto c_d = getConnectionDPtr(&connection);
-        if (c_d->receiver == receiver) {
-            if (QObject::disconnect(connection))
-                ok = true;
-
-            d->connectionsWithHandle.removeAt(i);
-            // reset index
-            --i;
-        }
+    const auto connections = d->connectionsWithHandle.take(receiver);
+    for (const auto &connection : connections) {
+        if (QObject::disconnect(connection))
+            ok = true;
     }
 
     if (disconnect(receiver))
@@ -175,14 +232,11 @@ bool WWrapObject::safeDisconnect(const QObject *receiver)
 bool WWrapObject::safeDisconnect(const QMetaObject::Connection &connection)
 {
     W_D(WWrapObject);
-    int index = d->connectionsWithHandle.indexOf(connection);
-    if (index < 0) {
-        auto c_d = getConnectionDPtr(&connection);
-        if (c_d->sender != this)
-            return false;
+    auto c_d = getConnectionDPtr(&connection);
+    if (c_d->sender == this)
         return disconnect(connection);
-    }
-    d->connectionsWithHandle.removeAt(index);
+    if (!d->takeConnectionWithHandle(connection))
+        return false;
     return QObject::disconnect(connection);
 }
 
@@ -226,7 +280,7 @@ void WWrapObject::endSafeConnect(const QMetaObject::Connection &connection)
 {
     W_D(WWrapObject);
     if (connection)
-        d->connectionsWithHandle.append(connection);
+        d->addConnectionWithHandle(connection);
 }
 
 #ifdef QT_DEBUG
@@ -72,8 +72,7 @@ public:
     }
     template<typename T>
     T *getAttachedData() const {
-        const void *owner = typeid(T).name();
-        return getAttachedData<T>(owner);
+        return reinterpret_cast<T*>(attachedDataAt(attachedDataSlot<T>()));
     }
 
     template<typename T>
@@ -83,8 +82,9 @@ public:
     }
     template<typename T>
     void setAttachedData(void *data) {
-        const void *owner = typeid(T).name();
-        setAttachedData<T>(owner, data);
+        const int slot = attachedDataSlot<T>();
+        Q_ASSERT(!attachedDataAt(slot));
+        setAttachedDataAt(slot, data);
     }
 
     template<typename T>
@@ -95,16 +95,28 @@ public:
     }
     template<typename T>
     void removeAttachedData() {
-        const void *owner = typeid(T).name();
-        removeAttachedData<T>(owner);
+        const int slot = attachedDataSlot<T>();
+        Q_ASSERT(attachedDataAt(slot));
+        setAttachedDataAt(slot, nullptr);
     }
 
+    // The index of the attached data of the type T, it's allocated at the first
+    // use, and it's the same for a type in all libraries.
+    template<typename T>
+    static int attachedDataSlot() {
+        static const int slot = registerAttachedDataSlot(typeid(T).name());
+        return slot;
+    }
+    static int registerAttachedDataSlot(const char *typeName);
+
     WClient *waylandClient() const;
 
 protected:
     WObject(WObjectPrivate &dd, WObject *parent = nullptr);
 
     int indexOfAttachedData(const void *owner) const;
+    void *attachedDataAt(int slot) const;
+    void setAttachedDataAt(int slot, void *data);
     const QList<std::pair<const void*, void*>> &attachedDatas() const;
     QList<std::pair<const void*, void*>> &attachedDatas();
 
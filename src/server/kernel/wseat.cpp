@@ -7,10 +7,13 @@
 #include "woutput.h"
 #include "wsurface.h"
 #include "wxdgsurface.h"
+#include "woutputlayout.h"
 #include "platformplugin/qwlrootsintegration.h"
 #include "private/wglobal_p.h"
 
 #include <qwseat.h>
+#include <qwoutput.h>
+#include <qwoutputlayout.h>
 #include <qwkeyboard.h>
 #include <qwcursor.h>
 #include <qwcompositor.h>
@@ -27,8 +30,11 @@
 #include <QTimer>
 
 #include <qpa/qwindowsysteminterface.h>
+
+#include <time.h>
 #include <private/qxkbcommon_p.h>
 #include <private/qquickwindow_p.h>
+#include <private/qquickitem_p.h>
 #include <private/qquickdeliveryagent_p_p.h>
 
 QT_BEGIN_NAMESPACE
@@ -74,6 +80,73 @@ protected:
 };
 #endif
 
+// Returns the topmost item at the scenePos which accepts the pointer events,
+// it's the item the Qt Quick event delivery tries first.
+static QQuickItem *pointerTargetAt(QQuickItem *item, const QPointF &scenePos)
+{
+    if (!item->isVisible() || !item->isEnabled())
+        return nullptr;
+
+    const QPointF localPos = item->mapFromScene(scenePos);
+    if (item->clip() && !item->contains(localPos))
+        return nullptr;
+
+    auto d = QQuickItemPrivate::get(item);
+    const auto children = d->paintOrderChildItems();
+    for (auto it = children.crbegin(); it != children.crend(); ++it) {
+        if (auto target = pointerTargetAt(*it, scenePos))
+            return target;
+    }
+
+    if ((item->acceptHoverEvents() || item->acceptedMouseButtons() != Qt::NoButton
+         || d->hasPointerHandlers()) && item->contains(localPos)) {
+        return item;
+    }
+
+    return nullptr;
+}
+
+// Returns true if the item is the pointerTargetAt of its window, only the
+// items stacked above it are walked instead of the whole scene.
+static bool isPointerTargetAt(QQuickItem *item, const QPointF &scenePos)
+{
+    if (!item->isVisible() || !item->isEnabled())
+        return false;
+
+    const auto children = QQuickItemPrivate::get(item)->paintOrderChildItems();
+    for (auto it = children.crbegin(); it != children.crend(); ++it) {
+        if (pointerTargetAt(*it, scenePos))
+            return false;
+    }
+
+    for (auto child = item, parent = item->parentItem(); parent;
+         child = parent, parent = parent->parentItem()) {
+        if (parent->clip() && !parent->contains(parent->mapFromScene(scenePos)))
+            return false;
+
+        // The siblings painted after the child are above it
+        const auto siblings = QQuickItemPrivate::get(parent)->paintOrderChildItems();
+        for (auto it = siblings.crbegin(); it != siblings.crend() && *it != child; ++it) {
+            if (pointerTargetAt(*it, scenePos))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// The same clock as WFrameScheduler, the input time is compared with its time
+static inline qint64 monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+class WSeatPrivate;
+// The seats waiting for the next frame to deliver the coalesced motion
+static QList<WSeatPrivate*> seatsWithPendingMotion;
+
 class Q_DECL_HIDDEN WSeatPrivate : public WWrapObjectPrivate
 {
 public:
@@ -102,6 +175,7 @@ public:
         });
     }
     ~WSeatPrivate() {
+        seatsWithPendingMotion.removeOne(this);
         if (onEventObjectDestroy)
             QObject::disconnect(onEventObjectDestroy);
 
@@ -140,6 +214,7 @@ public:
         }
 
         handle()->pointer_notify_motion(timestamp, localPos.x(), localPos.y());
+        ++pointerEventSerial;
         return true;
     }
     inline bool doNotifyButton(uint32_t button, wl_pointer_button_state state, uint32_t timestamp) {
@@ -173,6 +248,7 @@ public:
         auto tmp = oldPointerFocusSurface;
         oldPointerFocusSurface = handle()->handle()->pointer_state.focused_surface;
         handle()->pointer_notify_enter(surface->handle()->handle(), position.x(), position.y());
+        ++pointerEventSerial;
         if (!pointerFocusSurface()) {
             // Because if the last pointer focus surface is a popup, the 'pointerNotifyEnter'
             // will call 'xdg_pointer_grab_enter' in wlroots, and the 'xdg_pointer_grab_enter'
@@ -201,6 +277,7 @@ public:
     inline void doClearPointerFocus() {
         pointerFocusEventObject.clear();
         handle()->pointer_notify_clear_focus();
+        ++pointerEventSerial;
         Q_ASSERT(!handle()->handle()->pointer_state.focused_surface);
         if (cursor) // reset cursur from QCursor resource, the last cursor is from wlr_surface
             cursor->setCursor(cursor->cursor());
@@ -304,6 +381,89 @@ public:
         this->handle()->keyboard_notify_modifiers(&keyboard->handle()->modifiers);
         return true;
     }
+    // Send the motion to the client of the pointer focus directly, without
+    // waiting for the coalesced QMouseEvent, returns false if it must be
+    // decided by the Qt Quick event delivery.
+    inline bool forwardMotionToPointerFocus(WCursor *cursor, uint32_t timestamp) {
+        auto item = qobject_cast<QQuickItem*>(pointerFocusEventObject);
+        if (!item || !item->window() || !pointerFocusSurface())
+            return false;
+        // The compositor maybe grab the pointer for the buttons, e.g. move a window
+        if (cursor->state() != Qt::NoButton)
+            return false;
+
+        const QPointF scenePos = cursor->position() - QPointF(item->window()->position());
+        const QPointF localPos = item->mapFromScene(scenePos);
+        // Maybe enter an other surface
+        if (!item->contains(localPos))
+            return false;
+        // Maybe enter an item stacked above the surface, e.g. the title bar
+        // of an other window
+        if (!isPointerTargetAt(item, scenePos))
+            return false;
+
+        handle()->pointer_notify_motion(timestamp, localPos.x(), localPos.y());
+        return true;
+    }
+    inline void coalesceMouseMove(WCursor *cursor, WInputDevice *device, uint32_t timestamp) {
+        // The earliest motion isn't delivered
+        if (!pendingMotion.cursor) {
+            pendingMotion.receivedTime = monotonicTime();
+            seatsWithPendingMotion.append(this);
+        }
+        pendingMotion.cursor = cursor;
+        pendingMotion.device = device;
+        pendingMotion.timestamp = timestamp;
+        pendingMotion.forwarded = forwardMotionToPointerFocus(cursor, timestamp);
+
+        if (motionFlushConnection)
+            return;
+
+        // Deliver before the next frame of the output under the cursor is
+        // rendered, see WSeat::flushPendingMotion(QWindow*). The frame event is
+        // used if the output isn't rendered by the event window.
+        qw_output *output = nullptr;
+        if (auto layout = cursor->layout()) {
+            const QPointF pos = cursor->position();
+            if (auto o = layout->handle()->output_at(pos.x(), pos.y()))
+                output = qw_output::from(o);
+        }
+
+        if (!output) {
+            flushPendingMotion();
+            return;
+        }
+
+        motionFlushConnection = QObject::connect(output, &qw_output::notify_frame, q_func(), [this] {
+            flushPendingMotion();
+        }, Qt::SingleShotConnection);
+        output->schedule_frame();
+    }
+    inline void flushPendingMotion() {
+        QObject::disconnect(motionFlushConnection);
+        seatsWithPendingMotion.removeOne(this);
+        if (!pendingMotion.cursor)
+            return;
+
+        auto cursor = std::exchange(pendingMotion.cursor, nullptr);
+        auto device = std::exchange(pendingMotion.device, nullptr);
+        if (!device)
+            return;
+
+        // The client already received this motion
+        skipForwardedMotion = pendingMotion.forwarded;
+        deliveringInputTime = pendingMotion.receivedTime;
+        const quint64 oldPointerEventSerial = pointerEventSerial;
+        doMouseMove(cursor, static_cast<QPointingDevice*>(device->qtDevice()),
+                    pendingMotion.timestamp);
+        deliveringInputTime = 0;
+        skipForwardedMotion = false;
+
+        // The frame event of the device was sent when the motion was
+        // coalesced, the clients only apply the events before a frame
+        if (!pendingMotion.forwarded && pointerEventSerial != oldPointerEventSerial)
+            doNotifyFrame();
+    }
     inline void doMouseMove(WCursor *cursor, const QPointingDevice *device, uint32_t timestamp) {
         Q_ASSERT(device);
         QWindow *w = cursor->eventWindow();
@@ -423,6 +583,22 @@ public:
     QPointer<WSurface> dragSurface;
 
     bool alwaysUpdateHoverTarget = false;
+
+    // for pointer motion coalescing
+    bool coalescePointerMotion = qEnvironmentVariableIsSet("WAYLIB_COALESCE_POINTER_MOTION");
+    bool skipForwardedMotion = false;
+    struct {
+        QPointer<WCursor> cursor;
+        QPointer<WInputDevice> device;
+        uint32_t timestamp = 0;
+        qint64 receivedTime = 0;
+        bool forwarded = false;
+    } pendingMotion;
+    // Changed when the wl_pointer events are sent to the clients
+    quint64 pointerEventSerial = 0;
+    // The receive time of the delayed input event which is being delivered
+    qint64 deliveringInputTime = 0;
+    QMetaObject::Connection motionFlushConnection;
 };
 
 void WSeatPrivate::on_destroy()
@@ -867,6 +1043,9 @@ bool WSeat::sendEvent(WSurface *target, QObject *shellObject, QObject *eventObje
             // so we should check the eventObject is still the same, if not, we should ignore this event
             if (d->pointerFocusEventObject != eventObject)
                 break;
+            // Sent by WSeatPrivate::forwardMotionToPointerFocus
+            if (d->skipForwardedMotion)
+                break;
         }
         d->doNotifyMotion(target, eventObject, e->position(), e->timestamp());
         break;
@@ -1095,10 +1274,50 @@ void WSeat::setAlwaysUpdateHoverTarget(bool newIgnoreSurfacePointerEventExclusiv
     Q_EMIT alwaysUpdateHoverTargetChanged();
 }
 
+qint64 WSeat::currentInputTime() const
+{
+    W_DC(WSeat);
+    return d->deliveringInputTime > 0 ? d->deliveringInputTime : monotonicTime();
+}
+
+bool WSeat::coalescePointerMotion() const
+{
+    W_DC(WSeat);
+    return d->coalescePointerMotion;
+}
+
+void WSeat::setCoalescePointerMotion(bool newCoalescePointerMotion)
+{
+    W_D(WSeat);
+    if (d->coalescePointerMotion == newCoalescePointerMotion)
+        return;
+    d->coalescePointerMotion = newCoalescePointerMotion;
+    if (!d->coalescePointerMotion)
+        d->flushPendingMotion();
+
+    Q_EMIT coalescePointerMotionChanged();
+}
+
+void WSeat::flushPendingMotion(QWindow *eventWindow)
+{
+    // The list is changed by the flush
+    const auto seats = seatsWithPendingMotion;
+    for (auto d : seats) {
+        const auto cursor = d->pendingMotion.cursor;
+        if (!cursor || cursor->eventWindow() == eventWindow)
+            d->flushPendingMotion();
+    }
+}
+
 void WSeat::notifyMotion(WCursor *cursor, WInputDevice *device, uint32_t timestamp)
 {
     W_D(WSeat);
 
+    if (d->coalescePointerMotion) {
+        d->coalesceMouseMove(cursor, device, timestamp);
+        return;
+    }
+
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
     d->doMouseMove(cursor, qwDevice, timestamp);
 }
@@ -1107,6 +1326,7 @@ void WSeat::notifyButton(WCursor *cursor, WInputDevice *device, Qt::MouseButton
                          wl_pointer_button_state_t state, uint32_t timestamp)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
 
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
@@ -1133,6 +1353,7 @@ void WSeat::notifyAxis(WCursor *cursor, WInputDevice *device, wl_pointer_axis_so
                        double delta, int32_t delta_discrete, uint32_t timestamp)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
 
     auto qwDevice = static_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
@@ -1169,6 +1390,7 @@ void WSeat::notifyFrame(WCursor *cursor)
 void WSeat::notifyGestureBegin(WCursor *cursor, WInputDevice *device, uint32_t time_msec, uint32_t fingers, WGestureEvent::WLibInputGestureType libInputGestureType)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected GestureBegin while already active";
     }
@@ -1239,6 +1461,7 @@ void WSeat::notifyGestureEnd(WCursor *cursor, WInputDevice *device, uint32_t tim
 void WSeat::notifyHoldBegin(WCursor *cursor, WInputDevice *device, uint32_t time_msec, uint32_t fingers)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     if (d->gestureActive) {
         qCWarning(qLcWlrGestureEvents) << "Unexpected HoldBegin while already active";
     }
@@ -1281,6 +1504,7 @@ void WSeat::notifyHoldEnd(WCursor *cursor, WInputDevice *device, uint32_t time_m
 void WSeat::notifyTouchDown(WCursor *cursor, WInputDevice *device, int32_t touch_id, uint32_t time_msec)
 {
     W_D(WSeat);
+    d->flushPendingMotion();
     auto qwDevice = qobject_cast<QPointingDevice*>(device->qtDevice());
     Q_ASSERT(qwDevice);
     const QPointF &globalPos = cursor->position();
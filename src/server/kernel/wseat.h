@@ -60,6 +60,7 @@ class WAYLIB_SERVER_EXPORT WSeat : public WWrapObject, public WServerInterface
     Q_PROPERTY(WInputDevice* keyboard READ keyboard WRITE setKeyboard NOTIFY keyboardChanged FINAL)
     Q_PROPERTY(WSurface* keyboardFocus READ keyboardFocusSurface WRITE setKeyboardFocusSurface NOTIFY keyboardFocusSurfaceChanged FINAL)
     Q_PROPERTY(bool alwaysUpdateHoverTarget READ alwaysUpdateHoverTarget WRITE setAlwaysUpdateHoverTarget NOTIFY alwaysUpdateHoverTargetChanged FINAL)
+    Q_PROPERTY(bool coalescePointerMotion READ coalescePointerMotion WRITE setCoalescePointerMotion NOTIFY coalescePointerMotionChanged FINAL)
 
 public:
     WSeat(const QString &name = QStringLiteral("seat0"));
@@ -105,6 +106,17 @@ public:
     bool alwaysUpdateHoverTarget() const;
     void setAlwaysUpdateHoverTarget(bool newIgnoreSurfacePointerEventExclusiveGrabber);
 
+    // Deliver at most one QMouseEvent of the pointer motion for each frame of
+    // the output under the cursor, the client of the pointer focus still receives
+    // every motion. Default is enabled by the WAYLIB_COALESCE_POINTER_MOTION.
+    bool coalescePointerMotion() const;
+    void setCoalescePointerMotion(bool newCoalescePointerMotion);
+
+    // The time (in nanoseconds of CLOCK_MONOTONIC) this seat received the input
+    // event which is being delivered, it's earlier than now if the event is
+    // delayed, e.g. the coalesced pointer motion.
+    qint64 currentInputTime() const;
+
 Q_SIGNALS:
     void keyboardChanged();
     void keyboardFocusSurfaceChanged();
@@ -112,6 +124,7 @@ Q_SIGNALS:
     void requestCursorSurface(WAYLIB_SERVER_NAMESPACE::WSurface *surface, const QPoint &hotspot);
     void requestDrag(WAYLIB_SERVER_NAMESPACE::WSurface *surface);
     void alwaysUpdateHoverTargetChanged();
+    void coalescePointerMotionChanged();
 
 protected:
     using QObject::eventFilter;
@@ -122,6 +135,7 @@ protected:
     friend class WEventJunkman;
     friend class WCursorShapeManagerV1;
     friend class WOutputRenderWindow;
+    friend class WOutputRenderWindowPrivate;
 
     void create(WServer *server) override;
     void destroy(WServer *server) override;
@@ -135,6 +149,9 @@ protected:
     bool filterUnacceptedEvent(QWindow *targetWindow, QInputEvent *event);
 
     // pointer
+    // Deliver the coalesced motion of the cursors on the eventWindow, it's
+    // called before the window polishes the items for a new frame.
+    static void flushPendingMotion(QWindow *eventWindow);
     void notifyMotion(WCursor *cursor, WInputDevice *device, uint32_t timestamp);
     void notifyButton(WCursor *cursor, WInputDevice *device,
                       Qt::MouseButton button, wl_pointer_button_state_t state,
@@ -12,6 +12,7 @@
 #include "wsurface.h"
 #include "wsocket.h"
 #include "platformplugin/qwlrootsintegration.h"
+#include "platformplugin/qwlrootseventdispatcher.h"
 
 #include <qwdisplay.h>
 #include <qwdatadevice.h>
@@ -19,6 +20,7 @@
 #include <qwxwaylandshellv1.h>
 
 #include <QVector>
+#include <QHash>
 #include <QThread>
 #include <QEvent>
 #include <QCoreApplication>
@@ -35,6 +37,8 @@
 #include <qpa/qplatformintegrationfactory_p.h>
 #include <qpa/qplatformtheme.h>
 
+#include <algorithm>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -97,25 +101,32 @@ void WServerPrivate::init()
 
     for (auto i : std::as_const(interfaceList)) {
         i->create(q);
+        markInterfaceIndexDirty();
         if (auto global = i->global())
             Q_ASSERT(wl_global_get_interface(global)->name == i->interfaceName());
     }
 
     loop = wl_display_get_event_loop(display->handle());
-    int fd = wl_event_loop_get_fd(loop);
-
-    auto processWaylandEvents = [this] {
-        int ret = wl_event_loop_dispatch(loop, 0);
-        if (ret)
-            fprintf(stderr, "wl_event_loop_dispatch error: %d\n", ret);
-        wl_display_flush_clients(display->handle());
-    };
-
-    sockNot.reset(new QSocketNotifier(fd, QSocketNotifier::Read));
-    QObject::connect(sockNot.get(), &QSocketNotifier::activated, q, processWaylandEvents);
+    running = true;
 
     QAbstractEventDispatcher *dispatcher = QThread::currentThread()->eventDispatcher();
-    QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, q, processWaylandEvents);
+    if (auto nativeDispatcher = qobject_cast<QWlrootsEventDispatcher*>(dispatcher)) {
+        // The event loop is dispatched and the clients are flushed by the dispatcher
+        nativeDispatcher->setWaylandDisplay(display->handle());
+    } else {
+        int fd = wl_event_loop_get_fd(loop);
+
+        auto processWaylandEvents = [this] {
+            int ret = wl_event_loop_dispatch(loop, 0);
+            if (ret)
+                fprintf(stderr, "wl_event_loop_dispatch error: %d\n", ret);
+            wl_display_flush_clients(display->handle());
+        };
+
+        sockNot.reset(new QSocketNotifier(fd, QSocketNotifier::Read));
+        QObject::connect(sockNot.get(), &QSocketNotifier::activated, q, processWaylandEvents);
+        QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, q, processWaylandEvents);
+    }
 
     for (auto socket : std::as_const(sockets))
         initSocket(socket);
@@ -132,6 +143,7 @@ void WServerPrivate::stop()
 
     auto list = interfaceList;
     interfaceList.clear();
+    markInterfaceIndexDirty();
     auto i = list.crbegin();
     for (; i != list.crend(); ++i) {
         (*i)->destroy(q);
@@ -139,7 +151,29 @@ void WServerPrivate::stop()
     }
 
     sockNot.reset();
-    QThread::currentThread()->eventDispatcher()->disconnect(q);
+    QAbstractEventDispatcher *dispatcher = QThread::currentThread()->eventDispatcher();
+    if (auto nativeDispatcher = qobject_cast<QWlrootsEventDispatcher*>(dispatcher))
+        nativeDispatcher->setWaylandDisplay(nullptr);
+    else
+        dispatcher->disconnect(q);
+    running = false;
+}
+
+void WServerPrivate::ensureInterfaceIndex()
+{
+    if (!interfaceIndexDirty)
+        return;
+    interfaceIndexDirty = false;
+
+    globalIndex.clear();
+    handleIndex.clear();
+    for (auto i : std::as_const(interfaceList)) {
+        if (!i->isValid())
+            continue;
+        handleIndex[i->handle()].append(i);
+        if (auto global = i->global())
+            globalIndex.insert(global, i);
+    }
 }
 
 void WServerPrivate::initSocket(WSocket *socketServer)
@@ -203,6 +237,7 @@ void WServer::attach(WServerInterface *interface)
     // After interface->create append to the list when server is runing
     // See WServer::findInterface(wl_global)
     d->interfaceList << interface;
+    d->markInterfaceIndexDirty();
 }
 
 bool WServer::detach(WServerInterface *interface)
@@ -212,6 +247,7 @@ bool WServer::detach(WServerInterface *interface)
     bool ok = d->interfaceList.removeOne(interface);
     if (!ok)
         return false;
+    d->markInterfaceIndexDirty();
 
     Q_ASSERT(interface->m_server == this);
     interface->m_server = nullptr;
@@ -231,10 +267,33 @@ const QVector<WServerInterface *> &WServer::interfaceList() const
 
 QVector<WServerInterface *> WServer::findInterfaces(void *handle) const
 {
-    QVector<WServerInterface*> list;
-    for (auto i : interfaceList()) {
-        if (i->handle() == handle)
-            list << i;
+    auto d = const_cast<WServerPrivate*>(d_func());
+    auto scan = [d, handle] {
+        QVector<WServerInterface*> list;
+        for (auto i : std::as_const(d->interfaceList)) {
+            if (i->handle() == handle)
+                list << i;
+        }
+        return list;
+    };
+
+    // The invalid interfaces are not indexed
+    if (!handle)
+        return scan();
+
+    d->ensureInterfaceIndex();
+    auto list = d->handleIndex.value(handle);
+    // The handle is destroyed without WServerInterface::destroy, e.g. WSeat,
+    // or is changed without attach/detach, so the index is stale even though
+    // it's not marked dirty. Don't rebuild it for every miss, scan the list
+    // like before and only drop the index if it's really out of date.
+    if (list.isEmpty() || std::any_of(list.cbegin(), list.cend(), [handle] (WServerInterface *i) {
+            return i->handle() != handle;
+        })) {
+        const auto scanned = scan();
+        if (scanned != list)
+            d->markInterfaceIndexDirty();
+        list = scanned;
     }
 
     return list;
@@ -242,22 +301,25 @@ QVector<WServerInterface *> WServer::findInterfaces(void *handle) const
 
 WServerInterface *WServer::findInterface(void *handle) const
 {
-    for (auto i : interfaceList()) {
-        if (i->handle() == handle)
-            return i;
-    }
-
-    return nullptr;
+    const auto list = findInterfaces(handle);
+    return list.isEmpty() ? nullptr : list.first();
 }
 
 WServerInterface *WServer::findInterface(const wl_global *global) const
 {
-    for (const auto &i : interfaceList()) {
-        if (i->global() == global)
-            return i;
+    auto d = const_cast<WServerPrivate*>(d_func());
+
+    d->ensureInterfaceIndex();
+    auto interface = d->globalIndex.value(global);
+    // A miss needn't be checked, the global is only changed by create/destroy
+    // which mark the index dirty
+    if (interface && (!interface->isValid() || interface->global() != global)) {
+        d->markInterfaceIndexDirty();
+        d->ensureInterfaceIndex();
+        interface = d->globalIndex.value(global);
     }
-
-    W_DC(WServer);
+    if (interface)
+        return interface;
 
     // When call WServerInterface::create, will call wl_global_create in wlroots,
     // and will call globalFilter in libwayland(wl_global_is_visible), globalFilter
@@ -358,7 +420,7 @@ void WServer::initializeProxyQPA(int &argc, char **argv, const QStringList &prox
 bool WServer::isRunning() const
 {
     W_DC(WServer);
-    return d->sockNot.get();
+    return d->running;
 }
 
 void WServer::addSocket(WSocket *socket)
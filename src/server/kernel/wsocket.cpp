@@ -8,6 +8,8 @@
 #include <QStandardPaths>
 #include <QStringDecoder>
 #include <QPointer>
+#include <QFile>
+#include <QTimer>
 
 #include <wayland-server-core.h>
 
@@ -17,7 +19,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include <signal.h>
+#include <unistd.h>
 
 struct wl_event_source;
 
@@ -25,6 +30,10 @@ WAYLIB_SERVER_BEGIN_NAMESPACE
 
 #define LOCK_SUFFIX ".lock"
 
+// The throttled client is frozen for about a frame
+static constexpr std::chrono::milliseconds RateLimitThrottleInterval(16);
+static constexpr int DeprioritizedNice = 10;
+
 // Copy from libwayland
 static int wl_socket_lock(const QString &socketFile)
 {
@@ -125,6 +134,14 @@ public:
 
     void addClient(WClient *client);
 
+    bool hasRateLimit() const {
+        return maxRequestsPerDispatch > 0 || maxBytesPerDispatch > 0;
+    }
+    void updateProtocolLogger();
+    void countRequest(WClient *client, const wl_protocol_logger_message *message);
+    void checkRateLimit();
+    void applyRateLimitPolicy(WClient *client);
+
     W_DECLARE_PUBLIC(WSocket)
 
     bool enabled = true;
@@ -138,6 +155,15 @@ public:
     wl_display *display = nullptr;
     wl_event_source *eventSource = nullptr;
     QList<WClient*> clients;
+
+    int maxRequestsPerDispatch = 0;
+    int maxBytesPerDispatch = 0;
+    WSocket::RateLimitPolicy rateLimitPolicy = WSocket::RateLimitPolicy::Notify;
+    wl_protocol_logger *protocolLogger = nullptr;
+    // An idle source runs after the dispatch of the event loop
+    wl_event_source *dispatchEndSource = nullptr;
+    // The clients which sent requests in the current dispatch
+    QList<WClient*> dispatchingClients;
 };
 
 struct Q_DECL_HIDDEN WlClientDestroyListener {
@@ -173,15 +199,101 @@ WlClientDestroyListener *WlClientDestroyListener::get(const wl_client *client)
     return tmp;
 }
 
-static bool pauseClient(wl_client *client, bool pause)
+static QByteArray cgroupOf(const QString &procCGroupFile)
+{
+    QFile file(procCGroupFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    // The entry of cgroup v2 is "0::/path"
+    const auto lines = file.readAll().split('\n');
+    for (const auto &line : lines) {
+        if (line.startsWith("0::"))
+            return line.mid(3);
+    }
+
+    return {};
+}
+
+static pid_t parentOf(pid_t pid)
+{
+    QFile file(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    // The format is "pid (comm) state ppid ...", the comm may contain ')'
+    const auto stat = file.readAll();
+    const int end = stat.lastIndexOf(')');
+    if (end < 0)
+        return 0;
+    const auto fields = stat.mid(end + 1).simplified().split(' ');
+    return fields.size() > 1 ? pid_t(fields.at(1).toInt()) : 0;
+}
+
+// Returns true if all processes of the cgroup are the process or its
+// descendants, the others can't be frozen for the client.
+static bool isOwnedCGroup(const QString &cgroup, pid_t pid)
+{
+    QFile file(cgroup + QStringLiteral("/cgroup.procs"));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const auto lines = file.readAll().split('\n');
+    for (const auto &line : lines) {
+        if (line.isEmpty())
+            continue;
+
+        bool ok = false;
+        pid_t member = pid_t(line.toInt(&ok));
+        if (!ok)
+            return false;
+        // The init process is the root of the tree
+        while (member > 1 && member != pid)
+            member = parentOf(member);
+        if (member != pid)
+            return false;
+    }
+
+    return true;
+}
+
+// Returns the directory of the cgroup v2 of the process if it can be frozen
+// without the compositor and the other applications, e.g. the scope of an
+// application that only contains the process and its children.
+static QString freezableCGroupOf(pid_t pid)
 {
-    pid_t pid = 0;
-    wl_client_get_credentials(client, &pid, nullptr, nullptr);
+    static bool disabled = qEnvironmentVariableIsSet("WAYLIB_DISABLE_CGROUP_FREEZE");
+    if (disabled)
+        return {};
+
+    const auto cgroup = cgroupOf(QStringLiteral("/proc/%1/cgroup").arg(pid));
+    if (cgroup.isEmpty() || cgroup == "/")
+        return {};
+
+    const auto selfCGroup = cgroupOf(QStringLiteral("/proc/self/cgroup"));
+    if (selfCGroup == cgroup || selfCGroup.startsWith(cgroup + '/'))
+        return {};
+
+    const QString path = QStringLiteral("/sys/fs/cgroup") + QString::fromLocal8Bit(cgroup);
+    if (access(QFile::encodeName(path + QStringLiteral("/cgroup.freeze")).constData(), W_OK) != 0)
+        return {};
+    // Such as a shared cgroup of the session, fallback to the pidfd
+    if (!isOwnedCGroup(path, pid))
+        return {};
+
+    return path;
+}
 
-    if (pid == 0)
+static bool writeCGroupFreeze(const QString &cgroup, bool freeze)
+{
+    const QByteArray file = QFile::encodeName(cgroup + QStringLiteral("/cgroup.freeze"));
+    int fd = open(file.constData(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
         return false;
 
-    return kill(pid, pause ? SIGSTOP : SIGCONT) == 0;
+    const bool ok = write(fd, freeze ? "1" : "0", 1) == 1;
+    close(fd);
+    return ok;
 }
 
 void WSocketPrivate::shutdown()
@@ -209,8 +321,11 @@ void WSocketPrivate::addClient(WClient *client)
     Q_ASSERT(!clients.contains(client));
     clients.append(client);
 
-    if (!enabled && freezeClientWhenDisable) {
-        client->freeze();
+    if (freezeClientWhenDisable) {
+        // Open the pidfd while the client is connected, the pid can't be reused now
+        Q_UNUSED(client->pidFD());
+        if (!enabled)
+            client->freeze();
     }
 
     W_Q(WSocket);
@@ -244,12 +359,246 @@ public:
 
     W_DECLARE_PUBLIC(WClient)
 
+    bool setFrozen(bool frozen);
+
     wl_client *handle = nullptr;
     WSocket *socket = nullptr;
     mutable QSharedPointer<WClient::Credentials> credentials;
     mutable int pidFD = -1;
+
+    enum class FreezeMethod {
+        Unknown,
+        // Freeze the whole cgroup of the client, including its child processes
+        CGroup,
+        // Send SIGSTOP/SIGCONT by the pidfd, the pid can't be reused
+        PidFD,
+        Signal,
+    };
+    FreezeMethod freezeMethod = FreezeMethod::Unknown;
+    QString cgroup;
+    bool frozen = false;
+
+    int dispatchRequests = 0;
+    int dispatchBytes = 0;
+    quint64 requestCount = 0;
+    quint64 requestBytes = 0;
 };
 
+bool WClientPrivate::setFrozen(bool frozen)
+{
+    W_Q(WClient);
+
+    if (this->frozen == frozen)
+        return true;
+
+    const pid_t pid = q->credentials()->pid;
+    if (pid <= 0)
+        return false;
+
+    if (freezeMethod == FreezeMethod::Unknown) {
+        cgroup = freezableCGroupOf(pid);
+        if (!cgroup.isEmpty())
+            freezeMethod = FreezeMethod::CGroup;
+        else if (q->pidFD() >= 0)
+            freezeMethod = FreezeMethod::PidFD;
+        else
+            freezeMethod = FreezeMethod::Signal;
+    }
+
+    bool ok = false;
+    // Other processes maybe moved to the cgroup since the last freezing
+    if (freezeMethod == FreezeMethod::CGroup && frozen && !isOwnedCGroup(cgroup, pid))
+        freezeMethod = q->pidFD() >= 0 ? FreezeMethod::PidFD : FreezeMethod::Signal;
+
+    if (freezeMethod == FreezeMethod::CGroup) {
+        ok = writeCGroupFreeze(cgroup, frozen);
+        // The cgroup maybe removed or moved, fallback to the signal
+        if (!ok && frozen)
+            freezeMethod = q->pidFD() >= 0 ? FreezeMethod::PidFD : FreezeMethod::Signal;
+    }
+
+    if (freezeMethod == FreezeMethod::PidFD)
+        ok = syscall(SYS_pidfd_send_signal, q->pidFD(), frozen ? SIGSTOP : SIGCONT, nullptr, 0) == 0;
+    else if (freezeMethod == FreezeMethod::Signal)
+        ok = kill(pid, frozen ? SIGSTOP : SIGCONT) == 0;
+
+    if (ok)
+        this->frozen = frozen;
+    return ok;
+}
+
+// The size of the request in the wire format, the file descriptors
+// are sent by SCM_RIGHTS and not counted.
+static int requestSize(const wl_protocol_logger_message *message)
+{
+    // The object id, the opcode and the size
+    int size = 8;
+    int index = 0;
+    for (const char *signature = message->message->signature; *signature; ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+            size += 4;
+            break;
+        case 's': {
+            const char *string = message->arguments[index].s;
+            size += 4 + (string ? (int(strlen(string)) + 4) & ~3 : 0);
+            break;
+        }
+        case 'a': {
+            const wl_array *array = message->arguments[index].a;
+            size += 4 + (array ? (int(array->size) + 3) & ~3 : 0);
+            break;
+        }
+        case 'h':
+            break;
+        default:
+            // The version and the nullable flag
+            continue;
+        }
+        ++index;
+    }
+
+    return size;
+}
+
+static void socket_protocol_logger(void *data, wl_protocol_logger_type type,
+                                   const wl_protocol_logger_message *message)
+{
+    if (type != WL_PROTOCOL_LOGGER_REQUEST)
+        return;
+
+    WSocketPrivate *d = reinterpret_cast<WSocketPrivate*>(data);
+    auto client = WClient::get(wl_resource_get_client(message->resource));
+    // The logger is added to the display, it receives the requests of all sockets
+    if (!client || client->socket() != d->q_func())
+        return;
+
+    d->countRequest(client, message);
+}
+
+static void socket_dispatch_end(void *data)
+{
+    WSocketPrivate *d = reinterpret_cast<WSocketPrivate*>(data);
+    // The idle source is removed by the event loop after this
+    d->dispatchEndSource = nullptr;
+    d->checkRateLimit();
+}
+
+void WSocketPrivate::updateProtocolLogger()
+{
+    const bool needsLogger = display && hasRateLimit();
+    if (needsLogger == bool(protocolLogger))
+        return;
+
+    if (needsLogger) {
+        protocolLogger = wl_display_add_protocol_logger(display, socket_protocol_logger, this);
+        return;
+    }
+
+    wl_protocol_logger_destroy(protocolLogger);
+    protocolLogger = nullptr;
+    if (dispatchEndSource) {
+        wl_event_source_remove(dispatchEndSource);
+        dispatchEndSource = nullptr;
+    }
+    for (auto client : std::as_const(dispatchingClients)) {
+        client->d_func()->dispatchRequests = 0;
+        client->d_func()->dispatchBytes = 0;
+    }
+    dispatchingClients.clear();
+}
+
+void WSocketPrivate::countRequest(WClient *client, const wl_protocol_logger_message *message)
+{
+    auto cd = client->d_func();
+    if (cd->dispatchRequests == 0)
+        dispatchingClients.append(client);
+
+    const int size = requestSize(message);
+    ++cd->dispatchRequests;
+    cd->dispatchBytes += size;
+    ++cd->requestCount;
+    cd->requestBytes += size;
+
+    // Check the clients after all ready clients are dispatched, the client
+    // can't be destroyed while its requests are dispatching.
+    if (!dispatchEndSource)
+        dispatchEndSource = wl_event_loop_add_idle(wl_display_get_event_loop(display),
+                                                   socket_dispatch_end, this);
+}
+
+void WSocketPrivate::checkRateLimit()
+{
+    struct Exceeded {
+        QPointer<WClient> client;
+        int requests;
+        int bytes;
+    };
+    QList<Exceeded> exceededClients;
+
+    const auto clients = std::exchange(dispatchingClients, {});
+    for (auto client : clients) {
+        auto cd = client->d_func();
+        const int requests = std::exchange(cd->dispatchRequests, 0);
+        const int bytes = std::exchange(cd->dispatchBytes, 0);
+
+        if ((maxRequestsPerDispatch > 0 && requests > maxRequestsPerDispatch)
+            || (maxBytesPerDispatch > 0 && bytes > maxBytesPerDispatch)) {
+            exceededClients.append({client, requests, bytes});
+        }
+    }
+
+    W_Q(WSocket);
+    for (const auto &exceeded : std::as_const(exceededClients)) {
+        if (exceeded.client)
+            Q_EMIT q->clientRateLimitExceeded(exceeded.client, exceeded.requests, exceeded.bytes);
+        // Maybe removed in the signal
+        if (exceeded.client)
+            applyRateLimitPolicy(exceeded.client);
+    }
+}
+
+void WSocketPrivate::applyRateLimitPolicy(WClient *client)
+{
+    switch (rateLimitPolicy) {
+    case WSocket::RateLimitPolicy::Notify:
+        break;
+    case WSocket::RateLimitPolicy::Throttle: {
+        // Don't touch the client frozen by the socket
+        if (client->isFrozen() || !client->d_func()->setFrozen(true))
+            break;
+
+        QTimer::singleShot(RateLimitThrottleInterval, client, [this, client] {
+            if (enabled || !freezeClientWhenDisable)
+                client->activate();
+        });
+        break;
+    }
+    case WSocket::RateLimitPolicy::Deprioritize: {
+        // Only the main thread of the client on Linux, it's usually the one
+        // talking to the compositor.
+        const pid_t pid = client->credentials()->pid;
+        errno = 0;
+        const int nice = getpriority(PRIO_PROCESS, pid);
+        if (errno == 0 && nice < DeprioritizedNice)
+            setpriority(PRIO_PROCESS, pid, DeprioritizedNice);
+        break;
+    }
+    case WSocket::RateLimitPolicy::Disconnect:
+        if (auto handle = client->handle()) {
+            wl_client_post_implementation_error(handle, "exceeded the rate limit of the requests");
+            wl_client_flush(handle);
+            // The WClient is removed by the destroy listener
+            wl_client_destroy(handle);
+        }
+        break;
+    }
+}
+
 void WlClientDestroyListener::handle_destroy(wl_listener *listener, void *data)
 {
     WlClientDestroyListener *self = wl_container_of(listener, self, destroy);
@@ -327,13 +676,31 @@ WClient *WClient::get(const wl_client *client)
 void WClient::freeze()
 {
     W_D(WClient);
-    pauseClient(d->handle, true);
+    d->setFrozen(true);
 }
 
 void WClient::activate()
 {
     W_D(WClient);
-    pauseClient(d->handle, false);
+    d->setFrozen(false);
+}
+
+bool WClient::isFrozen() const
+{
+    W_DC(WClient);
+    return d->frozen;
+}
+
+quint64 WClient::requestCount() const
+{
+    W_DC(WClient);
+    return d->requestCount;
+}
+
+quint64 WClient::requestBytes() const
+{
+    W_DC(WClient);
+    return d->requestBytes;
 }
 
 WSocket::WSocket(bool freezeClientWhenDisable, WSocket *parentSocket, QObject *parent)
@@ -381,6 +748,7 @@ void WSocket::close()
         wl_event_source_remove(d->eventSource);
         d->eventSource = nullptr;
         d->display = nullptr;
+        d->updateProtocolLogger();
         Q_EMIT listeningChanged();
     }
     Q_ASSERT(!d->display);
@@ -632,6 +1000,7 @@ bool WSocket::listen(wl_display *display)
     if (!d->eventSource)
         return false;
 
+    d->updateProtocolLogger();
     Q_EMIT listeningChanged();
 
     return true;
@@ -686,6 +1055,7 @@ bool WSocket::removeClient(WClient *client)
     bool ok = d->clients.removeOne(client);
     if (!ok)
         return false;
+    d->dispatchingClients.removeOne(client);
 
     Q_EMIT aboutToBeDestroyedClient(client);
     delete client;
@@ -722,6 +1092,58 @@ void WSocket::setEnabled(bool on)
     Q_EMIT enabledChanged();
 }
 
+int WSocket::maxRequestsPerDispatch() const
+{
+    W_DC(WSocket);
+    return d->maxRequestsPerDispatch;
+}
+
+void WSocket::setMaxRequestsPerDispatch(int max)
+{
+    W_D(WSocket);
+    max = std::max(max, 0);
+    if (d->maxRequestsPerDispatch == max)
+        return;
+    d->maxRequestsPerDispatch = max;
+    d->updateProtocolLogger();
+
+    Q_EMIT rateLimitChanged();
+}
+
+int WSocket::maxBytesPerDispatch() const
+{
+    W_DC(WSocket);
+    return d->maxBytesPerDispatch;
+}
+
+void WSocket::setMaxBytesPerDispatch(int max)
+{
+    W_D(WSocket);
+    max = std::max(max, 0);
+    if (d->maxBytesPerDispatch == max)
+        return;
+    d->maxBytesPerDispatch = max;
+    d->updateProtocolLogger();
+
+    Q_EMIT rateLimitChanged();
+}
+
+WSocket::RateLimitPolicy WSocket::rateLimitPolicy() const
+{
+    W_DC(WSocket);
+    return d->rateLimitPolicy;
+}
+
+void WSocket::setRateLimitPolicy(RateLimitPolicy policy)
+{
+    W_D(WSocket);
+    if (d->rateLimitPolicy == policy)
+        return;
+    d->rateLimitPolicy = policy;
+
+    Q_EMIT rateLimitChanged();
+}
+
 void WSocket::setParentSocket(WSocket *parentSocket)
 {
     W_D(WSocket);
@@ -38,12 +38,23 @@ public:
     [[nodiscard]] static QSharedPointer<Credentials> getCredentials(const wl_client *client);
     static WClient *get(const wl_client *client);
 
+    // The client and its child processes are frozen by the cgroup v2 freezer if
+    // the client is in an individual cgroup, otherwise the client is stopped by
+    // SIGSTOP, set WAYLIB_DISABLE_CGROUP_FREEZE to disable the cgroup freezer.
+    bool isFrozen() const;
+
+    // The requests and the bytes (without the file descriptors) received from
+    // the client, only counted if the socket has a rate limit.
+    quint64 requestCount() const;
+    quint64 requestBytes() const;
+
 public Q_SLOTS:
     void freeze();
     void activate();
 
 private:
     friend class WSocket;
+    friend class WSocketPrivate;
     friend class WlClientDestroyListener;
     explicit WClient(wl_client *client, WSocket *socket);
     ~WClient() = default;
@@ -61,8 +72,23 @@ class WAYLIB_SERVER_EXPORT WSocket : public QObject, public WObject
     Q_PROPERTY(bool listening READ isListening NOTIFY listeningChanged FINAL)
     Q_PROPERTY(QString fullServerName READ fullServerName NOTIFY fullServerNameChanged FINAL)
     Q_PROPERTY(WSocket* parentSocket READ parentSocket WRITE setParentSocket NOTIFY parentSocketChanged FINAL)
+    Q_PROPERTY(int maxRequestsPerDispatch READ maxRequestsPerDispatch WRITE setMaxRequestsPerDispatch NOTIFY rateLimitChanged FINAL)
+    Q_PROPERTY(int maxBytesPerDispatch READ maxBytesPerDispatch WRITE setMaxBytesPerDispatch NOTIFY rateLimitChanged FINAL)
+    Q_PROPERTY(RateLimitPolicy rateLimitPolicy READ rateLimitPolicy WRITE setRateLimitPolicy NOTIFY rateLimitChanged FINAL)
 
 public:
+    // What to do with a client which exceeds the rate limit in a dispatch of
+    // the event loop, the clientRateLimitExceeded is emitted in any case.
+    enum class RateLimitPolicy {
+        Notify,
+        // Freeze the client for a short while, see WClient::freeze
+        Throttle,
+        // Lower the CPU priority of the client process
+        Deprioritize,
+        Disconnect,
+    };
+    Q_ENUM(RateLimitPolicy)
+
     explicit WSocket(bool freezeClientWhenDisable, WSocket *parentSocket = nullptr, QObject *parent = nullptr);
     ~WSocket();
 
@@ -93,6 +119,15 @@ public:
     bool isEnabled() const;
     void setEnabled(bool on);
 
+    // 0 means no limit, the requests of the clients are counted only if
+    // any limit is set.
+    int maxRequestsPerDispatch() const;
+    void setMaxRequestsPerDispatch(int max);
+    int maxBytesPerDispatch() const;
+    void setMaxBytesPerDispatch(int max);
+    RateLimitPolicy rateLimitPolicy() const;
+    void setRateLimitPolicy(RateLimitPolicy policy);
+
 public Q_SLOTS:
     void setParentSocket(WSocket *parentSocket);
 
@@ -105,6 +140,8 @@ Q_SIGNALS:
     void clientAdded(WClient *client);
     void aboutToBeDestroyedClient(WClient *client);
     void parentSocketChanged();
+    void rateLimitChanged();
+    void clientRateLimitExceeded(WClient *client, int requests, int bytes);
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -6,6 +6,7 @@
 #include "wseat.h"
 #include "private/wsurface_p.h"
 #include "woutput.h"
+#include "wtools.h"
 
 #include <qwoutput.h>
 #include <qwcompositor.h>
@@ -44,8 +45,10 @@ void WSurfacePrivate::on_commit()
 {
     W_Q(WSurface);
 
-    if (nativeHandle()->current.committed & WLR_SURFACE_STATE_BUFFER)
+    if (nativeHandle()->current.committed & WLR_SURFACE_STATE_BUFFER) {
+        bufferDamage = WTools::fromPixmanRegion(&nativeHandle()->buffer_damage);
         updateBuffer();
+    }
 
     if (nativeHandle()->current.committed & WLR_SURFACE_STATE_OFFSET)
         updateBufferOffset();
@@ -60,6 +63,8 @@ void WSurfacePrivate::init()
     handle()->set_data(this, q);
 
     connect();
+    // The first buffer is damaged entirely
+    bufferDamage = QRect(QPoint(0, 0), q->bufferSize());
     updateBuffer();
     updateHasSubsurface();
 
@@ -299,6 +304,12 @@ qw_buffer *WSurface::buffer() const
     return d->buffer.get();
 }
 
+QRegion WSurface::bufferDamage() const
+{
+    W_DC(WSurface);
+    return d->bufferDamage;
+}
+
 void WSurface::notifyFrameDone()
 {
     W_D(WSurface);
@@ -9,6 +9,7 @@
 
 #include <QObject>
 #include <QRect>
+#include <QRegion>
 #include <QQmlEngine>
 
 struct wlr_surface;
@@ -51,6 +52,9 @@ public:
     int bufferScale() const;
     QPoint bufferOffset() const;
     QW_NAMESPACE::qw_buffer *buffer() const;
+    // The changed area of the current buffer since the previous buffer,
+    // in buffer local coordinates, valid when bufferChanged is emitted.
+    QRegion bufferDamage() const;
 
     void notifyFrameDone();
 
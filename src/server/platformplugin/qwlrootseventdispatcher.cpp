@@ -0,0 +1,370 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qwlrootseventdispatcher.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QLoggingCategory>
+#include <QVarLengthArray>
+#include <qpa/qwindowsysteminterface.h>
+#include <private/qthread_p.h>
+
+#include <wayland-server-core.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <cstring>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcEventDispatcher, "waylib.platform.eventdispatcher", QtInfoMsg)
+
+static constexpr int MaxEvents = 64;
+
+static inline qint64 monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+QWlrootsEventDispatcher::QWlrootsEventDispatcher(QObject *parent)
+    : QAbstractEventDispatcher(parent)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeUpFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_epollFd < 0 || m_wakeUpFd < 0)
+        qFatal("Failed to create the epoll or the eventfd: %s", strerror(errno));
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeUpFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeUpFd, &event);
+}
+
+QWlrootsEventDispatcher::~QWlrootsEventDispatcher()
+{
+    close(m_wakeUpFd);
+    close(m_epollFd);
+}
+
+bool QWlrootsEventDispatcher::isEnabled()
+{
+    static bool on = qEnvironmentVariableIntValue("WAYLIB_EPOLL_EVENT_DISPATCHER") == 1;
+    return on;
+}
+
+void QWlrootsEventDispatcher::setWaylandDisplay(wl_display *display)
+{
+    if (m_display == display)
+        return;
+
+    if (m_loopFd >= 0)
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, m_loopFd, nullptr);
+
+    m_display = display;
+    m_loop = display ? wl_display_get_event_loop(display) : nullptr;
+    m_loopFd = m_loop ? wl_event_loop_get_fd(m_loop) : -1;
+
+    if (m_loopFd >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = m_loopFd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_loopFd, &event);
+    }
+}
+
+bool QWlrootsEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags)
+{
+    m_interrupted = false;
+
+    Q_EMIT awake();
+    QCoreApplication::sendPostedEvents();
+    bool hasEvents = QWindowSystemInterface::sendWindowSystemEvents(flags);
+
+    if (m_interrupted)
+        return hasEvents;
+
+    const bool canWait = flags.testFlag(QEventLoop::WaitForMoreEvents)
+        && !hasEvents
+        && QThreadData::current()->canWaitLocked()
+        && !QWindowSystemInterface::windowSystemEventsQueued();
+    if (canWait)
+        Q_EMIT aboutToBlock();
+
+    if (m_loop) {
+        wl_event_loop_dispatch_idle(m_loop);
+        // The only flush of this iteration, all requests of the clients
+        // are handled after the last waiting.
+        wl_display_flush_clients(m_display);
+    }
+
+    const bool excludeNotifiers = flags.testFlag(QEventLoop::ExcludeSocketNotifiers);
+    // The input devices of wlroots are dispatched by the wl_event_loop,
+    // so are the requests of the clients.
+    const bool excludeLoop = flags.testFlag(QEventLoop::ExcludeUserInputEvents);
+
+    const int timeout = canWait && !m_interrupted ? timeToNextTimer(monotonicTime()) : 0;
+    // The epoll is level triggered, an excluded fd is reported again by the
+    // next processEvents, but it can't be watched while waiting, otherwise
+    // epoll_wait returns at once if it's readable.
+    const bool unwatch = timeout != 0
+        && ((excludeNotifiers && !m_socketNotifiers.isEmpty())
+            || (excludeLoop && m_loopFd >= 0));
+    if (unwatch)
+        setExcludedWatched(excludeNotifiers, excludeLoop, false);
+
+    epoll_event events[MaxEvents];
+    int count = epoll_wait(m_epollFd, events, MaxEvents, timeout);
+    if (count < 0 && errno != EINTR)
+        qCWarning(lcEventDispatcher) << "epoll_wait failed:" << strerror(errno);
+
+    if (unwatch)
+        setExcludedWatched(excludeNotifiers, excludeLoop, true);
+
+    for (int i = 0; i < count; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == m_wakeUpFd) {
+            eventfd_t value;
+            eventfd_read(m_wakeUpFd, &value);
+        } else if (fd == m_loopFd) {
+            if (excludeLoop)
+                continue;
+            if (m_loop) {
+                int ret = wl_event_loop_dispatch(m_loop, 0);
+                if (ret)
+                    qCWarning(lcEventDispatcher) << "wl_event_loop_dispatch error:" << ret;
+            }
+        } else {
+            if (excludeNotifiers)
+                continue;
+            activateSocketNotifiers(fd, events[i].events);
+        }
+        hasEvents = true;
+    }
+
+    if (activateTimers())
+        hasEvents = true;
+
+    return hasEvents;
+}
+
+void QWlrootsEventDispatcher::registerSocketNotifier(QSocketNotifier *notifier)
+{
+    const int fd = notifier->socket();
+    const bool isNew = !m_socketNotifiers.contains(fd);
+    auto &notifiers = m_socketNotifiers[fd];
+
+    switch (notifier->type()) {
+    case QSocketNotifier::Read:
+        notifiers.read = notifier;
+        break;
+    case QSocketNotifier::Write:
+        notifiers.write = notifier;
+        break;
+    case QSocketNotifier::Exception:
+        notifiers.exception = notifier;
+        break;
+    }
+
+    updateSocketNotifiers(fd, notifiers, isNew);
+}
+
+void QWlrootsEventDispatcher::unregisterSocketNotifier(QSocketNotifier *notifier)
+{
+    const int fd = notifier->socket();
+    auto it = m_socketNotifiers.find(fd);
+    if (it == m_socketNotifiers.end())
+        return;
+
+    if (it->read == notifier)
+        it->read = nullptr;
+    if (it->write == notifier)
+        it->write = nullptr;
+    if (it->exception == notifier)
+        it->exception = nullptr;
+
+    if (it->isEmpty()) {
+        m_socketNotifiers.erase(it);
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    } else {
+        updateSocketNotifiers(fd, *it, false);
+    }
+}
+
+void QWlrootsEventDispatcher::updateSocketNotifiers(int fd, const SocketNotifiers &notifiers, bool isNew)
+{
+    epoll_event event = {};
+    if (notifiers.read)
+        event.events |= EPOLLIN;
+    if (notifiers.write)
+        event.events |= EPOLLOUT;
+    if (notifiers.exception)
+        event.events |= EPOLLPRI;
+    event.data.fd = fd;
+
+    if (epoll_ctl(m_epollFd, isNew ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0)
+        qCWarning(lcEventDispatcher) << "Failed to watch the socket" << fd << strerror(errno);
+}
+
+void QWlrootsEventDispatcher::setExcludedWatched(bool notifiers, bool loop, bool watched)
+{
+    epoll_event event = {};
+    if (notifiers) {
+        for (auto it = m_socketNotifiers.cbegin(); it != m_socketNotifiers.cend(); ++it) {
+            if (watched) {
+                updateSocketNotifiers(it.key(), it.value(), false);
+            } else {
+                event.data.fd = it.key();
+                epoll_ctl(m_epollFd, EPOLL_CTL_MOD, it.key(), &event);
+            }
+        }
+    }
+
+    if (loop && m_loopFd >= 0) {
+        event.events = watched ? EPOLLIN : 0;
+        event.data.fd = m_loopFd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, m_loopFd, &event);
+    }
+}
+
+void QWlrootsEventDispatcher::activateSocketNotifiers(int fd, uint32_t events)
+{
+    // Same as QEventDispatcherUNIX, the error also wakes up the readers and writers
+    const bool error = events & (EPOLLERR | EPOLLHUP);
+    const std::pair<QSocketNotifier *SocketNotifiers::*, bool> types[] = {
+        {&SocketNotifiers::read, error || (events & EPOLLIN)},
+        {&SocketNotifiers::write, error || (events & EPOLLOUT)},
+        {&SocketNotifiers::exception, bool(events & EPOLLPRI)},
+    };
+
+    for (const auto &type : types) {
+        if (!type.second)
+            continue;
+        // The notifiers maybe changed by the previous one
+        auto it = m_socketNotifiers.constFind(fd);
+        if (it == m_socketNotifiers.constEnd())
+            return;
+        if (auto notifier = (*it).*type.first) {
+            QEvent event(QEvent::SockAct);
+            QCoreApplication::sendEvent(notifier, &event);
+        }
+    }
+}
+
+void QWlrootsEventDispatcher::registerTimer(int timerId, qint64 interval, Qt::TimerType timerType, QObject *object)
+{
+    Q_ASSERT(timerId > 0 && interval >= 0 && object);
+    // Same as QTimerInfoList, the very coarse timers have the precision of seconds
+    if (timerType == Qt::VeryCoarseTimer)
+        interval = (interval + 500) / 1000 * 1000;
+
+    m_timers.insert(timerId, Timer {
+        .id = timerId,
+        .interval = interval,
+        .type = timerType,
+        .object = object,
+        .deadline = monotonicTime() + interval * 1000000,
+    });
+}
+
+bool QWlrootsEventDispatcher::unregisterTimer(int timerId)
+{
+    return m_timers.remove(timerId);
+}
+
+bool QWlrootsEventDispatcher::unregisterTimers(QObject *object)
+{
+    return m_timers.removeIf([object] (const auto &it) {
+        return it.value().object == object;
+    }) > 0;
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> QWlrootsEventDispatcher::registeredTimers(QObject *object) const
+{
+    QList<TimerInfo> list;
+    for (const auto &timer : m_timers) {
+        if (timer.object == object)
+            list.append(TimerInfo(timer.id, timer.interval, timer.type));
+    }
+
+    return list;
+}
+
+int QWlrootsEventDispatcher::remainingTime(int timerId)
+{
+    auto it = m_timers.constFind(timerId);
+    if (it == m_timers.constEnd())
+        return -1;
+
+    const qint64 remaining = it->deadline - monotonicTime();
+    return remaining > 0 ? int((remaining + 999999) / 1000000) : 0;
+}
+
+void QWlrootsEventDispatcher::wakeUp()
+{
+    eventfd_write(m_wakeUpFd, 1);
+}
+
+void QWlrootsEventDispatcher::interrupt()
+{
+    m_interrupted = true;
+    wakeUp();
+}
+
+int QWlrootsEventDispatcher::timeToNextTimer(qint64 now) const
+{
+    qint64 deadline = -1;
+    for (const auto &timer : m_timers) {
+        if (timer.activating)
+            continue;
+        if (deadline < 0 || timer.deadline < deadline)
+            deadline = timer.deadline;
+    }
+
+    if (deadline < 0)
+        return -1;
+    if (deadline <= now)
+        return 0;
+    // Round up, don't wake up before the deadline
+    return int((deadline - now + 999999) / 1000000);
+}
+
+bool QWlrootsEventDispatcher::activateTimers()
+{
+    const qint64 now = monotonicTime();
+    QVarLengthArray<int, 16> expired;
+    for (const auto &timer : std::as_const(m_timers)) {
+        if (!timer.activating && timer.deadline <= now)
+            expired.append(timer.id);
+    }
+
+    for (int id : std::as_const(expired)) {
+        // Maybe unregistered by the previous timer
+        auto it = m_timers.find(id);
+        if (it == m_timers.end() || it->activating)
+            continue;
+
+        it->deadline += it->interval * 1000000;
+        // Skip the missed intervals
+        if (it->deadline <= now)
+            it->deadline = now + it->interval * 1000000;
+        // Avoid activating again in the nested event loop
+        it->activating = true;
+
+        QTimerEvent event(id);
+        QCoreApplication::sendEvent(it->object, &event);
+
+        it = m_timers.find(id);
+        if (it != m_timers.end())
+            it->activating = false;
+    }
+
+    return !expired.isEmpty();
+}
+
+WAYLIB_SERVER_END_NAMESPACE
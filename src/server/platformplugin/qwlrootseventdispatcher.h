@@ -0,0 +1,86 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include "wglobal.h"
+
+#include <QAbstractEventDispatcher>
+#include <QHash>
+
+#include <atomic>
+
+struct wl_display;
+struct wl_event_loop;
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// An epoll based event dispatcher of the main thread, the wl_event_loop of
+// WServer is nested in it, so the wayland events, the socket notifiers and the
+// timers of Qt are waited by one epoll_wait, and the clients are flushed once
+// before waiting. Enabled by WAYLIB_EPOLL_EVENT_DISPATCHER=1.
+class Q_DECL_HIDDEN QWlrootsEventDispatcher : public QAbstractEventDispatcher
+{
+    Q_OBJECT
+public:
+    explicit QWlrootsEventDispatcher(QObject *parent = nullptr);
+    ~QWlrootsEventDispatcher() override;
+
+    static bool isEnabled();
+
+    void setWaylandDisplay(wl_display *display);
+
+    bool processEvents(QEventLoop::ProcessEventsFlags flags) override;
+
+    void registerSocketNotifier(QSocketNotifier *notifier) override;
+    void unregisterSocketNotifier(QSocketNotifier *notifier) override;
+
+    void registerTimer(int timerId, qint64 interval, Qt::TimerType timerType, QObject *object) override;
+    bool unregisterTimer(int timerId) override;
+    bool unregisterTimers(QObject *object) override;
+    QList<TimerInfo> registeredTimers(QObject *object) const override;
+    int remainingTime(int timerId) override;
+
+    void wakeUp() override;
+    void interrupt() override;
+
+private:
+    struct SocketNotifiers {
+        QSocketNotifier *read = nullptr;
+        QSocketNotifier *write = nullptr;
+        QSocketNotifier *exception = nullptr;
+
+        inline bool isEmpty() const {
+            return !read && !write && !exception;
+        }
+    };
+
+    struct Timer {
+        int id;
+        qint64 interval; // milliseconds
+        Qt::TimerType type;
+        QObject *object;
+        qint64 deadline; // nanoseconds of CLOCK_MONOTONIC
+        bool activating = false;
+    };
+
+    void updateSocketNotifiers(int fd, const SocketNotifiers &notifiers, bool isNew);
+    // Stop or restart watching the fds excluded by the ProcessEventsFlags
+    void setExcludedWatched(bool notifiers, bool loop, bool watched);
+    void activateSocketNotifiers(int fd, uint32_t events);
+    int timeToNextTimer(qint64 now) const;
+    bool activateTimers();
+
+    int m_epollFd = -1;
+    int m_wakeUpFd = -1;
+    std::atomic_bool m_interrupted = false;
+
+    wl_display *m_display = nullptr;
+    wl_event_loop *m_loop = nullptr;
+    int m_loopFd = -1;
+
+    QHash<int, SocketNotifiers> m_socketNotifiers;
+    QHash<int, Timer> m_timers;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
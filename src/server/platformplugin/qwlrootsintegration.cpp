@@ -9,6 +9,7 @@
 #include "qwlrootsintegration.h"
 #include "qwlrootscreen.h"
 #include "qwlrootswindow.h"
+#include "qwlrootseventdispatcher.h"
 #include "woutput.h"
 #include "winputdevice.h"
 #include "types.h"
@@ -398,6 +399,8 @@ QOpenGLContext::OpenGLModuleType QWlrootsIntegration::openGLModuleType()
 
 QAbstractEventDispatcher *QWlrootsIntegration::createEventDispatcher() const
 {
+    if (!m_proxyIntegration && QWlrootsEventDispatcher::isEnabled())
+        return new QWlrootsEventDispatcher();
     return CALL_PROXY2(createEventDispatcher, createUnixEventDispatcher());
 }
 
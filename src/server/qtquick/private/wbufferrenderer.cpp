@@ -6,6 +6,7 @@
 #include "wqmlhelper_p.h"
 #include "wtools.h"
 #include "wsgtextureprovider.h"
+#include "wsgdamagetracker_p.h"
 
 #include <qwbuffer.h>
 #include <qwtexture.h>
@@ -17,6 +18,7 @@
 
 #include <QSGImageNode>
 #include <QSGSimpleRectNode>
+#include <QElapsedTimer>
 
 #define protected public
 #define private public
@@ -227,7 +229,10 @@ QColor WBufferRenderer::clearColor() const
 
 void WBufferRenderer::setClearColor(const QColor &clearColor)
 {
+    if (m_clearColor == clearColor)
+        return;
     m_clearColor = clearColor;
+    m_damageRing.add_whole();
 }
 
 QSGRenderer *WBufferRenderer::currentRenderer() const
@@ -368,7 +373,6 @@ qw_buffer *WBufferRenderer::beginRender(const QSize &pixelSize, qreal devicePixe
             return nullptr;
     }
 
-    // TODO: Support scanout buffer of wlr_surface(from WSurfaceItem)
     int bufferAge;
     auto wbuffer = m_swapchain->acquire(&bufferAge);
     if (!wbuffer)
@@ -424,6 +428,7 @@ qw_buffer *WBufferRenderer::beginRender(const QSize &pixelSize, qreal devicePixe
     }
 
     state.flags = flags;
+    state.needsFinish = false;
     state.context = wd->context;
     state.pixelSize = pixelSize;
     state.devicePixelRatio = devicePixelRatio;
@@ -450,6 +455,12 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
     QSGRenderer *renderer = ensureRenderer(sourceIndex, state.context);
     auto wd = QQuickWindowPrivate::get(window());
 
+    // The result of the previous drawing maybe used in this time
+    if (state.needsFinish) {
+        finishRhi(wd->rhi);
+        state.needsFinish = false;
+    }
+
     const qreal devicePixelRatio = state.devicePixelRatio;
     state.renderer = renderer;
     state.batchRenderer = dynamic_cast<QSGBatchRenderer::Renderer*>(renderer);
@@ -480,6 +491,7 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
     const auto viewportRect = scaleToRect(targetRect, devicePixelRatio);
 
     auto softwareRenderer = dynamic_cast<QSGSoftwareRenderer*>(renderer);
+    bool skipRender = false;
     { // before render
         if (softwareRenderer) {
             // Avoid do clear before paint, for the software renderer this
@@ -531,18 +543,31 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
             if (state.renderTarget.mirrorVertically())
                 flipY = !flipY;
 
-            if (viewportRect.isValid()) {
-                QRect vr = viewportRect;
-                if (flipY)
-                    vr.moveTop(-vr.y() + state.pixelSize.height() - vr.height());
-                renderer->setViewportRect(vr);
-            } else {
-                renderer->setViewportRect(QRect(QPoint(0, 0), state.pixelSize));
-            }
-
             QRectF rect = sourceRect;
             if (!rect.isValid())
                 rect = QRectF(QPointF(0, 0), QSizeF(state.pixelSize) / devicePixelRatio);
+            QRect vr = viewportRect.isValid() ? viewportRect
+                                              : QRect(QPoint(0, 0), state.pixelSize);
+
+            const QRect repaintRect = updateRhiDamage(m_sourceList[sourceIndex], rect, vr,
+                                                      preserveColorContents);
+            if (repaintRect.isEmpty()) {
+                // The contents of the buffer is up to date
+                skipRender = true;
+            } else if (repaintRect != vr) {
+                // Only repaint the damaged area, map it to the scene
+                const qreal xScale = rect.width() / vr.width();
+                const qreal yScale = rect.height() / vr.height();
+                rect = QRectF(rect.x() + (repaintRect.x() - vr.x()) * xScale,
+                              rect.y() + (repaintRect.y() - vr.y()) * yScale,
+                              repaintRect.width() * xScale,
+                              repaintRect.height() * yScale);
+                vr = repaintRect;
+            }
+
+            if (flipY)
+                vr.moveTop(-vr.y() + state.pixelSize.height() - vr.height());
+            renderer->setViewportRect(vr);
 
             const float left = rect.x();
             const float right = rect.x() + rect.width();
@@ -578,12 +603,11 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
         }
     }
 
-    state.context->renderNextFrame(renderer);
+    if (!skipRender)
+        state.context->renderNextFrame(renderer);
 
     { // after render
         if (!softwareRenderer) {
-            // TODO: get damage area from QRhi renderer
-            m_damageRing.add_whole();
             // ###: maybe Qt bug? Before executing QRhi::endOffscreenFrame, we may
             // use the same QSGRenderer for multiple drawings. This can lead to
             // rendering the same content for different QSGRhiRenderTarget instances
@@ -592,7 +616,12 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
             // sourceIndex, we should let the RHI (Rendering Hardware Interface)
             // complete the results of this drawing here to ensure the current
             // drawing result is available for use.
-            wd->rhi->finish();
+            if (!skipRender) {
+                if (state.flags.testFlag(DeferredFinish))
+                    state.needsFinish = true;
+                else
+                    finishRhi(wd->rhi);
+            }
         } else {
             state.dirty = softwareRenderer->flushRegion();
 
@@ -639,14 +668,95 @@ void WBufferRenderer::render(int sourceIndex, const QMatrix4x4 &renderMatrix,
         wTextureProvider()->setBuffer(state.buffer);
 }
 
+QRect WBufferRenderer::updateRhiDamage(Data &source, const QRectF &sourceRect,
+                                       const QRect &viewportRect, bool preserveColorContents)
+{
+    static bool disableDamageTracking = qEnvironmentVariableIsSet("WAYLIB_DISABLE_DAMAGE_TRACKING");
+    if (Q_UNLIKELY(disableDamageTracking)) {
+        m_damageRing.add_whole();
+        return viewportRect;
+    }
+
+    auto root = isRootItem(source.source)
+                    ? QQuickWindowPrivate::get(window())->renderer->rootNode()
+                    : WQmlHelper::getRootNode(source.source);
+    Q_ASSERT(root);
+    // The root node of the layer source is replaced, e.g. its layer is
+    // disabled and enabled again, the tracker is detached from the old one.
+    if (source.damageTracker && source.damageTracker->rootNode() != root) {
+        delete source.damageTracker;
+        source.damageTracker = nullptr;
+    }
+    if (!source.damageTracker)
+        source.damageTracker = new WSGDamageTracker(root);
+
+    // Map the scene to the pixel coordinate of the buffer
+    QTransform transform = state.worldTransform.toTransform();
+    transform *= QTransform::fromTranslate(-sourceRect.x(), -sourceRect.y());
+    transform *= QTransform::fromScale(viewportRect.width() / sourceRect.width(),
+                                       viewportRect.height() / sourceRect.height());
+    transform *= QTransform::fromTranslate(viewportRect.x(), viewportRect.y());
+
+    bool fullDamage = false;
+    const QRegion sceneDamage = source.damageTracker->takeDamage(&fullDamage);
+    if (fullDamage || source.damageTransform != transform) {
+        source.damageTransform = transform;
+        m_damageRing.add_whole();
+    } else if (!sceneDamage.isEmpty()) {
+        QRegion damage;
+        for (const QRect &r : sceneDamage) {
+            // Add a pixel for the antialiasing of the QSGBatchRenderer
+            damage += transform.mapRect(QRectF(r)).toAlignedRect().adjusted(-1, -1, 1, 1);
+        }
+        damage &= viewportRect;
+
+        PixmanRegion region;
+        if (WTools::toPixmanRegion(damage, region))
+            m_damageRing.add(region);
+    }
+
+    // The partial repaint depends on the old contents of the buffer. If there are
+    // multiple sources, the later sources are drawn over the earlier sources, the
+    // damage of a source can't decide the repaint area of others.
+    if (m_sourceList.size() > 1 || state.bufferAge <= 0)
+        return viewportRect;
+
+    PixmanRegion bufferDamage;
+    m_damageRing.get_buffer_damage(state.bufferAge, bufferDamage);
+    const QRect repaintRect = WTools::fromPixmanRegion(bufferDamage).boundingRect() & viewportRect;
+    if (repaintRect.isEmpty())
+        return {};
+
+    // QRhi will clear the whole render target if the color contents isn't preserved,
+    // and the translucent items can't draw over the old contents.
+    if (!preserveColorContents)
+        return viewportRect;
+
+    return repaintRect;
+}
+
+void WBufferRenderer::finishRhi(QRhi *rhi)
+{
+    QElapsedTimer timer;
+    timer.start();
+    rhi->finish();
+    m_waitTime += timer.nsecsElapsed();
+}
+
 void WBufferRenderer::endRender()
 {
     Q_ASSERT(state.buffer);
+    // The buffer is released before the end of the frame, e.g. the contents of
+    // the output are composited by another renderer with the hardware layers
+    if (state.needsFinish)
+        finishRhi(QQuickWindowPrivate::get(window())->rhi);
+
     auto buffer = state.buffer;
     state.buffer = nullptr;
     state.renderer = nullptr;
     state.batchRenderer = nullptr;
     state.dirty = QRegion();
+    state.needsFinish = false;
 
     m_lastBuffer = buffer;
     m_damageRing.rotate();
@@ -751,6 +861,8 @@ void WBufferRenderer::resetSources()
 void WBufferRenderer::removeSource(int index)
 {
     auto s = m_sourceList.at(index);
+    if (s.damageTracker)
+        delete s.damageTracker;
     if (isRootItem(s.source))
         return;
 
@@ -19,6 +19,7 @@ Q_MOC_INCLUDE(<private/qsgplaintexture_p.h>)
 QT_BEGIN_NAMESPACE
 class QSGPlainTexture;
 class QSGRenderContext;
+class QRhi;
 namespace QSGBatchRenderer {
 class Renderer;
 }
@@ -35,6 +36,7 @@ WAYLIB_SERVER_BEGIN_NAMESPACE
 
 class WRenderHelper;
 class WSGTextureProvider;
+class WSGDamageTracker;
 class WAYLIB_SERVER_EXPORT WBufferRenderer : public QQuickItem
 {
     friend class WOutputRenderWindow;
@@ -48,6 +50,9 @@ public:
         DontTestSwapchain = 2,
         RedirectOpenGLContextDefaultFrameBufferObject = 4,
         UseCursorFormats = 8,
+        // Don't wait for the GPU in render(), the caller must wait (QRhi::finish or
+        // QRhi::endOffscreenFrame) before using the buffer
+        DeferredFinish = 16,
     };
     Q_DECLARE_FLAGS(RenderFlags, RenderFlag)
 
@@ -103,6 +108,11 @@ protected:
     void endRender();
     void componentComplete() override;
 
+    // In nanoseconds, the time waiting for the GPU in render() since the last call
+    inline qint64 takeWaitTime() {
+        return std::exchange(m_waitTime, 0);
+    }
+
 private:
     inline WOutputRenderWindow *renderWindow() const {
         return qobject_cast<WOutputRenderWindow*>(parent());
@@ -128,10 +138,12 @@ private:
     void removeSource(int index);
     int indexOfSource(QQuickItem *item);
     QSGRenderer *ensureRenderer(int sourceIndex, QSGRenderContext *rc);
+    void finishRhi(QRhi *rhi);
 
     QW_NAMESPACE::qw_swapchain *m_swapchain = nullptr;
     WRenderHelper *m_renderHelper = nullptr;
     QPointer<QW_NAMESPACE::qw_buffer> m_lastBuffer;
+    qint64 m_waitTime = 0;
 
     struct RenderState {
         RenderFlags flags;
@@ -146,6 +158,7 @@ private:
         QQuickRenderTarget renderTarget;
         QSGRenderTarget sgRenderTarget;
         QRegion dirty;
+        bool needsFinish = false;
     } state;
 
     QPointer<WOutput> m_output;
@@ -153,8 +166,14 @@ private:
     struct Data {
         QQuickItem *source = nullptr; // Don't using QPointer, See isRootItem
         QSGRenderer *renderer = nullptr;
+        // Only for the RHI renderer, the software renderer has its own damage
+        WSGDamageTracker *damageTracker = nullptr;
+        QTransform damageTransform;
     };
 
+    QRect updateRhiDamage(Data &source, const QRectF &sourceRect,
+                          const QRect &viewportRect, bool preserveColorContents);
+
     QList<Data> m_sourceList;
     QW_NAMESPACE::qw_damage_ring m_damageRing;
     mutable std::unique_ptr<WSGTextureProvider> m_textureProvider;
@@ -0,0 +1,137 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wframescheduler_p.h"
+
+#include <algorithm>
+#include <utility>
+#include <time.h>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// Extra time reserved for the jitter of the render time
+static constexpr qint64 MinSafetyMargin = 1000000; // 1ms
+// Not worth to start a timer for a shorter delay
+static constexpr qint64 MinRenderDelay = 500000; // 0.5ms
+
+WFrameScheduler::WFrameScheduler()
+    : m_safetyMargin(MinSafetyMargin)
+{
+    m_renderTimes.fill(0);
+}
+
+void WFrameScheduler::setRefreshInterval(qint64 interval)
+{
+    m_refreshInterval = std::max<qint64>(interval, 0);
+}
+
+qint64 WFrameScheduler::refreshInterval() const
+{
+    return m_presentRefresh > 0 ? m_presentRefresh : m_refreshInterval;
+}
+
+qint64 WFrameScheduler::frameDelay(qint64 now)
+{
+    const qint64 interval = refreshInterval();
+    m_frameTarget = predictVblank(now);
+
+    qint64 delay = 0;
+    // Render immediately until the render time is known
+    if (m_frameTarget > 0 && m_renderTimeCount > 0) {
+        m_stats.predictedRenderTime = predictRenderTime() + m_safetyMargin;
+        delay = std::clamp<qint64>(m_frameTarget - now - m_stats.predictedRenderTime, 0, interval);
+        if (delay < MinRenderDelay)
+            delay = 0;
+    }
+
+    m_stats.renderDelay = delay;
+    return delay;
+}
+
+void WFrameScheduler::beginFrame(qint64 now)
+{
+    m_frameBeginTime = now;
+}
+
+void WFrameScheduler::endFrame(qint64 now)
+{
+    if (m_frameBeginTime <= 0)
+        return;
+
+    const qint64 renderTime = std::max<qint64>(now - m_frameBeginTime, 0);
+    m_frameBeginTime = 0;
+
+    m_renderTimes[m_renderTimeIndex] = renderTime;
+    m_renderTimeIndex = (m_renderTimeIndex + 1) % RenderTimeSamples;
+    m_renderTimeCount = std::min(m_renderTimeCount + 1, RenderTimeSamples);
+    m_stats.lastRenderTime = renderTime;
+    m_pendingTarget = m_frameTarget;
+}
+
+void WFrameScheduler::presented(qint64 when, qint64 refresh, bool presented)
+{
+    if (refresh > 0)
+        m_presentRefresh = refresh;
+
+    const qint64 target = std::exchange(m_pendingTarget, 0);
+    if (!presented)
+        return;
+
+    m_lastPresentTime = when;
+    ++m_stats.presentedFrames;
+
+    const qint64 interval = refreshInterval();
+    if (target <= 0 || interval <= 0)
+        return;
+
+    if (when > target + interval / 2) {
+        // Missed the vblank, be more conservative for the next frames
+        ++m_stats.missedFrames;
+        m_safetyMargin = std::min(m_safetyMargin * 2, interval / 2);
+    } else {
+        m_safetyMargin = std::max(MinSafetyMargin, m_safetyMargin - m_safetyMargin / 16);
+    }
+}
+
+void WFrameScheduler::reset()
+{
+    m_renderTimes.fill(0);
+    m_renderTimeCount = 0;
+    m_renderTimeIndex = 0;
+    m_presentRefresh = 0;
+    m_lastPresentTime = 0;
+    m_frameBeginTime = 0;
+    m_frameTarget = 0;
+    m_pendingTarget = 0;
+    m_safetyMargin = MinSafetyMargin;
+    m_stats = {};
+}
+
+qint64 WFrameScheduler::monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+qint64 WFrameScheduler::predictVblank(qint64 now) const
+{
+    const qint64 interval = refreshInterval();
+    if (interval <= 0)
+        return 0;
+
+    if (m_lastPresentTime <= 0 || m_lastPresentTime > now)
+        return now + interval;
+
+    return m_lastPresentTime + ((now - m_lastPresentTime) / interval + 1) * interval;
+}
+
+qint64 WFrameScheduler::predictRenderTime() const
+{
+    // Use the worst case of the recent frames, missing a vblank costs
+    // much more than rendering a little earlier.
+    return *std::max_element(m_renderTimes.cbegin(),
+                             m_renderTimes.cbegin() + m_renderTimeCount);
+}
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,78 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QtGlobal>
+
+#include <array>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// Decides how long the rendering of an output can be delayed after the frame
+// event, so that the rendering finishes just before the next vblank instead
+// of right after the previous one. It learns the render time from the recent
+// frames and the vblank timing from the present events of the output.
+//
+// It doesn't read any clock itself, all the times are passed in by the caller
+// (in nanoseconds of CLOCK_MONOTONIC, the clock of the present events), so it
+// can be driven by a synthetic clock.
+class WAYLIB_SERVER_EXPORT WFrameScheduler
+{
+public:
+    WFrameScheduler();
+
+    struct Stats {
+        // The delay chosen for the last frame
+        qint64 renderDelay = 0;
+        // The render time (with the safety margin) used to choose the delay
+        qint64 predictedRenderTime = 0;
+        qint64 lastRenderTime = 0;
+        quint64 presentedFrames = 0;
+        // The frames presented after the vblank they targeted
+        quint64 missedFrames = 0;
+    };
+
+    // Fallback if no present event provides the refresh interval,
+    // e.g. from the current mode of the output.
+    void setRefreshInterval(qint64 interval);
+    qint64 refreshInterval() const;
+
+    // Call on the frame event, returns the time to wait before rendering.
+    qint64 frameDelay(qint64 now);
+    void beginFrame(qint64 now);
+    void endFrame(qint64 now);
+    void presented(qint64 when, qint64 refresh, bool presented);
+    void reset();
+
+    inline const Stats &stats() const {
+        return m_stats;
+    }
+
+    static qint64 monotonicTime();
+
+private:
+    qint64 predictVblank(qint64 now) const;
+    qint64 predictRenderTime() const;
+
+    static constexpr int RenderTimeSamples = 16;
+
+    std::array<qint64, RenderTimeSamples> m_renderTimes;
+    int m_renderTimeCount = 0;
+    int m_renderTimeIndex = 0;
+
+    qint64 m_refreshInterval = 0;
+    qint64 m_presentRefresh = 0;
+    qint64 m_lastPresentTime = 0;
+    qint64 m_frameBeginTime = 0;
+    qint64 m_frameTarget = 0;
+    // The target vblank of the committed frame waiting for its present event
+    qint64 m_pendingTarget = 0;
+    qint64 m_safetyMargin;
+
+    Stats m_stats;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -29,6 +29,7 @@ public:
         , ignoreViewport(false)
         , disableHardwareLayers(false)
         , ignoreSoftwareLayers(false)
+        , directScanout(false)
     {
 
     }
@@ -61,6 +62,12 @@ public:
             return;
         Q_EMIT q_func()->hardwareLayersChanged();
     }
+    inline void setDirectScanout(bool on) {
+        if (directScanout == on)
+            return;
+        directScanout = on;
+        Q_EMIT q_func()->directScanoutChanged();
+    }
 
     qreal calculateImplicitWidth() const;
     qreal calculateImplicitHeight() const;
@@ -90,6 +97,7 @@ public:
     uint ignoreViewport:1;
     uint disableHardwareLayers:1;
     uint ignoreSoftwareLayers:1;
+    uint directScanout:1;
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -12,10 +12,13 @@
 #include "wrenderbuffernode_p.h"
 #include "wbufferrenderer_p.h"
 #include "wqmlhelper_p.h"
+#include "woutputrenderwindow.h"
 #include "platformplugin/types.h"
 
 #include <QQuickItem>
 #include <QRunnable>
+#include <QFile>
+#include <QtMath>
 #include <QSGImageNode>
 #include <private/qquickitem_p.h>
 #include <private/qsgplaintexture_p.h>
@@ -27,6 +30,8 @@
 #include <private/qquickrendercontrol_p.h>
 
 #include <algorithm>
+#include <limits>
+#include <list>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -37,6 +42,13 @@ public:
 
     explicit DataManagerBase(QQuickWindow *owner)
         : QObject(owner) {}
+
+protected:
+    // Unique in all windows, the buffers may be moved to another window
+    static quint64 nextGeneration() {
+        static QBasicAtomicInteger<quint64> generation = Q_BASIC_ATOMIC_INITIALIZER(0);
+        return generation.fetchAndAddRelaxed(1) + 1;
+    }
 };
 
 template <class T>
@@ -122,13 +134,44 @@ private:
     QPointer<T> pointer;
 };
 
-template <class Derive, class DataType, typename... DataKeys>
+struct BufferKey
+{
+    int format = 0;
+    QSize size;
+
+    bool operator==(const BufferKey &other) const = default;
+};
+
+inline size_t qHash(const BufferKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.format, key.size.width(), key.size.height());
+}
+
+// A pool of the buffers of a window, the buffers released by a node can be
+// reused by any other node that needs the same format and size. The unused
+// buffers are kept until they are idle for too long or the memory they held
+// exceeds the budget of the window, the least recently used one is destroyed
+// first.
+// The sizes of the bucketed buffers are rounded up, a node being resized
+// keeps its buffer or reuses one of the neighboring sizes, the contents are
+// in the top left of the buffer. The buffers sampled as a whole (e.g. by a
+// ShaderEffect) are in the exact size, the budget limits the memory held by
+// the buffers of the old sizes.
+template <class Derive, class DataType, typename Format>
 class Q_DECL_HIDDEN DataManager : public DataManagerBase
 {
 public:
     struct Data {
-        int released = 0;
         DataType *data = nullptr;
+        BufferKey key;
+        qint64 bytes = 0;
+        bool inUse = false;
+        quint64 releasedFrame = 0;
+        // Changed whenever the buffer is given to a node, the contents may be
+        // overwritten by another node since the buffer was released.
+        quint64 generation = 0;
+        // Valid only if not in use
+        typename std::list<Data*>::iterator lruIterator;
     };
 
     static DataManagerPointer<Derive> get(QQuickWindow *owner) {
@@ -152,54 +195,84 @@ public:
         return static_cast<QQuickWindow*>(parent());
     }
 
-    std::weak_ptr<Data> resolve(std::weak_ptr<Data> data, DataKeys&&... keys) {
-        struct TryClean {
-            TryClean(DataManager *m)
-                : manager(m) {}
-            ~TryClean() {
-                manager->tryClean();
-            }
-            DataManager *manager;
-        };
-
-        TryClean cleanJob(this);
-        Q_UNUSED(cleanJob)
-
-        {
-            auto d = data.lock();
-            if (d && dataList.contains(d)) {
-                if (get()->check(d->data, std::forward<DataKeys>(keys)...)) {
-                    d->released = 0;
-                    return data;
-                }
-                release(data);
-            }
-        }
+    std::weak_ptr<Data> resolve(std::weak_ptr<Data> data, Format format, const QSize &size,
+                                bool bucketed = false) {
+        tryClean();
+        const BufferKey key { int(format), bucketed ? bucketSize(size) : size };
 
-        for (auto data : std::as_const(dataList)) {
-            if (get()->check(data->data, std::forward<DataKeys>(keys)...)) {
-                data->released = 0;
+        if (auto d = data.lock(); d && d->inUse && dataList.contains(d.get())) {
+            if (d->key == key)
                 return data;
-            }
+            release(d);
         }
 
-        auto newData = std::shared_ptr<Data>(new Data());
-        if ((newData->data = get()->create(std::forward<DataKeys>(keys)...))) {
-            dataList.append(newData);
-            return newData;
+        auto &freeList = freeLists[key];
+        if (!freeList.isEmpty()) {
+            Data *d = freeList.takeLast();
+            lruList.erase(d->lruIterator);
+            d->inUse = true;
+            d->generation = nextGeneration();
+            bytesInUse += d->bytes;
+            ++stats.hits;
+            return dataList.value(d);
         }
-
-        return {};
+        ++stats.misses;
+
+        DataType *newData = get()->create(format, size);
+        if (!newData)
+            return {};
+
+        auto d = std::make_shared<Data>();
+        d->data = newData;
+        d->key = key;
+        d->bytes = Derive::byteSize(newData);
+        d->inUse = true;
+        d->generation = nextGeneration();
+        dataList.insert(d.get(), d);
+        bytesHeld += d->bytes;
+        bytesInUse += d->bytes;
+        // Make room for the new buffer
+        trim(budget());
+
+        return d;
     }
 
     inline void release(std::weak_ptr<Data> data) {
         auto d = data.lock();
-        if (!d)
+        if (!d || !d->inUse || !dataList.contains(d.get()))
             return;
-        d->released++;
+
+        d->inUse = false;
+        d->releasedFrame = frameCounter;
+        bytesInUse -= d->bytes;
+        freeLists[d->key].append(d.get());
+        d->lruIterator = lruList.insert(lruList.end(), d.get());
+        trim(budget());
+    }
+
+    inline void addCopiedBytes(qint64 bytes) {
+        stats.bytesCopied += bytes;
+    }
+
+    WRenderBufferNode::PoolStats poolStats() const {
+        auto s = stats;
+        s.bytesHeld = bytesHeld;
+        s.bytesInUse = bytesInUse;
+        return s;
+    }
+
+    // The width and the height of the bucketed buffers are the multiples of it
+    static constexpr int BucketSize = 64;
+
+    static inline QSize bucketSize(const QSize &size) {
+        return QSize((size.width() + BucketSize - 1) / BucketSize * BucketSize,
+                     (size.height() + BucketSize - 1) / BucketSize * BucketSize);
     }
 
 protected:
+    // The unused buffers are destroyed after this number of frames
+    static constexpr quint64 MaxIdleFrames = 60;
+
     struct CleanJob : public QRunnable {
         CleanJob(DataManager *manager)
             : manager(manager) {}
@@ -209,21 +282,16 @@ protected:
                 return;
 
             manager->cleanJob = nullptr;
-
-            QList<std::shared_ptr<Data>> tmp;
-            std::swap(manager->dataList, tmp);
-            manager->dataList.reserve(tmp.size());
-
-            for (const auto &data : std::as_const(tmp)) {
-                if (data->released > 2) {
-                    manager->get()->destroy(data->data);
-                } else {
-                    manager->dataList << data;
-
-                    if (data->released > 0)
-                        ++data->released;
-                }
+            ++manager->frameCounter;
+
+            // The lruList is sorted by the released frame
+            while (!manager->lruList.empty()) {
+                Data *d = manager->lruList.front();
+                if (manager->frameCounter - d->releasedFrame <= MaxIdleFrames)
+                    break;
+                manager->destroyData(d);
             }
+            manager->trim(manager->budget());
         }
 
         QPointer<DataManager> manager;
@@ -236,6 +304,35 @@ protected:
         }
     }
 
+    inline qint64 budget() const {
+        auto window = qobject_cast<WOutputRenderWindow*>(owner());
+        return window ? window->renderBufferPoolBudget() : std::numeric_limits<qint64>::max();
+    }
+
+    // Only the unused buffers can be destroyed, the buffers in use may
+    // still exceed the budget.
+    void trim(qint64 maxBytes) {
+        while (bytesHeld > maxBytes && !lruList.empty()) {
+            destroyData(lruList.front());
+            ++stats.evictions;
+        }
+    }
+
+    void destroyData(Data *d) {
+        Q_ASSERT(!d->inUse);
+        lruList.erase(d->lruIterator);
+        auto it = freeLists.find(d->key);
+        Q_ASSERT(it != freeLists.end());
+        it->removeOne(d);
+        if (it->isEmpty())
+            freeLists.erase(it);
+
+        bytesHeld -= d->bytes;
+        Derive::destroy(d->data);
+        d->data = nullptr;
+        dataList.remove(d);
+    }
+
     inline const Derive *get() const {
         return static_cast<const Derive*>(this);
     }
@@ -251,30 +348,60 @@ protected:
 
     using QObject::deleteLater;
     ~DataManager() {
-        for (auto data : std::as_const(dataList)) {
+        for (const auto &data : std::as_const(dataList)) {
             Derive::destroy(data->data);
+            data->data = nullptr;
         }
     }
 
-    QList<std::shared_ptr<Data>> dataList;
+    QHash<Data*, std::shared_ptr<Data>> dataList;
+    QHash<BufferKey, QList<Data*>> freeLists;
+    std::list<Data*> lruList;
+    qint64 bytesHeld = 0;
+    qint64 bytesInUse = 0;
+    quint64 frameCounter = 0;
+    WRenderBufferNode::PoolStats stats;
     QRunnable *cleanJob = nullptr;
 };
 
-class Q_DECL_HIDDEN RhiTextureManager : public DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format, const QSize&>
+static qint64 rhiTextureBytes(QRhiTexture *texture)
+{
+    int bytesPerPixel = 4;
+    switch (texture->format()) {
+    case QRhiTexture::R8:
+    case QRhiTexture::RED_OR_ALPHA8:
+        bytesPerPixel = 1;
+        break;
+    case QRhiTexture::RG8:
+    case QRhiTexture::R16:
+    case QRhiTexture::R16F:
+        bytesPerPixel = 2;
+        break;
+    case QRhiTexture::RGBA16F:
+        bytesPerPixel = 8;
+        break;
+    case QRhiTexture::RGBA32F:
+        bytesPerPixel = 16;
+        break;
+    default:
+        break;
+    }
+
+    const QSize size = texture->pixelSize();
+    return qint64(size.width()) * size.height() * bytesPerPixel;
+}
+
+class Q_DECL_HIDDEN RhiTextureManager : public DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format>
 {
     Q_OBJECT
 
     friend class DataManager;
 
     RhiTextureManager(QQuickWindow *owner)
-        : DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format, const QSize&>(owner) {
+        : DataManager<RhiTextureManager, QRhiTexture, QRhiTexture::Format>(owner) {
         Q_ASSERT(owner->findChildren<RhiTextureManager*>(Qt::FindDirectChildrenOnly).size() == 1);
     }
 
-    static bool check(QRhiTexture *texture, QRhiTexture::Format format, const QSize &size) {
-        return texture->format() == format && texture->pixelSize() == size;
-    }
-
     QRhiTexture *create(QRhiTexture::Format format, const QSize &size) {
         auto texture = owner()->rhi()->newTexture(format, size, 1, QRhiTexture::RenderTarget);
         if  (!texture->create()) {
@@ -288,9 +415,58 @@ class Q_DECL_HIDDEN RhiTextureManager : public DataManager<RhiTextureManager, QR
     static void destroy(QRhiTexture *texture) {
         texture->deleteLater();
     }
+
+    static qint64 byteSize(QRhiTexture *texture) {
+        return rhiTextureBytes(texture);
+    }
+};
+
+// The uniform block of the shaders/blur.vert and shaders/kawase_*.frag
+struct BlurUniforms {
+    float uvRect[4] = {0, 0, 1, 1};
+    float texelSize[2] = {0, 0};
+    float offset = 1;
+    float noise = 0;
+    float tint[4] = {0, 0, 0, 0};
+};
+static_assert(sizeof(BlurUniforms) == 48);
+
+// A triangle strip covers the whole render target, the texture coordinates
+// (0, 0) is the first row of the texture in any backend.
+static const float blurVertices[] = {
+    -1, -1, 0, 0,
+    1, -1, 1, 0,
+    -1, 1, 0, 1,
+    1, 1, 1, 1,
 };
 
-class Q_DECL_HIDDEN RhiManager : public DataManager<RhiManager, void>
+// The iterations and the offset (in the pixels of the each level) of the
+// dual kawase blur for the radius in pixels, every iteration halves the
+// size of the image.
+static int blurIterations(qreal radius, const QSize &size, qreal *offset)
+{
+    int iterations = 1;
+    while (iterations < 6 && (2 << (iterations + 1)) <= radius
+           && (std::min(size.width(), size.height()) >> (iterations + 1)) > 0) {
+        ++iterations;
+    }
+
+    *offset = std::max(1.0, radius / (1 << (iterations + 1)));
+    return iterations;
+}
+
+static QShader loadShader(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open the shader" << fileName;
+        return {};
+    }
+
+    return QShader::fromSerialized(file.readAll());
+}
+
+class Q_DECL_HIDDEN RhiManager : public DataManager<RhiManager, void, int>
 {
     Q_OBJECT
 public:
@@ -413,11 +589,122 @@ public:
         return render(oldDPR, oldCB, forceDepthTest);
     }
 
+    // The resources of the blur passes shared by all the nodes, the pipelines
+    // are recreated if the render pass isn't compatible with the old one.
+    struct BlurResources {
+        QShader vertexShader;
+        QShader downShader;
+        QShader upShader;
+        std::unique_ptr<QRhiBuffer> vertexBuffer;
+        bool vertexBufferUploaded = false;
+        std::unique_ptr<QRhiSampler> sampler;
+        // Only for the layout of the pipelines
+        std::unique_ptr<QRhiBuffer> layoutBuffer;
+        std::unique_ptr<QRhiTexture> layoutTexture;
+        std::unique_ptr<QRhiShaderResourceBindings> layoutBindings;
+        std::unique_ptr<QRhiRenderPassDescriptor> renderPassDescriptor;
+        std::unique_ptr<QRhiGraphicsPipeline> downPipeline;
+        std::unique_ptr<QRhiGraphicsPipeline> upPipeline;
+    };
+
+    BlurResources *blurResources(const QRhiRenderPassDescriptor *rpd) {
+        if (Q_UNLIKELY(!m_blur)) {
+            if (m_blurFailed)
+                return nullptr;
+
+            std::unique_ptr<BlurResources> blur(new BlurResources);
+            blur->vertexShader = loadShader(QStringLiteral(":/waylib/shaders/blur.vert.qsb"));
+            blur->downShader = loadShader(QStringLiteral(":/waylib/shaders/kawase_down.frag.qsb"));
+            blur->upShader = loadShader(QStringLiteral(":/waylib/shaders/kawase_up.frag.qsb"));
+
+            blur->vertexBuffer.reset(rhi()->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer,
+                                                      sizeof(blurVertices)));
+            blur->sampler.reset(rhi()->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None,
+                                                  QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+            blur->layoutBuffer.reset(rhi()->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer,
+                                                      sizeof(BlurUniforms)));
+            blur->layoutTexture.reset(rhi()->newTexture(QRhiTexture::RGBA8, QSize(1, 1)));
+
+            bool ok = blur->vertexShader.isValid() && blur->downShader.isValid()
+                      && blur->upShader.isValid() && blur->vertexBuffer->create()
+                      && blur->sampler->create() && blur->layoutBuffer->create()
+                      && blur->layoutTexture->create();
+            if (ok) {
+                blur->layoutBindings.reset(newBlurBindings(blur.get(), blur->layoutBuffer.get(),
+                                                           blur->layoutTexture.get()));
+                ok = blur->layoutBindings->create();
+            }
+
+            if (!ok) {
+                qWarning() << "Failed to create the resources of the blur, disable it";
+                m_blurFailed = true;
+                return nullptr;
+            }
+
+            m_blur = std::move(blur);
+        }
+
+        if (!m_blur->renderPassDescriptor || !m_blur->renderPassDescriptor->isCompatible(rpd)) {
+            m_blur->downPipeline.reset();
+            m_blur->upPipeline.reset();
+            m_blur->renderPassDescriptor.reset(rpd->newCompatibleRenderPassDescriptor());
+            m_blur->downPipeline.reset(newBlurPipeline(m_blur->downShader));
+            m_blur->upPipeline.reset(newBlurPipeline(m_blur->upShader));
+
+            if (!m_blur->downPipeline || !m_blur->upPipeline) {
+                m_blur->renderPassDescriptor.reset();
+                return nullptr;
+            }
+        }
+
+        return m_blur.get();
+    }
+
+    QRhiShaderResourceBindings *newBlurBindings(const BlurResources *blur, QRhiBuffer *uniforms,
+                                                QRhiTexture *source) const {
+        auto bindings = rhi()->newShaderResourceBindings();
+        bindings->setBindings({
+            QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage
+                                                            | QRhiShaderResourceBinding::FragmentStage,
+                                                     uniforms),
+            QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,
+                                                      source, blur->sampler.get()),
+        });
+
+        return bindings;
+    }
+
 private:
+    QRhiGraphicsPipeline *newBlurPipeline(const QShader &fragmentShader) const {
+        auto pipeline = rhi()->newGraphicsPipeline();
+        pipeline->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+        pipeline->setShaderStages({
+            { QRhiShaderStage::Vertex, m_blur->vertexShader },
+            { QRhiShaderStage::Fragment, fragmentShader },
+        });
+
+        QRhiVertexInputLayout inputLayout;
+        inputLayout.setBindings({ { 4 * sizeof(float) } });
+        inputLayout.setAttributes({
+            { 0, 0, QRhiVertexInputAttribute::Float2, 0 },
+            { 0, 1, QRhiVertexInputAttribute::Float2, 2 * sizeof(float) },
+        });
+        pipeline->setVertexInputLayout(inputLayout);
+        pipeline->setShaderResourceBindings(m_blur->layoutBindings.get());
+        pipeline->setRenderPassDescriptor(m_blur->renderPassDescriptor.get());
+
+        if (!pipeline->create()) {
+            delete pipeline;
+            return nullptr;
+        }
+
+        return pipeline;
+    }
+
     friend class DataManager;
 
     RhiManager(QQuickWindow *owner)
-        : DataManager<RhiManager, void>(owner) {
+        : DataManager<RhiManager, void, int>(owner) {
         Q_ASSERT(owner->findChildren<RhiManager*>(Qt::FindDirectChildrenOnly).size() == 1);
         std::unique_ptr<QOffscreenSurface> fallbackSurface(new QW::OffscreenSurface(nullptr));
         fallbackSurface->create();
@@ -443,21 +730,23 @@ private:
     }
 
     ~RhiManager() {
+        // Must be destroyed before the QRhi
+        m_blur.reset();
         delete renderer;
     }
 
-    static bool check() {
+    static void *create(int, const QSize &) {
         Q_UNREACHABLE();
-        return true;
+        return nullptr;
     }
 
-    static void *create() {
+    static void destroy(void*) {
         Q_UNREACHABLE();
-        return nullptr;
     }
 
-    static void destroy(void*) {
+    static qint64 byteSize(void*) {
         Q_UNREACHABLE();
+        return 0;
     }
 
     struct Rhi {
@@ -485,6 +774,8 @@ private:
     bool isBatchRenderer = false;
 
     QScopedPointer<Rhi> m_rhi;
+    std::unique_ptr<BlurResources> m_blur;
+    bool m_blurFailed = false;
 };
 
 static QSizeF mapSize(const QRectF &source, const QMatrix4x4 &matrix)
@@ -630,6 +921,7 @@ public:
             if (oldManager)
                 oldManager->release(texture);
             texture.reset();
+            releaseBlur(oldManager);
         }
 
         Q_ASSERT(ct->rhi() == window->rhi());
@@ -639,8 +931,17 @@ public:
         const bool hasRotation = renderMatrix.flags().testAnyFlags(QMatrix4x4::Rotation2D | QMatrix4x4::Rotation);
         QSize pixelSize;
 
+        captureRect = m_rect;
+        if (m_blur.radius > 0 && !hasRotation) {
+            // The blur needs the contents around the item, but not outside the render target
+            const qreal margin = m_blur.radius;
+            const QRectF targetRect = renderMatrix.inverted().mapRect(QRectF(QPointF(0, 0),
+                                                                             QSizeF(ct->pixelSize()) / devicePixelRatio));
+            captureRect = (m_rect.adjusted(-margin, -margin, margin, margin) & targetRect) | m_rect;
+        }
+
         if (hasRotation) {
-            const QSizeF size = mapSize(m_rect, renderMatrix) * devicePixelRatio;
+            const QSizeF size = mapSize(captureRect, renderMatrix) * devicePixelRatio;
             if (size.isEmpty()) {
                 reset();
                 return;
@@ -661,7 +962,7 @@ public:
         } else {
             renderData.reset();
 
-            QSizeF size = renderMatrix.mapRect(m_rect).size() * devicePixelRatio;
+            QSizeF size = renderMatrix.mapRect(captureRect).size() * devicePixelRatio;
             if (!size.isValid()) {
                 reset();
                 return;
@@ -670,7 +971,10 @@ public:
             pixelSize = size.toSize();
         }
 
-        texture = manager->resolve(texture, ct->format(), pixelSize);
+        // The blur passes and the rotated rendering use the whole texture
+        const bool bucketed = !m_exactSize && !hasRotation && m_blur.radius <= 0;
+        texture = manager->resolve(texture, ct->format(), pixelSize, bucketed);
+        capturePixelSize = pixelSize;
         if (Q_UNLIKELY(texture.expired())) {
             reset();
             return;
@@ -679,7 +983,9 @@ public:
         Q_ASSERT(texture->data);
 
         if (renderData) {
-            if (!renderData->rt || sgTexture()->rhiTexture() != texture->data) {
+            // The sgTexture may be the result of the blur, check the texture of the rt
+            if (!renderData->rt
+                || renderData->rt->description().colorAttachmentAt(0)->texture() != texture->data) {
                 QRhiTextureRenderTargetDescription rtDesc(texture->data);
                 const auto flags = QRhiTextureRenderTarget::PreserveColorContents
                     | QRhiTextureRenderTarget::PreserveDepthStencilContents;
@@ -694,6 +1000,21 @@ public:
             }
         }
 
+        if (m_blur.radius > 0) {
+            QRect innerRect(QPoint(0, 0), pixelSize);
+            if (captureRect != m_rect) {
+                const QPointF offset = (renderMatrix.map(m_rect.topLeft())
+                                        - renderMatrix.map(captureRect.topLeft())) * devicePixelRatio;
+                const QSizeF size = renderMatrix.mapRect(m_rect).size() * devicePixelRatio;
+                innerRect = QRectF(offset, size).toRect() & innerRect;
+            }
+
+            if (!prepareBlur(texture->data, innerRect))
+                releaseBlur(manager);
+        } else {
+            releaseBlur(manager);
+        }
+
         if (m_content) {
             auto rootNode = WQmlHelper::getRootNode(m_content);
             if (rootNode && rootNode->firstChild()) {
@@ -716,20 +1037,20 @@ public:
             renderData->texture.setTexture(ct);
             renderData->texture.setTextureSize(ct->pixelSize());
 
-            const QPointF sourcePos = renderMatrix.map(m_rect.topLeft());
+            const QPointF sourcePos = renderMatrix.map(captureRect.topLeft());
             renderData->imageNode->setRect(QRectF(-(devicePixelRatio - 1) * sourcePos, ct->pixelSize()));
 
             rhi->sync(texture->data->pixelSize(), &renderData->rootNode, renderMatrix.inverted(), {}, nullptr,
-                      {texture->data->pixelSize().width() / float(m_rect.width() * devicePixelRatio),
-                       texture->data->pixelSize().height() / float(m_rect.height() * devicePixelRatio)});
+                      {texture->data->pixelSize().width() / float(captureRect.width() * devicePixelRatio),
+                       texture->data->pixelSize().height() / float(captureRect.height() * devicePixelRatio)});
             rhi->render(renderData->rt.get());
         } else {
             auto rhi = this->rhi->rhi();
-            QPointF sourcePos = renderMatrix.map(m_rect.topLeft()) * devicePixelRatio;
+            QPointF sourcePos = renderMatrix.map(captureRect.topLeft()) * devicePixelRatio;
 
             auto rub = rhi->nextResourceUpdateBatch();
             QRhiTextureCopyDescription desc;
-            desc.setPixelSize(texture->data->pixelSize());
+            desc.setPixelSize(capturePixelSize);
             desc.setSourceTopLeft(sourcePos.toPoint());
             rub->copyTexture(texture->data, ct, desc);
 
@@ -743,8 +1064,14 @@ public:
             rhi->endOffscreenFrame();
         }
 
-        if (sgTexture()->rhiTexture() != texture->data)
-            sgTexture()->setTexture(texture->data);
+        QRhiTexture *result = texture->data;
+        QSize resultSize = capturePixelSize;
+        if (blurData && renderBlur()) {
+            result = blurData->output.texture.lock()->data;
+            resultSize = result->pixelSize();
+        }
+
+        sgTexture()->setTexture(result, resultSize);
         doNotifyTextureChanged();
 
         if (contentNode) {
@@ -820,7 +1147,212 @@ public:
     }
 
 private:
+    struct RenderTargetDeleter {
+        inline void operator()(QRhiTextureRenderTarget *pointer) const {
+            if (pointer) {
+                delete pointer->renderPassDescriptor();
+                pointer->setRenderPassDescriptor(nullptr);
+                pointer->deleteLater();
+            }
+        }
+    };
+
+    struct ResourceDeleter {
+        inline void operator()(QRhiResource *pointer) const {
+            if (pointer)
+                pointer->deleteLater();
+        }
+    };
+
+    // The targets of the blur passes are from the same pool of the
+    // captured texture, they are in the format of the render target.
+    struct BlurData {
+        struct Target {
+            std::weak_ptr<RhiTextureManager::Data> texture;
+            std::unique_ptr<QRhiTextureRenderTarget, RenderTargetDeleter> rt;
+        };
+
+        struct Pass {
+            std::unique_ptr<QRhiBuffer, ResourceDeleter> uniformBuffer;
+            std::unique_ptr<QRhiShaderResourceBindings, ResourceDeleter> bindings;
+            QRhiTexture *source = nullptr;
+            Target *target = nullptr;
+            bool downsample = true;
+            BlurUniforms uniforms;
+        };
+
+        // Every level is the half size of the previous one
+        std::vector<Target> levels;
+        Target output;
+        std::vector<Pass> passes;
+    };
+
+    bool resolveBlurTarget(BlurData::Target &target, QRhiTexture::Format format, const QSize &size) {
+        target.texture = manager->resolve(target.texture, format, size);
+        auto texture = target.texture.lock();
+        if (!texture) {
+            target.rt.reset();
+            return false;
+        }
+
+        if (!target.rt || target.rt->description().colorAttachmentAt(0)->texture() != texture->data) {
+            auto newRT = rhi->rhi()->newTextureRenderTarget(QRhiTextureRenderTargetDescription(texture->data));
+            newRT->setRenderPassDescriptor(newRT->newCompatibleRenderPassDescriptor());
+            target.rt.reset(newRT);
+            if (!newRT->create()) {
+                target.rt.reset();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Downsample the source to the levels and upsample them back, the last
+    // upsample pass only renders the innerRect of the source to the output.
+    bool prepareBlur(QRhiTexture *source, const QRect &innerRect) {
+        if (innerRect.isEmpty())
+            return false;
+
+        const QSize sourceSize = source->pixelSize();
+        qreal offset = 1;
+        const int iterations = blurIterations(m_blur.radius * devicePixelRatio, sourceSize, &offset);
+
+        if (!blurData)
+            blurData.reset(new BlurData);
+        auto &levels = blurData->levels;
+        while (int(levels.size()) > iterations) {
+            manager->release(levels.back().texture);
+            levels.pop_back();
+        }
+        levels.resize(iterations);
+
+        QSize size = sourceSize;
+        for (auto &level : levels) {
+            size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+            if (!resolveBlurTarget(level, source->format(), size))
+                return false;
+        }
+        if (!resolveBlurTarget(blurData->output, source->format(), innerRect.size()))
+            return false;
+
+        auto resources = rhi->blurResources(blurData->output.rt->renderPassDescriptor());
+        if (!resources)
+            return false;
+
+        auto &passes = blurData->passes;
+        passes.resize(iterations * 2);
+        for (int i = 0; i < int(passes.size()); ++i) {
+            auto &pass = passes[i];
+            QRhiTexture *passSource;
+
+            if (i < iterations) {
+                passSource = i == 0 ? source : levels[i - 1].texture.lock()->data;
+                pass.target = &levels[i];
+                pass.downsample = true;
+            } else {
+                const int level = iterations * 2 - 1 - i;
+                passSource = levels[level].texture.lock()->data;
+                pass.target = level > 0 ? &levels[level - 1] : &blurData->output;
+                pass.downsample = false;
+            }
+
+            if (!pass.uniformBuffer) {
+                pass.uniformBuffer.reset(rhi->rhi()->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer,
+                                                               sizeof(BlurUniforms)));
+                if (!pass.uniformBuffer->create()) {
+                    pass.uniformBuffer.reset();
+                    return false;
+                }
+            }
+
+            if (!pass.bindings || pass.source != passSource) {
+                pass.bindings.reset(rhi->newBlurBindings(resources, pass.uniformBuffer.get(), passSource));
+                pass.source = passSource;
+                if (!pass.bindings->create()) {
+                    pass.bindings.reset();
+                    return false;
+                }
+            }
+
+            pass.uniforms = {};
+            pass.uniforms.texelSize[0] = 1.0f / passSource->pixelSize().width();
+            pass.uniforms.texelSize[1] = 1.0f / passSource->pixelSize().height();
+            pass.uniforms.offset = offset;
+        }
+
+        // The last pass only renders the item's area of the source
+        auto &last = passes.back().uniforms;
+        const qreal innerTop = rhi->rhi()->isYUpInFramebuffer()
+                                   ? sourceSize.height() - innerRect.y() - innerRect.height()
+                                   : innerRect.y();
+        last.uvRect[0] = qreal(innerRect.x()) / sourceSize.width();
+        last.uvRect[1] = innerTop / sourceSize.height();
+        last.uvRect[2] = qreal(innerRect.width()) / sourceSize.width();
+        last.uvRect[3] = qreal(innerRect.height()) / sourceSize.height();
+        last.noise = m_blur.noise;
+        // Premultiplied
+        const float tintAlpha = m_blur.tint.alphaF();
+        last.tint[0] = m_blur.tint.redF() * tintAlpha;
+        last.tint[1] = m_blur.tint.greenF() * tintAlpha;
+        last.tint[2] = m_blur.tint.blueF() * tintAlpha;
+        last.tint[3] = tintAlpha;
+
+        return true;
+    }
+
+    bool renderBlur() {
+        auto rhi = this->rhi->rhi();
+        auto resources = this->rhi->blurResources(blurData->output.rt->renderPassDescriptor());
+        if (!resources)
+            return false;
+
+        QRhiCommandBuffer *cb = nullptr;
+        if (rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess)
+            return false;
+        Q_ASSERT(cb);
+
+        auto rub = rhi->nextResourceUpdateBatch();
+        if (!resources->vertexBufferUploaded) {
+            rub->uploadStaticBuffer(resources->vertexBuffer.get(), blurVertices);
+            resources->vertexBufferUploaded = true;
+        }
+
+        for (const auto &pass : std::as_const(blurData->passes))
+            rub->updateDynamicBuffer(pass.uniformBuffer.get(), 0, sizeof(BlurUniforms), &pass.uniforms);
+
+        const QRhiCommandBuffer::VertexInput vertexInput(resources->vertexBuffer.get(), 0);
+        for (const auto &pass : std::as_const(blurData->passes)) {
+            auto rt = pass.target->rt.get();
+            const QSize size = rt->pixelSize();
+
+            cb->beginPass(rt, Qt::transparent, { 1.0f, 0 }, std::exchange(rub, nullptr));
+            cb->setGraphicsPipeline(pass.downsample ? resources->downPipeline.get()
+                                                    : resources->upPipeline.get());
+            cb->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+            cb->setShaderResources(pass.bindings.get());
+            cb->setVertexInput(0, 1, &vertexInput);
+            cb->draw(4);
+            cb->endPass();
+        }
+
+        return rhi->endOffscreenFrame() == QRhi::FrameOpSuccess;
+    }
+
+    void releaseBlur(RhiTextureManager *manager) {
+        if (!blurData)
+            return;
+
+        if (manager) {
+            for (const auto &level : std::as_const(blurData->levels))
+                manager->release(level.texture);
+            manager->release(blurData->output.texture);
+        }
+        blurData.reset();
+    }
+
     void reset(bool notifyTexture = true) {
+        releaseBlur(manager);
         if (renderData)
             renderData->rt.reset();
 
@@ -845,6 +1377,10 @@ private:
     DataManagerPointer<RhiManager> rhi;
     QMatrix4x4 renderMatrix;
     qreal devicePixelRatio;
+    // The area of the item copied from the render target, includes the margin of the blur
+    QRectF captureRect;
+    // The size of the captured contents, the texture may be larger if it's bucketed
+    QSize capturePixelSize;
 
     struct Node {
         Node() {
@@ -865,28 +1401,24 @@ private:
     QSGRootNode *contentNode = nullptr;
 
     struct RenderData {
-        struct QRhiTextureRenderTargetDeleter {
-            inline void operator()(QRhiTextureRenderTarget *pointer) const {
-                if (pointer) {
-                    delete pointer->renderPassDescriptor();
-                    pointer->setRenderPassDescriptor(nullptr);
-                    pointer->deleteLater();
-                }
-            }
-        };
-
-        std::unique_ptr<QRhiTextureRenderTarget, QRhiTextureRenderTargetDeleter> rt;
+        std::unique_ptr<QRhiTextureRenderTarget, RenderTargetDeleter> rt;
         QSGRootNode rootNode;
         QSGImageNode *imageNode;
         QSGPlainTexture texture;
     };
 
     std::unique_ptr<RenderData> renderData;
+    std::unique_ptr<BlurData> blurData;
 
+    // Only the top left area of the texture in textureSize() is valid
     struct Texture : public QSGDynamicTexture {
-        void setTexture(QRhiTexture *texture) {
-            if (texture)
-                m_textureSize = texture->pixelSize();
+        void setTexture(QRhiTexture *texture, const QSize &size = {}) {
+            if (texture) {
+                m_textureSize = size.isEmpty() ? texture->pixelSize() : size;
+                const QSize pixelSize = texture->pixelSize();
+                m_subRect = QRectF(0, 0, qreal(m_textureSize.width()) / pixelSize.width(),
+                                   qreal(m_textureSize.height()) / pixelSize.height());
+            }
             m_texture = texture;
         }
 
@@ -909,6 +1441,10 @@ private:
             return m_textureSize;
         }
 
+        QRectF normalizedTextureSubRect() const override {
+            return m_subRect;
+        }
+
         bool hasAlphaChannel() const override {
             return true;
         }
@@ -919,6 +1455,7 @@ private:
 
         QRhiTexture *m_texture = nullptr;
         QSize m_textureSize;
+        QRectF m_subRect = QRectF(0, 0, 1, 1);
     };
 
     inline Texture *sgTexture() const {
@@ -937,21 +1474,17 @@ WRenderBufferNode *WRenderBufferNode::createRhiNode(QQuickItem *item)
     return node;
 }
 
-class Q_DECL_HIDDEN QImageManager : public DataManager<QImageManager, QImage, QImage::Format, const QSize&>
+class Q_DECL_HIDDEN QImageManager : public DataManager<QImageManager, QImage, QImage::Format>
 {
     Q_OBJECT
 
     friend class DataManager;
 
     QImageManager(QQuickWindow *owner)
-        : DataManager<QImageManager, QImage, QImage::Format, const QSize&>(owner) {
+        : DataManager<QImageManager, QImage, QImage::Format>(owner) {
         Q_ASSERT(owner->findChildren<QImageManager*>(Qt::FindDirectChildrenOnly).size() == 1);
     }
 
-    static bool check(QImage *image, QImage::Format format, const QSize &size) {
-        return image->format() == format && image->size() == size;
-    }
-
     QImage *create(QImage::Format format, const QSize &size) {
         return new QImage(size, format);
     }
@@ -959,8 +1492,108 @@ class Q_DECL_HIDDEN QImageManager : public DataManager<QImageManager, QImage, QI
     static void destroy(QImage *image) {
         delete image;
     }
+
+    static qint64 byteSize(QImage *image) {
+        return image->sizeInBytes();
+    }
 };
 
+// The CPU version of the shaders/kawase_*.frag for the software renderer,
+// the images are in the Format_ARGB32_Premultiplied or Format_RGB32.
+struct PixelSum {
+    uint a = 0;
+    uint r = 0;
+    uint g = 0;
+    uint b = 0;
+
+    inline void add(const QImage &image, int x, int y, uint weight = 1) {
+        x = std::clamp(x, 0, image.width() - 1);
+        y = std::clamp(y, 0, image.height() - 1);
+        const QRgb pixel = reinterpret_cast<const QRgb*>(image.constScanLine(y))[x];
+        a += qAlpha(pixel) * weight;
+        r += qRed(pixel) * weight;
+        g += qGreen(pixel) * weight;
+        b += qBlue(pixel) * weight;
+    }
+};
+
+static void kawaseDownsample(const QImage &source, QImage *target, int offset)
+{
+    for (int y = 0; y < target->height(); ++y) {
+        auto line = reinterpret_cast<QRgb*>(target->scanLine(y));
+        const int sy = y * 2;
+
+        for (int x = 0; x < target->width(); ++x) {
+            const int sx = x * 2;
+            PixelSum sum;
+            // The center of the 2x2 pixels and the diagonals
+            sum.add(source, sx, sy);
+            sum.add(source, sx + 1, sy);
+            sum.add(source, sx, sy + 1);
+            sum.add(source, sx + 1, sy + 1);
+            sum.add(source, sx - offset, sy - offset);
+            sum.add(source, sx + 1 + offset, sy - offset);
+            sum.add(source, sx - offset, sy + 1 + offset);
+            sum.add(source, sx + 1 + offset, sy + 1 + offset);
+            line[x] = qRgba(sum.r / 8, sum.g / 8, sum.b / 8, sum.a / 8);
+        }
+    }
+}
+
+// The target is the area at targetPos of the image in targetSize, the tint
+// and the noise are only used in the last pass.
+static void kawaseUpsample(const QImage &source, QImage *target, const QSize &targetSize,
+                           const QPoint &targetPos, int offset, qreal noise = 0,
+                           const QColor &tint = Qt::transparent)
+{
+    const QRgb tintPixel = qPremultiply(tint.rgba());
+    const uint tintAlpha = qAlpha(tintPixel);
+    const int noiseLevel = qRound(noise * 256);
+
+    for (int y = 0; y < target->height(); ++y) {
+        auto line = reinterpret_cast<QRgb*>(target->scanLine(y));
+        const int sy = (y + targetPos.y()) * source.height() / targetSize.height();
+
+        for (int x = 0; x < target->width(); ++x) {
+            const int sx = (x + targetPos.x()) * source.width() / targetSize.width();
+            PixelSum sum;
+            sum.add(source, sx - offset * 2, sy);
+            sum.add(source, sx - offset, sy + offset, 2);
+            sum.add(source, sx, sy + offset * 2);
+            sum.add(source, sx + offset, sy + offset, 2);
+            sum.add(source, sx + offset * 2, sy);
+            sum.add(source, sx + offset, sy - offset, 2);
+            sum.add(source, sx, sy - offset * 2);
+            sum.add(source, sx - offset, sy - offset, 2);
+
+            int a = sum.a / 12;
+            int r = sum.r / 12;
+            int g = sum.g / 12;
+            int b = sum.b / 12;
+
+            if (tintAlpha > 0) {
+                a = tintAlpha + a * (255 - tintAlpha) / 255;
+                r = qRed(tintPixel) + r * (255 - tintAlpha) / 255;
+                g = qGreen(tintPixel) + g * (255 - tintAlpha) / 255;
+                b = qBlue(tintPixel) + b * (255 - tintAlpha) / 255;
+            }
+
+            if (noiseLevel > 0) {
+                uint hash = uint(x + targetPos.x()) * 374761393u + uint(y + targetPos.y()) * 668265263u;
+                hash = (hash ^ (hash >> 13)) * 1274126177u;
+                // In [-128, 127]
+                const int n = int((hash ^ (hash >> 16)) & 0xff) - 128;
+                const int delta = n * noiseLevel / 256 * a / 255;
+                r = std::clamp(r + delta, 0, a);
+                g = std::clamp(g + delta, 0, a);
+                b = std::clamp(b + delta, 0, a);
+            }
+
+            line[x] = qRgba(r, g, b, a);
+        }
+    }
+}
+
 class Q_DECL_HIDDEN SoftwareNode : public WRenderBufferNode {
 public:
     SoftwareNode(QQuickItem *item)
@@ -981,11 +1614,16 @@ public:
 
     QImage toImage() const override
     {
-        return image.expired() ? QImage() : *image.lock()->data;
+        if (!blurData.output.expired())
+            return *blurData.output.lock()->data;
+        if (image.expired())
+            return QImage();
+        // Don't return the view of the buffer, it may be reused by another node
+        const QImage *data = image.lock()->data;
+        return data->size() == capturePixelSize ? *data : data->copy(QRect(QPoint(0, 0), capturePixelSize));
     }
 
     void render(const RenderState *state) override {
-        Q_UNUSED(state)
         auto window = renderWindow();
         if (!window)
             return;
@@ -994,9 +1632,11 @@ public:
                                                                QSGRendererInterface::PainterResource));
         Q_ASSERT(p);
 
-        // const auto currentRenderer = window->currentRenderer();
-        // const auto sgRenderer = currentRenderer ? currentRenderer->currentRenderer() : nullptr;
-        const auto matrix = /*(sgRenderer && sgRenderer->renderTarget().paintDevice == p->device())
+        const auto currentRenderer = window->currentRenderer();
+        auto sgRenderer = currentRenderer ? currentRenderer->currentRenderer() : nullptr;
+        if (sgRenderer && sgRenderer->renderTarget().paintDevice != p->device())
+            sgRenderer = nullptr;
+        const auto matrix = /*sgRenderer
             ? currentRenderer->currentWorldTransform() * (*this->matrix()) :*/ *this->matrix();
         const auto oldManager = manager;
         manager = QImageManager::resolve(manager, window);
@@ -1006,6 +1646,7 @@ public:
             if (oldManager)
                 oldManager->release(image);
             image.reset();
+            releaseBlur(oldManager);
         }
 
         const bool hasRotation = matrix.flags().testAnyFlags(QMatrix4x4::Rotation2D | QMatrix4x4::Rotation);
@@ -1041,32 +1682,103 @@ public:
             return;
         }
 
+        const bool blur = m_blur.radius > 0;
+        QMargins captureMargins;
+        if (blur && !hasRotation) {
+            // The blur needs the contents around the item, but not outside the source
+            const int margin = qCeil(m_blur.radius * dpr);
+            const QRect itemRect((matrix.map(m_rect.topLeft()) * dpr).toPoint(), pixelSize);
+            const QRect sourceRect = sourceImage.isNull() ? sourcePixmap.rect() : sourceImage.rect();
+            captureMargins = QMargins(std::clamp(itemRect.left() - sourceRect.left(), 0, margin),
+                                      std::clamp(itemRect.top() - sourceRect.top(), 0, margin),
+                                      std::clamp(sourceRect.right() - itemRect.right(), 0, margin),
+                                      std::clamp(sourceRect.bottom() - itemRect.bottom(), 0, margin));
+        }
+        capturePixelSize = pixelSize.grownBy(captureMargins);
+
+        // The texture is a view of the image if it's bucketed, it can't be
+        // converted to a buffer for the consumers out of this frame
+        const bool bucketed = !m_exactSize;
         if (Q_UNLIKELY(sourceImage.isNull())) {
-            image = manager->resolve(image, QImage::Format_RGB30, pixelSize);
+            image = manager->resolve(image, QImage::Format_RGB30, capturePixelSize, bucketed);
         } else {
-            image = manager->resolve(image, sourceImage.format(), pixelSize);
+            image = manager->resolve(image, sourceImage.format(), capturePixelSize, bucketed);
         }
 
         auto image = this->image.lock();
-        painter.begin(image->data);
-        painter.setRenderHint(QPainter::SmoothPixmapTransform);
-        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        if (Q_UNLIKELY(!image)) {
+            reset();
+            return;
+        }
+        const QRect captureRect(QPoint(0, 0), capturePixelSize);
         auto transform = matrix.toTransform().inverted();
         QTransform resetPos;
         resetPos.translate((dpr - 1) * transform.dx(),
                            (dpr - 1) * transform.dy());
-        painter.setTransform(transform * resetPos);
+        const QTransform painterTransform = transform * resetPos
+            * QTransform::fromTranslate(captureMargins.left(), captureMargins.top());
+
+        // The source in painterTransform's coordinate system
+        QRegion copyRegion;
+        const bool fullCopy = !damageOfSource(state, sgRenderer, sourceImage, image->generation,
+                                              painterTransform, &copyRegion);
+
+        const bool copied = fullCopy || !copyRegion.isEmpty();
+        if (copied) {
+            // Drop the reference of the texture, avoid the QImage detach
+            // the whole image when begin paint.
+            texture()->setImage(QImage());
+
+            painter.begin(image->data);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            if (captureRect != image->data->rect())
+                painter.setClipRect(captureRect);
+            painter.setTransform(painterTransform);
+            if (!fullCopy)
+                painter.setClipRegion(copyRegion, painter.hasClipping() ? Qt::IntersectClip : Qt::ReplaceClip);
+
+            if (Q_UNLIKELY(sourceImage.isNull())) {
+                painter.drawPixmap(sourcePixmap.rect(), sourcePixmap, sourcePixmap.rect());
+            } else {
+                painter.drawImage(sourceImage.rect(), sourceImage, sourceImage.rect());
+            }
 
-        // TODO: copy damage area from the previous frame
-        if (Q_UNLIKELY(sourceImage.isNull())) {
-            painter.drawPixmap(sourcePixmap.rect(), sourcePixmap, sourcePixmap.rect());
-        } else {
-            painter.drawImage(sourceImage.rect(), sourceImage, sourceImage.rect());
+            painter.end();
+
+            qint64 pixels = 0;
+            if (fullCopy) {
+                pixels = qint64(captureRect.width()) * captureRect.height();
+            } else {
+                for (const QRect &r : copyRegion) {
+                    const QRect target = painterTransform.mapRect(QRectF(r)).toAlignedRect() & captureRect;
+                    pixels += qint64(target.width()) * target.height();
+                }
+            }
+            manager->addCopiedBytes(pixels * image->data->depth() / 8);
         }
 
-        painter.end();
+        if (!sourceImage.isNull() && sgRenderer) {
+            lastCopy.imageGeneration = image->generation;
+            lastCopy.renderer = sgRenderer;
+            lastCopy.transform = painterTransform;
+            lastCopy.sourceSize = sourceImage.size();
+        } else {
+            lastCopy = {};
+        }
 
-        texture()->setImage(*image->data);
+        // Shares the memory of the image without the reference
+        const QImage capture = captureRect == image->data->rect()
+                                   ? *image->data
+                                   : QImage(image->data->constBits(), captureRect.width(), captureRect.height(),
+                                            image->data->bytesPerLine(), image->data->format());
+        const QRect innerRect(QPoint(captureMargins.left(), captureMargins.top()), pixelSize);
+        if (blur && renderBlur(capture, innerRect, copied)) {
+            texture()->setImage(*blurData.output.lock()->data);
+        } else {
+            releaseBlur(manager);
+            texture()->setImage(capture);
+        }
         // Ensuse always render on software renderer
         texture()->setHasAlphaChannel(true);
         doNotifyTextureChanged();
@@ -1077,6 +1789,100 @@ private:
         return static_cast<QSGPlainTexture*>(m_texture.get());
     }
 
+    // Returns false if the whole source must be copied, otherwise the damage
+    // is the area of the source changed since the previous copy to the image.
+    bool damageOfSource(const RenderState *state, QSGRenderer *renderer, const QImage &source,
+                        quint64 imageGeneration, const QTransform &transform, QRegion *damage) const {
+        if (source.isNull() || !renderer || !state->clipRegion())
+            return false;
+        // The image contains the contents of another output or an old position
+        if (lastCopy.imageGeneration != imageGeneration || lastCopy.renderer != renderer
+            || lastCopy.transform != transform || lastCopy.sourceSize != source.size()) {
+            return false;
+        }
+        // Avoid the clip region being transformed to a path
+        if (transform.type() > QTransform::TxScale)
+            return false;
+
+        // The QSGSoftwareRenderer only repaints the dirty region of the node, it
+        // contains the changes of the nodes below this node and the buffer age
+        // damage, outside it the source is the same as the previous frame of
+        // this renderer. It's in the logical coordinate system.
+        const qreal sourceDPR = source.devicePixelRatio();
+        for (const QRect &r : *state->clipRegion()) {
+            const QRectF pixelRect(r.topLeft() * sourceDPR, r.size() * sourceDPR);
+            // Add a pixel for the smooth pixmap transform
+            *damage += pixelRect.toAlignedRect().adjusted(-1, -1, 1, 1);
+        }
+        *damage &= source.rect();
+
+        return true;
+    }
+
+    // The blur result is only updated if the captured image is changed
+    bool renderBlur(const QImage &capture, const QRect &innerRect, bool captureChanged) {
+        if (!captureChanged && !blurData.output.expired()
+            && blurData.options == m_blur && blurData.innerRect == innerRect) {
+            return true;
+        }
+
+        qreal offset = 1;
+        const int iterations = blurIterations(m_blur.radius * effectiveDevicePixelRatio(),
+                                              capture.size(), &offset);
+        const int pixelOffset = std::max(1, qRound(offset));
+
+        while (int(blurData.levels.size()) > iterations) {
+            manager->release(blurData.levels.back());
+            blurData.levels.pop_back();
+        }
+        blurData.levels.resize(iterations);
+
+        // Drop the reference of the texture, avoid the QImage detach
+        texture()->setImage(QImage());
+
+        const QImage source = (capture.format() == QImage::Format_ARGB32_Premultiplied
+                               || capture.format() == QImage::Format_RGB32)
+                                  ? capture
+                                  : capture.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QSize size = source.size();
+        const QImage *previous = &source;
+        QList<QImage*> levels;
+
+        for (auto &level : blurData.levels) {
+            size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+            level = manager->resolve(level, QImage::Format_ARGB32_Premultiplied, size);
+            if (level.expired())
+                return false;
+
+            levels.append(level.lock()->data);
+            kawaseDownsample(*previous, levels.last(), pixelOffset);
+            previous = levels.last();
+        }
+
+        for (int i = levels.size() - 1; i > 0; --i)
+            kawaseUpsample(*levels.at(i), levels.at(i - 1), levels.at(i - 1)->size(), {}, pixelOffset);
+
+        blurData.output = manager->resolve(blurData.output, QImage::Format_ARGB32_Premultiplied,
+                                           innerRect.size());
+        if (blurData.output.expired())
+            return false;
+        kawaseUpsample(*levels.first(), blurData.output.lock()->data, source.size(),
+                       innerRect.topLeft(), pixelOffset, m_blur.noise, m_blur.tint);
+
+        blurData.options = m_blur;
+        blurData.innerRect = innerRect;
+        return true;
+    }
+
+    void releaseBlur(QImageManager *manager) {
+        if (manager) {
+            for (const auto &level : std::as_const(blurData.levels))
+                manager->release(level);
+            manager->release(blurData.output);
+        }
+        blurData = {};
+    }
+
     void reset(bool notifyTexture = true) {
         if (!texture()->image().isNull() && notifyTexture)
             doNotifyTextureChanged();
@@ -1084,6 +1890,8 @@ private:
         if (manager)
             manager->release(image);
         image.reset();
+        releaseBlur(manager);
+        lastCopy = {};
     }
 
     void destroy() {
@@ -1094,7 +1902,25 @@ private:
     friend class WRenderBufferNode;
     DataManagerPointer<QImageManager> manager;
     std::weak_ptr<QImageManager::Data> image;
+    // The size of the captured contents, the image may be larger if it's bucketed
+    QSize capturePixelSize;
     QPainter painter;
+
+    struct {
+        // Not the address of the image, a new image may be at the same address
+        quint64 imageGeneration = 0;
+        const QSGRenderer *renderer = nullptr;
+        QTransform transform;
+        QSize sourceSize;
+    } lastCopy;
+
+    struct {
+        // Every level is the half size of the previous one
+        std::vector<std::weak_ptr<QImageManager::Data>> levels;
+        std::weak_ptr<QImageManager::Data> output;
+        BlurOptions options;
+        QRect innerRect;
+    } blurData;
 };
 
 WRenderBufferNode *WRenderBufferNode::createSoftwareNode(QQuickItem *item)
@@ -1103,6 +1929,26 @@ WRenderBufferNode *WRenderBufferNode::createSoftwareNode(QQuickItem *item)
     return node;
 }
 
+WRenderBufferNode::PoolStats WRenderBufferNode::poolStats(QQuickWindow *window)
+{
+    PoolStats stats;
+    auto add = [&stats] (const PoolStats &s) {
+        stats.bytesHeld += s.bytesHeld;
+        stats.bytesInUse += s.bytesInUse;
+        stats.hits += s.hits;
+        stats.misses += s.misses;
+        stats.evictions += s.evictions;
+        stats.bytesCopied += s.bytesCopied;
+    };
+
+    if (auto manager = window->findChild<RhiTextureManager*>({}, Qt::FindDirectChildrenOnly))
+        add(manager->poolStats());
+    if (auto manager = window->findChild<QImageManager*>({}, Qt::FindDirectChildrenOnly))
+        add(manager->poolStats());
+
+    return stats;
+}
+
 QRectF WRenderBufferNode::rect() const
 {
     return QRectF(0, 0, m_item->width(), m_item->height());
@@ -1121,6 +1967,14 @@ void WRenderBufferNode::resize(const QSizeF &size)
     m_rect = QRectF(QPointF(0, 0), m_size);
 }
 
+void WRenderBufferNode::setExactSize(bool exactSize)
+{
+    if (m_exactSize == exactSize)
+        return;
+    m_exactSize = exactSize;
+    markDirty(DirtyMaterial);
+}
+
 void WRenderBufferNode::setContentItem(QQuickItem *item)
 {
     if (m_content == item)
@@ -1129,6 +1983,20 @@ void WRenderBufferNode::setContentItem(QQuickItem *item)
     markDirty(DirtyMaterial);
 }
 
+void WRenderBufferNode::setBlur(const BlurOptions &options)
+{
+#ifdef DISABLE_BLUR
+    // The shaders are not compiled, keep the radius zero, so the blur
+    // passes of both the rhi and the software node are never used
+    Q_UNUSED(options)
+#else
+    if (m_blur == options)
+        return;
+    m_blur = options;
+    markDirty(DirtyMaterial);
+#endif
+}
+
 void WRenderBufferNode::setTextureChangedCallback(TextureChangedNotifer callback, void *data)
 {
     m_renderCallback = callback;
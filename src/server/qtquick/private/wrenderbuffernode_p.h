@@ -7,10 +7,12 @@
 #include <QSGRenderNode>
 #include <QPointer>
 #include <QImage>
+#include <QColor>
 #include <QSGDynamicTexture>
 
 QT_BEGIN_NAMESPACE
 class QQuickItem;
+class QQuickWindow;
 class QSGTexture;
 QT_END_NAMESPACE
 
@@ -27,12 +29,47 @@ public:
     static WRenderBufferNode *createRhiNode(QQuickItem *item);
     static WRenderBufferNode *createSoftwareNode(QQuickItem *item);
 
+    // The buffers of all the nodes in a window are from a shared pool
+    struct PoolStats {
+        qint64 bytesHeld = 0;
+        qint64 bytesInUse = 0;
+        quint64 hits = 0;
+        quint64 misses = 0;
+        // The buffers destroyed because of the budget
+        quint64 evictions = 0;
+        // The bytes of the contents copied to the buffers by the software nodes
+        quint64 bytesCopied = 0;
+    };
+    static PoolStats poolStats(QQuickWindow *window);
+
     QRectF rect() const override;
     RenderingFlags flags() const override;
 
     void resize(const QSizeF &size);
     void setContentItem(QQuickItem *item);
 
+    // The buffers are rounded up in size by default, the texture is the top
+    // left area of them. Enable it if the texture may be sampled as a whole,
+    // e.g. by a ShaderEffect.
+    void setExactSize(bool exactSize);
+    inline bool exactSize() const {
+        return m_exactSize;
+    }
+
+    // Blur the contents behind the item by the dual kawase blur, the radius
+    // is in the logical pixels, zero to disable it.
+    struct BlurOptions {
+        qreal radius = 0;
+        qreal noise = 0;
+        QColor tint = Qt::transparent;
+
+        bool operator==(const BlurOptions &other) const = default;
+    };
+    void setBlur(const BlurOptions &options);
+    inline const BlurOptions &blur() const {
+        return m_blur;
+    }
+
     typedef void(*TextureChangedNotifer)(WRenderBufferNode *node, void *data);
     void setTextureChangedCallback(TextureChangedNotifer callback, void *data);
     inline void doNotifyTextureChanged() {
@@ -52,6 +89,8 @@ protected:
     QPointer<QQuickItem> m_content;
     QSizeF m_size;
     QRectF m_rect;
+    BlurOptions m_blur;
+    bool m_exactSize = false;
     QScopedPointer<QSGTexture> m_texture;
     TextureChangedNotifer m_renderCallback = nullptr;
     void *m_callbackData = nullptr;
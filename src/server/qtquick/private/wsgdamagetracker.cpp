@@ -0,0 +1,351 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "wsgdamagetracker_p.h"
+#include "wrenderbuffernode_p.h"
+
+#include <QSGNode>
+#include <QSGRenderNode>
+#include <QVarLengthArray>
+#include <QStack>
+
+#include <algorithm>
+#include <limits>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+static bool geometryBounds(const QSGGeometry *geometry, QRectF *bounds)
+{
+    if (!geometry || geometry->vertexCount() == 0) {
+        *bounds = QRectF();
+        return true;
+    }
+
+    // Only support the vertex coordinate at the first attribute, it's
+    // true for all the geometry created by QtQuick.
+    if (geometry->attributeCount() < 1)
+        return false;
+    const auto &attribute = geometry->attributes()[0];
+    if (attribute.type != QSGGeometry::FloatType || attribute.tupleSize < 2)
+        return false;
+    if (attribute.attributeType != QSGGeometry::PositionAttribute
+        && attribute.attributeType != QSGGeometry::UnknownAttribute) {
+        return false;
+    }
+
+    const char *data = static_cast<const char*>(geometry->vertexData());
+    const int stride = geometry->sizeOfVertex();
+    float minX = std::numeric_limits<float>::max();
+    float minY = minX;
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxY = maxX;
+
+    for (int i = 0; i < geometry->vertexCount(); ++i) {
+        const float *p = reinterpret_cast<const float*>(data + i * stride);
+        minX = std::min(minX, p[0]);
+        maxX = std::max(maxX, p[0]);
+        minY = std::min(minY, p[1]);
+        maxY = std::max(maxY, p[1]);
+    }
+
+    QRectF rect(QPointF(minX, minY), QPointF(maxX, maxY));
+    if (geometry->drawingMode() == QSGGeometry::DrawLines
+        || geometry->drawingMode() == QSGGeometry::DrawLineStrip
+        || geometry->drawingMode() == QSGGeometry::DrawLineLoop) {
+        const qreal margin = std::max(1.0f, geometry->lineWidth());
+        rect.adjust(-margin, -margin, margin, margin);
+    }
+
+    *bounds = rect;
+    return true;
+}
+
+struct NodeDamageHint
+{
+    const QSGNode *node = nullptr;
+    QRegion damage;
+};
+// The scene graph is only changed in the render thread of the window
+static thread_local NodeDamageHint s_nodeDamageHint;
+
+WSGDamageTracker::WSGDamageTracker(QSGRootNode *root, QObject *parent)
+    : QSGAbstractRenderer(parent)
+{
+    Q_ASSERT(root);
+    setRootNode(root);
+    // The existing nodes must be known, their removal or first change
+    // needs to damage the area they used to cover.
+    rebuildNodeRects();
+}
+
+WSGDamageTracker::~WSGDamageTracker()
+{
+    setRootNode(nullptr);
+}
+
+QRegion WSGDamageTracker::takeDamage(bool *fullDamage)
+{
+    for (QSGNode *node : std::as_const(m_dirtySubtrees)) {
+        QStack<QSGNode*> nodes;
+        nodes.push(node);
+        while (!nodes.isEmpty()) {
+            auto n = nodes.pop();
+            updateNode(n);
+            for (auto child = n->firstChild(); child; child = child->nextSibling())
+                nodes.push(child);
+        }
+        m_dirtyNodes.remove(node);
+    }
+
+    for (QSGNode *node : std::as_const(m_dirtyNodes))
+        updateNode(node);
+
+    for (auto it = m_nodeDamages.constBegin(); it != m_nodeDamages.constEnd(); ++it) {
+        // The whole node is already damaged if it's in the dirty list
+        if (!m_dirtyNodes.contains(it.key()))
+            updateNodeDamage(it.key(), it.value());
+    }
+
+    m_dirtySubtrees.clear();
+    m_dirtyNodes.clear();
+    m_nodeDamages.clear();
+
+    // The WRenderBufferNode samples the contents behind it (e.g. for blur),
+    // the damage of the contents behind is also the damage of it.
+    if (!m_damage.isEmpty()) {
+        for (QSGNode *node : std::as_const(m_bufferNodes)) {
+            const QRect rect = m_nodeRects.value(node).toAlignedRect();
+            if (m_damage.intersects(rect))
+                m_damage += rect;
+        }
+    }
+
+    *fullDamage = m_fullDamage;
+    if (m_fullDamage) {
+        m_fullDamage = false;
+        m_damage = QRegion();
+        // The nodes changed without being tracked, e.g. under an unbounded
+        // render node, resync the area of all nodes.
+        rebuildNodeRects();
+        return {};
+    }
+
+    return std::exchange(m_damage, QRegion());
+}
+
+void WSGDamageTracker::markFullDamage()
+{
+    m_fullDamage = true;
+}
+
+void WSGDamageTracker::beginNodeDamageHint(const QSGNode *node, const QRegion &damage)
+{
+    Q_ASSERT(!s_nodeDamageHint.node);
+    s_nodeDamageHint.node = node;
+    s_nodeDamageHint.damage = damage;
+}
+
+void WSGDamageTracker::endNodeDamageHint()
+{
+    s_nodeDamageHint = {};
+}
+
+void WSGDamageTracker::nodeChanged(QSGNode *node, QSGNode::DirtyState state)
+{
+    if (state & QSGNode::DirtyNodeRemoved) {
+        // The node is still linked to its parent in here, the area it
+        // used to cover must be repainted after it leaves the scene.
+        forgetSubtree(node);
+        return;
+    }
+
+    const QSGNode::DirtyState subtreeStates = QSGNode::DirtyNodeAdded
+                                              | QSGNode::DirtyMatrix
+                                              | QSGNode::DirtyOpacity
+                                              | QSGNode::DirtySubtreeBlocked
+                                              | QSGNode::DirtyForceUpdate;
+    if (state & subtreeStates) {
+        m_dirtySubtrees.insert(node);
+    } else if (node->type() == QSGNode::ClipNodeType) {
+        // The clip of all children is changed
+        if (state & QSGNode::DirtyGeometry)
+            m_dirtySubtrees.insert(node);
+    } else if (state & QSGNode::DirtyGeometry) {
+        m_dirtyNodes.insert(node);
+    } else if (state & QSGNode::DirtyMaterial) {
+        if (s_nodeDamageHint.node == node && !m_dirtyNodes.contains(node))
+            m_nodeDamages[node] += s_nodeDamageHint.damage;
+        else
+            m_dirtyNodes.insert(node);
+    }
+}
+
+void WSGDamageTracker::updateNodeDamage(QSGNode *node, const QRegion &damage)
+{
+    if (damage.isEmpty())
+        return;
+
+    QRectF bounds;
+    QTransform transform;
+    if (!mapToRoot(node, &bounds, &transform)) {
+        m_fullDamage = true;
+        return;
+    }
+
+    if (bounds.isEmpty())
+        return;
+
+    for (const QRect &rect : damage)
+        m_damage += (transform.mapRect(QRectF(rect)) & bounds).toAlignedRect();
+}
+
+void WSGDamageTracker::rebuildNodeRects()
+{
+    m_nodeRects.clear();
+    m_unboundedNodes.clear();
+    m_bufferNodes.clear();
+    if (!rootNode())
+        return;
+
+    QStack<QSGNode*> nodes;
+    nodes.push(rootNode());
+    while (!nodes.isEmpty()) {
+        auto n = nodes.pop();
+        for (auto child = n->firstChild(); child; child = child->nextSibling())
+            nodes.push(child);
+
+        if (n->type() != QSGNode::GeometryNodeType
+            && n->type() != QSGNode::RenderNodeType) {
+            continue;
+        }
+
+        QRectF rect;
+        if (!mapToRoot(n, &rect)) {
+            m_unboundedNodes.insert(n);
+        } else if (!rect.isEmpty()) {
+            m_nodeRects.insert(n, rect);
+            if (n->type() == QSGNode::RenderNodeType && dynamic_cast<WRenderBufferNode*>(n))
+                m_bufferNodes.insert(n);
+        }
+    }
+}
+
+void WSGDamageTracker::forgetSubtree(QSGNode *node)
+{
+    QStack<QSGNode*> nodes;
+    nodes.push(node);
+    while (!nodes.isEmpty()) {
+        auto n = nodes.pop();
+        auto it = m_nodeRects.constFind(n);
+        if (it != m_nodeRects.constEnd()) {
+            m_damage += it->toAlignedRect();
+            m_nodeRects.erase(it);
+        }
+        if (m_unboundedNodes.remove(n))
+            m_fullDamage = true;
+        m_bufferNodes.remove(n);
+        m_dirtyNodes.remove(n);
+        m_nodeDamages.remove(n);
+        m_dirtySubtrees.remove(n);
+
+        for (auto child = n->firstChild(); child; child = child->nextSibling())
+            nodes.push(child);
+    }
+}
+
+void WSGDamageTracker::updateNode(QSGNode *node)
+{
+    if (node->type() != QSGNode::GeometryNodeType
+        && node->type() != QSGNode::RenderNodeType) {
+        return;
+    }
+
+    QRectF newRect;
+    if (!mapToRoot(node, &newRect)) {
+        m_fullDamage = true;
+        m_nodeRects.remove(node);
+        m_bufferNodes.remove(node);
+        m_unboundedNodes.insert(node);
+        return;
+    }
+    m_unboundedNodes.remove(node);
+
+    const QRectF oldRect = m_nodeRects.value(node);
+    if (!oldRect.isEmpty())
+        m_damage += oldRect.toAlignedRect();
+
+    if (newRect.isEmpty()) {
+        m_nodeRects.remove(node);
+        m_bufferNodes.remove(node);
+    } else {
+        m_damage += newRect.toAlignedRect();
+        m_nodeRects.insert(node, newRect);
+        if (node->type() == QSGNode::RenderNodeType
+            && dynamic_cast<WRenderBufferNode*>(node)) {
+            m_bufferNodes.insert(node);
+        }
+    }
+}
+
+bool WSGDamageTracker::mapToRoot(QSGNode *node, QRectF *rect, QTransform *nodeTransform) const
+{
+    QRectF bounds;
+    if (node->type() == QSGNode::GeometryNodeType) {
+        if (!geometryBounds(static_cast<QSGGeometryNode*>(node)->geometry(), &bounds))
+            return false;
+    } else {
+        Q_ASSERT(node->type() == QSGNode::RenderNodeType);
+        auto renderNode = static_cast<QSGRenderNode*>(node);
+        // Unknown the area that the render node will paint
+        if (!renderNode->flags().testFlag(QSGRenderNode::BoundedRectRendering))
+            return false;
+        bounds = renderNode->rect();
+    }
+
+    if (bounds.isEmpty()) {
+        *rect = QRectF();
+        return true;
+    }
+
+    QVarLengthArray<QSGNode*, 32> ancestors;
+    for (auto p = node->parent(); p; p = p->parent()) {
+        if (p->isSubtreeBlocked()) {
+            // Invisible, e.g. the opacity is 0
+            *rect = QRectF();
+            return true;
+        }
+
+        ancestors.append(p);
+        if (p == rootNode())
+            break;
+    }
+
+    QTransform transform;
+    QRectF clip;
+    bool hasClip = false;
+
+    for (int i = ancestors.size() - 1; i >= 0; --i) {
+        auto p = ancestors.at(i);
+        if (p->type() == QSGNode::TransformNodeType) {
+            transform = static_cast<QSGTransformNode*>(p)->matrix().toTransform() * transform;
+        } else if (p->type() == QSGNode::ClipNodeType) {
+            auto clipNode = static_cast<QSGClipNode*>(p);
+            // Not rectangular clip is ignored, it's safe to damage more area.
+            if (clipNode->isRectangular()) {
+                const QRectF r = transform.mapRect(clipNode->clipRect());
+                clip = hasClip ? clip & r : r;
+                hasClip = true;
+            }
+        }
+    }
+
+    *rect = transform.mapRect(bounds);
+    if (hasClip)
+        *rect &= clip;
+    if (nodeTransform)
+        *nodeTransform = transform;
+
+    return true;
+}
+
+WAYLIB_SERVER_END_NAMESPACE
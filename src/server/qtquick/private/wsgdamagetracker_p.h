@@ -0,0 +1,66 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QRegion>
+#include <QHash>
+#include <QSet>
+#include <private/qsgabstractrenderer_p.h>
+
+QT_BEGIN_NAMESPACE
+class QSGNode;
+class QSGRootNode;
+QT_END_NAMESPACE
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// A renderer that never renders, it's registered to a QSGRootNode only for
+// receive the node change notifications, and translate them to the damage
+// region in the root node's coordinate system. The QSGBatchRenderer doesn't
+// provide the damage area, so the RHI path of WBufferRenderer use this to
+// know which parts of the output buffer need to repaint.
+class WAYLIB_SERVER_EXPORT WSGDamageTracker : public QSGAbstractRenderer
+{
+public:
+    explicit WSGDamageTracker(QSGRootNode *root, QObject *parent = nullptr);
+    ~WSGDamageTracker() override;
+
+    // Return the damage since the last call, fullDamage is set to true if
+    // the damage area can't be known, e.g. the first frame, or a custom
+    // QSGRenderNode without BoundedRectRendering.
+    QRegion takeDamage(bool *fullDamage);
+    void markFullDamage();
+
+    // Limit the damage of the DirtyMaterial notifications of the node to
+    // the damage (in the node's coordinate system) until endNodeDamageHint,
+    // e.g. the texture of a QSGImageNode is only partially updated.
+    static void beginNodeDamageHint(const QSGNode *node, const QRegion &damage);
+    static void endNodeDamageHint();
+
+    void renderScene() override {}
+
+private:
+    void nodeChanged(QSGNode *node, QSGNode::DirtyState state) override;
+
+    void rebuildNodeRects();
+    void forgetSubtree(QSGNode *node);
+    void updateNode(QSGNode *node);
+    void updateNodeDamage(QSGNode *node, const QRegion &damage);
+    bool mapToRoot(QSGNode *node, QRectF *rect, QTransform *nodeTransform = nullptr) const;
+
+    QHash<QSGNode*, QRectF> m_nodeRects;
+    // The nodes whose area can't be known, e.g. a QSGRenderNode without
+    // BoundedRectRendering
+    QSet<QSGNode*> m_unboundedNodes;
+    QSet<QSGNode*> m_bufferNodes;
+    QSet<QSGNode*> m_dirtyNodes;
+    QSet<QSGNode*> m_dirtySubtrees;
+    QHash<QSGNode*, QRegion> m_nodeDamages;
+    QRegion m_damage;
+    bool m_fullDamage = true;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
@@ -0,0 +1,24 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#version 440
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+
+layout(location = 0) out vec2 uv;
+
+layout(std140, binding = 0) uniform buf {
+    // The offset (xy) and the scale (zw) of the texture coordinates
+    vec4 uvRect;
+    vec2 texelSize;
+    float offset;
+    float noise;
+    vec4 tint;
+} ubuf;
+
+void main()
+{
+    uv = ubuf.uvRect.xy + texCoord * ubuf.uvRect.zw;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
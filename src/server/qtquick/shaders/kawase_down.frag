@@ -0,0 +1,31 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#version 440
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    vec4 uvRect;
+    vec2 texelSize;
+    float offset;
+    float noise;
+    vec4 tint;
+} ubuf;
+
+layout(binding = 1) uniform sampler2D source;
+
+// The downsample pass of the dual kawase blur
+void main()
+{
+    vec2 o = ubuf.texelSize * ubuf.offset;
+
+    vec4 sum = texture(source, uv) * 4.0;
+    sum += texture(source, uv - o);
+    sum += texture(source, uv + o);
+    sum += texture(source, uv + vec2(o.x, -o.y));
+    sum += texture(source, uv - vec2(o.x, -o.y));
+
+    fragColor = sum / 8.0;
+}
@@ -0,0 +1,41 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#version 440
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    vec4 uvRect;
+    vec2 texelSize;
+    float offset;
+    float noise;
+    vec4 tint;
+} ubuf;
+
+layout(binding = 1) uniform sampler2D source;
+
+// The upsample pass of the dual kawase blur, the noise and
+// the tint (premultiplied) are only non-zero in the last pass.
+void main()
+{
+    vec2 o = ubuf.texelSize * ubuf.offset;
+
+    vec4 sum = texture(source, uv + vec2(-o.x * 2.0, 0.0));
+    sum += texture(source, uv + vec2(-o.x, o.y)) * 2.0;
+    sum += texture(source, uv + vec2(0.0, o.y * 2.0));
+    sum += texture(source, uv + vec2(o.x, o.y)) * 2.0;
+    sum += texture(source, uv + vec2(o.x * 2.0, 0.0));
+    sum += texture(source, uv + vec2(o.x, -o.y)) * 2.0;
+    sum += texture(source, uv + vec2(0.0, -o.y * 2.0));
+    sum += texture(source, uv + vec2(-o.x, -o.y)) * 2.0;
+
+    vec4 color = sum / 12.0;
+    color = ubuf.tint + color * (1.0 - ubuf.tint.a);
+
+    float n = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453) - 0.5;
+    color.rgb = clamp(color.rgb + n * ubuf.noise * color.a, 0.0, color.a);
+
+    fragColor = color;
+}
@@ -0,0 +1,78 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "winputlatencystats.h"
+
+#include <algorithm>
+#include <cmath>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+WInputLatencyStats::WInputLatencyStats(QObject *parent)
+    : QObject(parent)
+{
+
+}
+
+void WInputLatencyStats::addSample(qint64 latency)
+{
+    latency = std::max<qint64>(latency, 0);
+    const qint64 index = std::min<qint64>(latency / BucketWidth, BucketCount);
+    ++m_buckets[index];
+    ++m_samples;
+    m_max = std::max(m_max, latency);
+
+    Q_EMIT changed();
+}
+
+quint64 WInputLatencyStats::samples() const
+{
+    return m_samples;
+}
+
+qreal WInputLatencyStats::p50() const
+{
+    return percentile(0.5);
+}
+
+qreal WInputLatencyStats::p95() const
+{
+    return percentile(0.95);
+}
+
+qreal WInputLatencyStats::p99() const
+{
+    return percentile(0.99);
+}
+
+qreal WInputLatencyStats::max() const
+{
+    return m_max / 1000000.0;
+}
+
+qreal WInputLatencyStats::percentile(qreal fraction) const
+{
+    if (m_samples == 0)
+        return 0;
+
+    const quint64 rank = std::max<quint64>(std::ceil(std::clamp<qreal>(fraction, 0, 1) * m_samples), 1);
+    quint64 count = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        count += m_buckets[i];
+        if (count >= rank) // Never beyond the real maximum
+            return std::min((i + 1) * BucketWidth, m_max) / 1000000.0;
+    }
+
+    return max();
+}
+
+void WInputLatencyStats::reset()
+{
+    m_buckets.fill(0);
+    m_samples = 0;
+    m_max = 0;
+
+    Q_EMIT changed();
+}
+
+WAYLIB_SERVER_END_NAMESPACE
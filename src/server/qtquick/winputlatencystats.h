@@ -0,0 +1,57 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <wglobal.h>
+
+#include <QObject>
+#include <QQmlEngine>
+
+#include <array>
+
+WAYLIB_SERVER_BEGIN_NAMESPACE
+
+// The histogram of the time from an input event is received to the frame
+// contains its result is committed to the output, the values are in
+// milliseconds, the resolution is 0.25ms.
+class WAYLIB_SERVER_EXPORT WInputLatencyStats : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(quint64 samples READ samples NOTIFY changed FINAL)
+    Q_PROPERTY(qreal p50 READ p50 NOTIFY changed FINAL)
+    Q_PROPERTY(qreal p95 READ p95 NOTIFY changed FINAL)
+    Q_PROPERTY(qreal p99 READ p99 NOTIFY changed FINAL)
+    Q_PROPERTY(qreal max READ max NOTIFY changed FINAL)
+    QML_NAMED_ELEMENT(InputLatencyStats)
+    QML_UNCREATABLE("Only available via WOutputRenderWindow::inputLatency")
+
+public:
+    explicit WInputLatencyStats(QObject *parent = nullptr);
+
+    // In nanoseconds
+    void addSample(qint64 latency);
+
+    quint64 samples() const;
+    qreal p50() const;
+    qreal p95() const;
+    qreal p99() const;
+    qreal max() const;
+
+    // The fraction is in [0, 1], returns the upper bound of the bucket
+    Q_INVOKABLE qreal percentile(qreal fraction) const;
+    Q_INVOKABLE void reset();
+
+Q_SIGNALS:
+    void changed();
+
+private:
+    static constexpr qint64 BucketWidth = 250000; // 0.25ms
+    static constexpr int BucketCount = 800; // up to 200ms, and a bucket for the larger
+
+    std::array<quint64, BucketCount + 1> m_buckets {};
+    quint64 m_samples = 0;
+    qint64 m_max = 0;
+};
+
+WAYLIB_SERVER_END_NAMESPACE
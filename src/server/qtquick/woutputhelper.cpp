@@ -6,6 +6,7 @@
 #include "woutput.h"
 #include "platformplugin/types.h"
 #include "private/wglobal_p.h"
+#include "private/wframescheduler_p.h"
 
 #include <qwoutput.h>
 #include <qwrenderer.h>
@@ -19,14 +20,65 @@
 
 #include <QWindow>
 #include <QQuickWindow>
+#include <QTimer>
 #ifndef QT_NO_OPENGL
 #include <QOpenGLContext>
 #endif
 #include <private/qquickwindow_p.h>
 
+#include <drm_fourcc.h>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
+// The configuration of a buffer in WOutputHelper::testCommit, the layer
+// is nullptr for the primary buffer.
+struct Q_DECL_HIDDEN LayerTestKey
+{
+    wlr_output_layer *layer = nullptr;
+    uint32_t format = DRM_FORMAT_INVALID;
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    int width = 0;
+    int height = 0;
+    wlr_box dstBox = {};
+
+    inline bool operator==(const LayerTestKey &other) const {
+        return layer == other.layer
+            && format == other.format
+            && modifier == other.modifier
+            && width == other.width
+            && height == other.height
+            && dstBox.x == other.dstBox.x
+            && dstBox.y == other.dstBox.y
+            && dstBox.width == other.dstBox.width
+            && dstBox.height == other.dstBox.height;
+    }
+};
+
+static LayerTestKey makeLayerTestKey(wlr_output_layer *layer, wlr_buffer *buffer, const wlr_box &dstBox)
+{
+    LayerTestKey key;
+    key.layer = layer;
+    key.dstBox = dstBox;
+
+    if (!buffer)
+        return key;
+
+    key.width = buffer->width;
+    key.height = buffer->height;
+
+    wlr_dmabuf_attributes dmabuf;
+    wlr_shm_attributes shm;
+    if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+        key.format = dmabuf.format;
+        key.modifier = dmabuf.modifier;
+    } else if (wlr_buffer_get_shm(buffer, &shm)) {
+        key.format = shm.format;
+    }
+
+    return key;
+}
+
 class Q_DECL_HIDDEN WOutputHelperPrivate : public WObjectPrivate
 {
 public:
@@ -37,6 +89,9 @@ public:
         , renderable(r)
         , contentIsDirty(c)
         , needsFrame(n)
+        , renderDelayEnabled(qEnvironmentVariableIsSet("WAYLIB_ENABLE_RENDER_DELAY"))
+        , layerTestCacheValid(false)
+        , layerTestOk(false)
     {
         wlr_output_state_init(&state);
 
@@ -54,7 +109,11 @@ public:
         output->safeConnect(&qw_output::notify_damage, qq, [this] {
             on_damage();
         });
+        output->safeConnect(&qw_output::notify_present, qq, [this] (wlr_output_event_present *event) {
+            on_present(event);
+        });
         output->safeConnect(&WOutput::modeChanged, qq, [this] {
+            layerTestCacheValid = false;
             if (renderHelper)
                 renderHelper->setSize(this->output->size());
         }, Qt::QueuedConnection); // reset buffer on later, because it's rendering
@@ -82,6 +141,9 @@ public:
 
     void on_frame();
     void on_damage();
+    void on_present(wlr_output_event_present *event);
+    void renderFrame();
+    bool testLayers(qw_buffer *buffer, const wlr_output_layer_state_array &layers);
 
     qw_buffer *acquireBuffer(wlr_swapchain **sc, int *bufferAge);
 
@@ -96,10 +158,23 @@ public:
     wlr_output_layer_state_array layersCache;
     QWindow *outputWindow;
     WRenderHelper *renderHelper = nullptr;
+    WFrameScheduler scheduler;
+    QTimer *renderDelayTimer = nullptr;
 
     uint renderable:1;
     uint contentIsDirty:1;
     uint needsFrame:1;
+    uint renderDelayEnabled:1;
+
+    // The result of the last testCommit with layers, the first key is the primary buffer
+    uint layerTestCacheValid:1;
+    uint layerTestOk:1;
+    QVarLengthArray<LayerTestKey> layerTestKeys;
+    QVarLengthArray<bool> layerTestAccepted;
+
+    quint64 layerTests = 0;
+    quint64 layerTestCacheHits = 0;
+    quint64 layerCompositeFallbacks = 0;
 };
 
 void WOutputHelperPrivate::setRenderable(bool newValue)
@@ -128,16 +203,128 @@ void WOutputHelperPrivate::setNeedsFrame(bool newNeedsFrame)
 
 void WOutputHelperPrivate::on_frame()
 {
+    if (renderDelayEnabled) {
+        const int refresh = qwoutput()->handle()->refresh; // mHz
+        scheduler.setRefreshInterval(refresh > 0 ? 1000000000000ll / refresh : 0);
+        const qint64 delay = scheduler.frameDelay(WFrameScheduler::monotonicTime());
+        Q_EMIT q_func()->frameStatsChanged();
+
+        // QTimer only supports milliseconds, round down to not miss the vblank
+        const int delayMs = delay / 1000000;
+        if (delayMs > 0) {
+            if (!renderDelayTimer) {
+                renderDelayTimer = new QTimer(q_func());
+                renderDelayTimer->setSingleShot(true);
+                renderDelayTimer->setTimerType(Qt::PreciseTimer);
+                QObject::connect(renderDelayTimer, &QTimer::timeout, q_func(), [this] {
+                    renderFrame();
+                });
+            }
+
+            renderDelayTimer->start(delayMs);
+            return;
+        }
+    }
+
+    renderFrame();
+}
+
+void WOutputHelperPrivate::renderFrame()
+{
+    if (renderDelayTimer)
+        renderDelayTimer->stop();
+    if (renderDelayEnabled)
+        scheduler.beginFrame(WFrameScheduler::monotonicTime());
+
     setRenderable(true);
     Q_EMIT q_func()->requestRender();
 }
 
+bool WOutputHelperPrivate::testLayers(qw_buffer *buffer, const wlr_output_layer_state_array &layers)
+{
+    W_Q(WOutputHelper);
+    static bool disableCache = qEnvironmentVariableIsSet("WAYLIB_DISABLE_LAYER_TEST_CACHE");
+    // A client buffer (e.g. for the direct scanout) isn't from the swapchain,
+    // it may be rejected for the attributes not in the key, e.g. the stride
+    // or the memory placement. Its result isn't cached, and the cached result
+    // of the swapchain buffers is kept.
+    const bool clientBuffer = buffer && qw_client_buffer::get(*buffer);
+    // Only the buffer and the layers are compared, so don't cache the result
+    // if the other states (e.g. mode, scale, transform) will be committed.
+    const bool cacheable = !disableCache && !clientBuffer
+                           && !(state.committed & ~(WLR_OUTPUT_STATE_BUFFER
+                                                    | WLR_OUTPUT_STATE_DAMAGE
+                                                    | WLR_OUTPUT_STATE_LAYERS));
+
+    QVarLengthArray<LayerTestKey> keys;
+    if (cacheable) {
+        keys.reserve(layers.size() + 1);
+        keys.append(makeLayerTestKey(nullptr, buffer ? buffer->handle() : nullptr, {}));
+        for (const auto &layer : layers)
+            keys.append(makeLayerTestKey(layer.layer, layer.buffer, layer.dst_box));
+
+        if (layerTestCacheValid && keys == layerTestKeys) {
+            auto states = const_cast<wlr_output_layer_state*>(layers.data());
+            for (int i = 0; i < layers.size(); ++i)
+                states[i].accepted = layerTestAccepted.at(i);
+
+            ++layerTestCacheHits;
+            Q_EMIT q->layerTestStatsChanged();
+            return layerTestOk;
+        }
+    }
+
+    wlr_output_state testState = state;
+    if (buffer)
+        wlr_output_state_set_buffer(&testState, buffer->handle());
+    if (!layers.isEmpty())
+        wlr_output_state_set_layers(&testState, const_cast<wlr_output_layer_state*>(layers.data()), layers.length());
+
+    bool ok = qwoutput()->test_state(&testState);
+    if (testState.committed & WLR_OUTPUT_STATE_BUFFER) {
+        Q_ASSERT(buffer);
+        buffer->unlock();
+    }
+
+    ++layerTests;
+    if (!clientBuffer)
+        layerTestCacheValid = cacheable;
+    if (cacheable) {
+        layerTestOk = ok;
+        layerTestKeys = std::move(keys);
+        layerTestAccepted.resize(layers.size());
+        for (int i = 0; i < layers.size(); ++i)
+            layerTestAccepted[i] = layers.at(i).accepted;
+    }
+    Q_EMIT q->layerTestStatsChanged();
+
+    return ok;
+}
+
 void WOutputHelperPrivate::on_damage()
 {
     setContentIsDirty(true);
     Q_EMIT q_func()->damaged();
 }
 
+void WOutputHelperPrivate::on_present(wlr_output_event_present *event)
+{
+#if WLR_VERSION_MINOR > 18
+    const timespec &when = event->when;
+#else
+    const timespec &when = *event->when;
+#endif
+    const qint64 timestamp = qint64(when.tv_sec) * 1000000000 + when.tv_nsec;
+
+    if (renderDelayEnabled) {
+        scheduler.presented(timestamp, event->refresh, event->presented);
+        Q_EMIT q_func()->frameStatsChanged();
+    }
+
+    if (event->presented)
+        Q_EMIT q_func()->presented(timestamp, event->refresh, event->seq, event->flags);
+}
+
 qw_buffer *WOutputHelperPrivate::acquireBuffer(wlr_swapchain **sc, int *bufferAge)
 {
     bool ok = qwoutput()->configure_primary_swapchain(&state, sc);
@@ -258,6 +445,11 @@ bool WOutputHelper::commit()
     wlr_output_state state = d->state;
     wlr_output_state_init(&d->state);
     bool ok = d->qwoutput()->commit_state(&state);
+    // The result of testCommit isn't reliable if the commit is failed
+    if (!ok)
+        d->layerTestCacheValid = false;
+    if (ok && d->renderDelayEnabled && (state.committed & WLR_OUTPUT_STATE_BUFFER))
+        d->scheduler.endFrame(WFrameScheduler::monotonicTime());
     wlr_output_state_finish(&state);
 
     return ok;
@@ -269,23 +461,13 @@ bool WOutputHelper::testCommit()
     return d->qwoutput()->test_state(&d->state);
 }
 
+// The result is reused if the buffers and the layers have the same formats,
+// sizes and positions as the last time, it's invalidated on a failed commit.
+// The primary buffer from a client is always tested.
 bool WOutputHelper::testCommit(qw_buffer *buffer, const wlr_output_layer_state_array &layers)
 {
     W_D(WOutputHelper);
-    wlr_output_state state = d->state;
-
-    if (buffer)
-        wlr_output_state_set_buffer(&state, buffer->handle());
-    if (!layers.isEmpty())
-        wlr_output_state_set_layers(&state, const_cast<wlr_output_layer_state*>(layers.data()), layers.length());
-
-    bool ok = d->qwoutput()->test_state(&state);
-    if (state.committed & WLR_OUTPUT_STATE_BUFFER) {
-        Q_ASSERT(buffer);
-        buffer->unlock();
-    }
-
-    return ok;
+    return d->testLayers(buffer, layers);
 }
 
 bool WOutputHelper::renderable() const
@@ -306,6 +488,71 @@ bool WOutputHelper::needsFrame() const
     return d->needsFrame;
 }
 
+bool WOutputHelper::renderDelayEnabled() const
+{
+    W_DC(WOutputHelper);
+    return d->renderDelayEnabled;
+}
+
+void WOutputHelper::setRenderDelayEnabled(bool newRenderDelayEnabled)
+{
+    W_D(WOutputHelper);
+    if (d->renderDelayEnabled == newRenderDelayEnabled)
+        return;
+    d->renderDelayEnabled = newRenderDelayEnabled;
+    d->scheduler.reset();
+
+    // Don't wait for a frame that will never be scheduled
+    if (!newRenderDelayEnabled && d->renderDelayTimer && d->renderDelayTimer->isActive())
+        d->renderFrame();
+
+    Q_EMIT renderDelayEnabledChanged();
+    Q_EMIT frameStatsChanged();
+}
+
+qint64 WOutputHelper::renderDelay() const
+{
+    W_DC(WOutputHelper);
+    return d->scheduler.stats().renderDelay;
+}
+
+qint64 WOutputHelper::predictedRenderTime() const
+{
+    W_DC(WOutputHelper);
+    return d->scheduler.stats().predictedRenderTime;
+}
+
+quint64 WOutputHelper::missedFrames() const
+{
+    W_DC(WOutputHelper);
+    return d->scheduler.stats().missedFrames;
+}
+
+quint64 WOutputHelper::layerTests() const
+{
+    W_DC(WOutputHelper);
+    return d->layerTests;
+}
+
+quint64 WOutputHelper::layerTestCacheHits() const
+{
+    W_DC(WOutputHelper);
+    return d->layerTestCacheHits;
+}
+
+quint64 WOutputHelper::layerCompositeFallbacks() const
+{
+    W_DC(WOutputHelper);
+    return d->layerCompositeFallbacks;
+}
+
+void WOutputHelper::addLayerCompositeFallback()
+{
+    W_D(WOutputHelper);
+    ++d->layerCompositeFallbacks;
+    Q_EMIT layerTestStatsChanged();
+}
+
 void WOutputHelper::resetState(bool resetRenderable)
 {
     W_D(WOutputHelper);
@@ -38,6 +38,13 @@ class WAYLIB_SERVER_EXPORT WOutputHelper : public QObject, public WObject
     Q_PROPERTY(bool renderable READ renderable NOTIFY renderableChanged)
     Q_PROPERTY(bool contentIsDirty READ contentIsDirty NOTIFY contentIsDirtyChanged)
     Q_PROPERTY(bool needsFrame READ needsFrame NOTIFY needsFrameChanged FINAL)
+    Q_PROPERTY(bool renderDelayEnabled READ renderDelayEnabled WRITE setRenderDelayEnabled NOTIFY renderDelayEnabledChanged FINAL)
+    Q_PROPERTY(qint64 renderDelay READ renderDelay NOTIFY frameStatsChanged FINAL)
+    Q_PROPERTY(qint64 predictedRenderTime READ predictedRenderTime NOTIFY frameStatsChanged FINAL)
+    Q_PROPERTY(quint64 missedFrames READ missedFrames NOTIFY frameStatsChanged FINAL)
+    Q_PROPERTY(quint64 layerTests READ layerTests NOTIFY layerTestStatsChanged FINAL)
+    Q_PROPERTY(quint64 layerTestCacheHits READ layerTestCacheHits NOTIFY layerTestStatsChanged FINAL)
+    Q_PROPERTY(quint64 layerCompositeFallbacks READ layerCompositeFallbacks NOTIFY layerTestStatsChanged FINAL)
 
 public:
     explicit WOutputHelper(WOutput *output, QObject *parent = nullptr);
@@ -66,18 +73,38 @@ public:
     bool contentIsDirty() const;
     bool needsFrame() const;
 
+    bool renderDelayEnabled() const;
+    void setRenderDelayEnabled(bool newRenderDelayEnabled);
+    // In nanoseconds
+    qint64 renderDelay() const;
+    qint64 predictedRenderTime() const;
+    quint64 missedFrames() const;
+
+    // The test commits issued to the backend, the tests answered by the
+    // cache, and the frames the layers fallback to the software composite.
+    quint64 layerTests() const;
+    quint64 layerTestCacheHits() const;
+    quint64 layerCompositeFallbacks() const;
+
     void resetState(bool resetRenderable);
     void update();
 
 protected:
     WOutputHelper(WOutput *output, bool renderable, bool contentIsDirty, bool needsFrame, QObject *parent = nullptr);
 
+    void addLayerCompositeFallback();
+
 Q_SIGNALS:
     void requestRender();
     void damaged();
     void renderableChanged();
     void contentIsDirtyChanged();
     void needsFrameChanged();
+    void renderDelayEnabledChanged();
+    void frameStatsChanged();
+    void layerTestStatsChanged();
+    // The timestamp (CLOCK_MONOTONIC) and the refresh interval are in nanoseconds
+    void presented(qint64 timestamp, qint64 refresh, quint64 seq, quint32 flags);
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -42,6 +42,8 @@ public:
     WOutputLayer::Flags flags = {0};
     int z = 0;
     QPointF cursorHotSpot;
+    QList<quint32> formats;
+    quint32 renderFormat = 0;
     QList<WOutputViewport*> outputs;
     QList<WOutputViewport*> inOutputsByHardware;
 };
@@ -283,6 +285,31 @@ void WOutputLayer::setCursorHotSpot(QPointF newCursorHotSpot)
     Q_EMIT cursorHotSpotChanged();
 }
 
+// The DRM fourcc codes for the layer's buffer in priority order, e.g. XRGB2101010
+// for the 10-bit contents. The formats not supported by the renderer or the output
+// are ignored, ARGB8888 (XRGB8888 if NoAlpha is set) is always the last choice.
+const QList<quint32> &WOutputLayer::formats() const
+{
+    W_DC(WOutputLayer);
+    return d->formats;
+}
+
+void WOutputLayer::setFormats(const QList<quint32> &newFormats)
+{
+    W_D(WOutputLayer);
+    if (d->formats == newFormats)
+        return;
+    d->formats = newFormats;
+    Q_EMIT formatsChanged();
+}
+
+// The format of the last rendered buffer, 0 if the layer isn't rendered yet.
+quint32 WOutputLayer::renderFormat() const
+{
+    W_DC(WOutputLayer);
+    return d->renderFormat;
+}
+
 void WOutputLayer::setAccepted(bool accepted)
 {
     W_D(WOutputLayer);
@@ -301,6 +328,15 @@ bool WOutputLayer::setInHardware(WOutputViewport *output, bool isHardware)
     return d->setInHardware(output, isHardware);
 }
 
+void WOutputLayer::setRenderFormat(quint32 format)
+{
+    W_D(WOutputLayer);
+    if (d->renderFormat == format)
+        return;
+    d->renderFormat = format;
+    Q_EMIT renderFormatChanged();
+}
+
 WAYLIB_SERVER_END_NAMESPACE
 
 #include "moc_woutputlayer.cpp"
@@ -27,6 +27,8 @@ class WAYLIB_SERVER_EXPORT WOutputLayer : public QObject
     Q_PROPERTY(QList<WOutputViewport*> inOutputsByHardware READ inOutputsByHardware NOTIFY inOutputsByHardwareChanged FINAL)
     Q_PROPERTY(int z READ z WRITE setZ NOTIFY zChanged FINAL)
     Q_PROPERTY(QPointF cursorHotSpot READ cursorHotSpot WRITE setCursorHotSpot NOTIFY cursorHotSpotChanged FINAL)
+    Q_PROPERTY(QList<quint32> formats READ formats WRITE setFormats NOTIFY formatsChanged FINAL)
+    Q_PROPERTY(quint32 renderFormat READ renderFormat NOTIFY renderFormatChanged FINAL)
     QML_NAMED_ELEMENT(OutputLayer)
     QML_UNCREATABLE("OutputLayer is only available via attached properties")
     QML_ATTACHED(WOutputLayer)
@@ -71,6 +73,10 @@ public:
     QPointF cursorHotSpot() const;
     void setCursorHotSpot(QPointF newCursorHotSpot);
 
+    const QList<quint32> &formats() const;
+    void setFormats(const QList<quint32> &newFormats);
+    quint32 renderFormat() const;
+
 Q_SIGNALS:
     void enabledChanged();
     void flagsChanged();
@@ -80,11 +86,14 @@ Q_SIGNALS:
     void keepLayerChanged();
     void forceChanged();
     void cursorHotSpotChanged();
+    void formatsChanged();
+    void renderFormatChanged();
 
 private:
     void setAccepted(bool accepted);
     bool isAccepted() const;
     bool setInHardware(WOutputViewport *output, bool isHardware);
+    void setRenderFormat(quint32 format);
 
     friend class OutputLayer;
 };
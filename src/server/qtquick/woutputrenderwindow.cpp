@@ -15,6 +15,13 @@
 #include "weventjunkman.h"
 #include "winputdevice.h"
 #include "wseat.h"
+#include "wsurface.h"
+#include "wsurfaceitem.h"
+#include "wsgtextureprovider.h"
+#include "wrenderbuffernode_p.h"
+#include "wframescheduler_p.h"
+#include "winputlatencystats.h"
+#include "wtools.h"
 
 #include "platformplugin/qwlrootsintegration.h"
 #include "platformplugin/qwlrootscreen.h"
@@ -33,12 +40,14 @@
 #include <qwoutputlayer.h>
 #include <qwegl.h>
 #include <qwoutputinterface.h>
+#include <qwrendererinterface.h>
 
 #include <QOffscreenSurface>
 #include <QQuickRenderControl>
 #include <QOpenGLFunctions>
 #include <QLoggingCategory>
 #include <QRunnable>
+#include <QElapsedTimer>
 #include <memory>
 
 #define protected public
@@ -67,6 +76,7 @@ extern "C" {
 #include <wlr/render/vulkan.h>
 #endif
 #include <wlr/render/gles2.h>
+#include <wlr/render/pixman.h>
 }
 
 #include <drm_fourcc.h>
@@ -79,6 +89,14 @@ Q_LOGGING_CATEGORY(wlcRenderer, "waylib.server.renderer", QtDebugMsg)
 #else
 Q_LOGGING_CATEGORY(wlcRenderer, "waylib.server.renderer", QtWarningMsg)
 #endif
+static qint64 defaultRenderBufferPoolBudget()
+{
+    // In MiB
+    bool ok = false;
+    const int budget = qEnvironmentVariableIntValue("WAYLIB_RENDER_BUFFER_POOL_BUDGET", &ok);
+    return qint64(ok ? std::max(budget, 0) : 128) * 1024 * 1024;
+}
+
 inline static void resetGlState()
 {
 #ifndef QT_NO_OPENGL
@@ -132,6 +150,7 @@ public:
             : layer(l)
             , wlrLayer(layer)
             , contentsIsDirty(true)
+            , formatIsSettled(false)
         {
 
         }
@@ -150,6 +169,14 @@ public:
         uint contentsIsDirty:1;
         // end
 
+        // The negotiated formats for the layer's buffer, switch to the next one
+        // if the current format is rejected by WOutputHelper::testCommit.
+        uint formatIsSettled:1;
+        int formatIndex = 0;
+        QList<uint32_t> formats;
+        QList<quint32> requestedFormats;
+        uint32_t fallbackFormat = DRM_FORMAT_INVALID;
+
         QRectF mapRect;
         QRectF noClipMapRect;
         QRect mapToOutput;
@@ -179,6 +206,10 @@ public:
     inline void init() {
         connect(this, &OutputHelper::requestRender, renderWindow(), qOverload<>(&WOutputRenderWindow::render));
         connect(this, &OutputHelper::damaged, renderWindow(), &WOutputRenderWindow::scheduleRender);
+        connect(this, &OutputHelper::presented, this, [this] (qint64 timestamp, qint64 refresh) {
+            if (m_output)
+                Q_EMIT renderWindow()->outputPresented(m_output, timestamp, refresh);
+        });
         // TODO: pre update scale after WOutputHelper::setScale
         output()->output()->safeConnect(&WOutput::scaleChanged, this, &OutputHelper::updateSceneDPR);
     }
@@ -239,11 +270,69 @@ public:
     }
 
     qw_buffer *renderLayer(LayerData *layer, bool *dontEndRenderAndReturnNeedsEndRender);
+    bool tryNextLayerFormat(LayerData *layer);
+    bool retryRejectedLayers(const QList<LayerData*> &layerDatas, wlr_output_layer_state_array &layers);
     WBufferRenderer *afterRender();
     WBufferRenderer *compositeLayers(const QVector<LayerData*> layers, bool forceShadowRenderer);
+    bool tryDirectScanout();
     bool commit(WBufferRenderer *buffer);
     bool tryToHardwareCursor(const LayerData *layer);
 
+    inline qint64 takeRenderWaitTime() {
+        qint64 time = bufferRenderer()->takeWaitTime();
+        for (auto layer : std::as_const(m_layers)) {
+            if (layer->renderer)
+                time += layer->renderer->takeWaitTime();
+        }
+        return time;
+    }
+
+    inline WInputLatencyStats *inputLatency() {
+        if (!m_inputLatency)
+            m_inputLatency = new WInputLatencyStats(this);
+        return m_inputLatency;
+    }
+    // Keep the earliest one if there are many input events in a frame
+    inline void markInputReceived(qint64 time) {
+        if (m_pendingInputTime == 0)
+            m_pendingInputTime = time;
+    }
+    // The input event is only waited by the outputs showing the position of
+    // the pointer event or the item of the keyboard focus.
+    inline bool isAffectedBy(QInputEvent *event) const {
+        const QSize pixelSize(qwoutput()->handle()->width, qwoutput()->handle()->height);
+        const QRectF outputRect(QPointF(0, 0), pixelSize / devicePixelRatio());
+
+        if (event->isPointerEvent()) {
+            auto pe = static_cast<QPointerEvent*>(event);
+            auto contentItem = renderWindow()->contentItem();
+            for (const auto &point : pe->points()) {
+                if (outputRect.contains(output()->mapToOutput(contentItem, point.scenePosition())))
+                    return true;
+            }
+            return pe->points().isEmpty();
+        }
+
+        if (event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease) {
+            // The shortcuts of the compositor maybe change any output
+            auto item = renderWindow()->activeFocusItem();
+            if (!item || item == renderWindow()->contentItem())
+                return true;
+            return outputRect.intersects(output()->mapToOutput(item, item->boundingRect()));
+        }
+
+        return true;
+    }
+    inline void clearPendingInput() {
+        m_pendingInputTime = 0;
+    }
+    inline void inputCommitted() {
+        if (m_pendingInputTime == 0)
+            return;
+        inputLatency()->addSample(WFrameScheduler::monotonicTime() - m_pendingInputTime);
+        m_pendingInputTime = 0;
+    }
+
 private:
     WOutputViewport *m_output = nullptr;
     QList<LayerData*> m_layers;
@@ -253,6 +342,11 @@ private:
     BufferRendererProxy *m_cursorLayerProxy = nullptr;
     bool m_cursorDirty = false;
     bool m_hardwareCursorRenderComplete = false;
+    // the buffer of the client is set to the output state
+    bool m_directScanout = false;
+    // the receive time of the first input event after the last commit
+    qint64 m_pendingInputTime = 0;
+    WInputLatencyStats *m_inputLatency = nullptr;
 
     // for compositeLayers
     QPointer<WOutputViewport> m_output2;
@@ -303,6 +397,9 @@ public:
 
         return true;
     }
+    inline void setRenderFormat(uint32_t format) {
+        layer->setRenderFormat(format);
+    }
     inline bool tryReject() const {
         return state != Accepted;
     }
@@ -422,6 +519,8 @@ public:
     bool initRCWithRhi();
     void updateSceneDPR();
     void sortOutputs();
+    void updateOcclusion();
+    void clearOcclusion();
 
     QVector<std::pair<OutputHelper *, WBufferRenderer *>>
     doRenderOutputs(const QList<OutputHelper *> &outputs, bool forceRender);
@@ -455,6 +554,11 @@ public:
     QList<OutputHelper*> outputs;
     QList<OutputLayer*> layers;
     bool disableLayers = false;
+    bool batchedRendering = false;
+    qint64 renderBufferPoolBudget = defaultRenderBufferPoolBudget();
+    bool occlusionCulling = qEnvironmentVariableIsSet("WAYLIB_ENABLE_OCCLUSION_CULLING");
+    int occludedFrameCallbackInterval = 1000;
+    QList<QPointer<WSurfaceItemContent>> occludedContents;
 
     QOpenGLContext *glContext = nullptr;
 #ifdef ENABLE_VULKAN_RENDER
@@ -462,6 +566,15 @@ public:
 #endif
 
     QStack<WBufferRenderer*> rendererList;
+
+    // In nanoseconds, accumulated since the window is created, see renderTimings()
+    struct {
+        quint64 frames = 0;
+        qint64 record = 0;
+        qint64 wait = 0;
+        qint64 submit = 0;
+        qint64 commit = 0;
+    } renderTimings;
 };
 
 WOutputRenderWindowPrivate *OutputHelper::renderWindowD() const
@@ -606,6 +719,45 @@ static inline QRectF scaleRect(const QRectF &r, qreal xScale, qreal yScale) {
     return QRectF(r.x() * xScale, r.y() * yScale, r.width() * xScale, r.height() * yScale);
 }
 
+// Keep the formats both supported by the renderer and the output, wlroots doesn't
+// provide the formats of the output layers, so use the primary formats instead.
+static QList<uint32_t> negotiateLayerFormats(wlr_output *output,
+                                             const QList<quint32> &preferredFormats,
+                                             uint32_t fallbackFormat)
+{
+    QList<uint32_t> formats;
+    wlr_renderer *renderer = output->renderer;
+    const wlr_drm_format_set *renderFormats = renderer && renderer->impl->get_render_formats
+                                                  ? renderer->impl->get_render_formats(renderer)
+                                                  : nullptr;
+    // nullptr if the output can display any format
+    const wlr_drm_format_set *displayFormats = output->allocator
+                                                   ? wlr_output_get_primary_formats(output, output->allocator->buffer_caps)
+                                                   : nullptr;
+    // QSGSoftwareRenderer paints to the QImage of the buffer
+    const bool needsImageFormat = renderer && wlr_renderer_is_pixman(renderer);
+
+    for (auto format : preferredFormats) {
+        if (formats.contains(format))
+            continue;
+        if (format != fallbackFormat) {
+            if (!renderFormats || !wlr_drm_format_set_get(renderFormats, format))
+                continue;
+            if (displayFormats && !wlr_drm_format_set_get(displayFormats, format))
+                continue;
+            if (needsImageFormat && WTools::toImageFormat(format) == QImage::Format_Invalid)
+                continue;
+        }
+
+        formats.append(format);
+    }
+
+    if (!formats.contains(fallbackFormat))
+        formats.append(fallbackFormat);
+
+    return formats;
+}
+
 qw_buffer *OutputHelper::renderLayer(LayerData *layer, bool *dontEndRenderAndReturnNeedsEndRender)
 {
     auto source = layer->layer->layer->parent();
@@ -734,19 +886,36 @@ qw_buffer *OutputHelper::renderLayer(LayerData *layer, bool *dontEndRenderAndRet
         }
     }
 
+    {
+        const auto &requestedFormats = layer->layer->layer->formats();
+        const bool alpha = !layer->layer->layer->flags().testFlag(WOutputLayer::NoAlpha);
+        const uint32_t fallbackFormat = alpha ? DRM_FORMAT_ARGB8888 : DRM_FORMAT_XRGB8888;
+
+        if (layer->formats.isEmpty()
+            || layer->requestedFormats != requestedFormats
+            || layer->fallbackFormat != fallbackFormat) {
+            layer->formats = negotiateLayerFormats(qwoutput()->handle(), requestedFormats, fallbackFormat);
+            layer->requestedFormats = requestedFormats;
+            layer->fallbackFormat = fallbackFormat;
+            layer->formatIndex = 0;
+            layer->formatIsSettled = false;
+            layer->contentsIsDirty = true;
+        }
+    }
+
     layer->mapToOutput = QRect((layer->mapRect.topLeft() * dpr).toPoint(), layer->pixelSize);
     auto buffer = layer->renderer->lastBuffer();
 
     if (!buffer || layer->contentsIsDirty) {
         layer->renderer->setSize(layer->pixelSize / dpr);
 
-        const bool alpha = !layer->layer->layer->flags().testFlag(WOutputLayer::NoAlpha);
+        const uint32_t format = layer->formats.at(layer->formatIndex);
         // Don't use OutputHelper::beginRender, because the dpr maybe is from LayerData::mapFrom
-        buffer = layer->renderer->beginRender(layer->pixelSize, dpr,
-                                              // TODO: Allows control format by WOutputLayer
-                                              alpha ? DRM_FORMAT_ARGB8888 : DRM_FORMAT_XRGB8888,
+        buffer = layer->renderer->beginRender(layer->pixelSize, dpr, format,
                                               WBufferRenderer::DontConfigureSwapchain);
         if (buffer) {
+            layer->layer->setRenderFormat(format);
+
             const QRectF sr = QRectF(layer->mapRect.topLeft() - layer->noClipMapRect.topLeft(), layer->mapRect.size());
             const QRectF tr(QPointF(0, 0), layer->mapRect.size());
 
@@ -771,6 +940,63 @@ qw_buffer *OutputHelper::renderLayer(LayerData *layer, bool *dontEndRenderAndRet
     return buffer;
 }
 
+// Return true if the format of the layer is changed.
+bool OutputHelper::tryNextLayerFormat(LayerData *layer)
+{
+    if (layer->formatIsSettled)
+        return false;
+
+    if (layer->formatIndex + 1 < layer->formats.size()) {
+        ++layer->formatIndex;
+        return true;
+    }
+
+    // All formats are rejected, so the format isn't the reason, keep
+    // the preferred format for the software composite.
+    layer->formatIsSettled = true;
+    if (layer->formatIndex == 0)
+        return false;
+    layer->formatIndex = 0;
+    return true;
+}
+
+// Rerender the layers rejected by WOutputHelper::testCommit in the next format,
+// return true if any layer is changed and needs to test again.
+bool OutputHelper::retryRejectedLayers(const QList<LayerData*> &layerDatas,
+                                       wlr_output_layer_state_array &layers)
+{
+    Q_ASSERT(layerDatas.size() == layers.size());
+    bool changed = false;
+
+    for (int i = 0; i < layers.size(); ++i) {
+        auto &state = layers[i];
+        auto data = layerDatas.at(i);
+
+        if (state.accepted) {
+            data->formatIsSettled = true;
+            continue;
+        }
+
+        if (!tryNextLayerFormat(data))
+            continue;
+
+        data->contentsIsDirty = true;
+        bool needsEndBuffer = false;
+        auto buffer = renderLayer(data, &needsEndBuffer);
+        if (!buffer) {
+            data->formatIsSettled = true;
+            continue;
+        }
+
+        state.buffer = buffer->handle();
+        if (needsEndBuffer)
+            data->renderer->endRender();
+        changed = true;
+    }
+
+    return changed;
+}
+
 struct Q_DECL_HIDDEN QScopedPointerWlArrayDeleter {
     static inline void cleanup(wl_array *pointer) {
         if (pointer)
@@ -846,7 +1072,9 @@ WBufferRenderer *OutputHelper::afterRender()
     }
 
     static bool noHardwareLayers = qEnvironmentVariableIsSet("WAYLIB_NO_HARDWARE_LAYERS");
-    const bool ok = !noHardwareLayers && WOutputHelper::testCommit(bufferRenderer()->currentBuffer(), layers);
+    bool ok = !noHardwareLayers && WOutputHelper::testCommit(bufferRenderer()->currentBuffer(), layers);
+    while (ok && retryRejectedLayers(needsCompositeLayers, layers))
+        ok = WOutputHelper::testCommit(bufferRenderer()->currentBuffer(), layers);
     int needsSoftwareCompositeBeginIndex = -1;
     int needsSoftwareCompositeEndIndex = -1;
     bool forceShadowRender = false;
@@ -943,6 +1171,7 @@ WBufferRenderer *OutputHelper::afterRender()
         return bufferRenderer();
     }
 
+    addLayerCompositeFallback();
     return compositeLayers(needsCompositeLayers, forceShadowRender);
 }
 
@@ -1049,11 +1278,256 @@ WBufferRenderer *OutputHelper::compositeLayers(const QList<LayerData*> layers, b
     return bufferRenderer();
 }
 
+// Find the topmost item that has contents in the outputRect, return true if
+// found and stop searching, the result is nullptr if the item is translucent.
+static bool findTopmostContentItem(QQuickItem *item, const WOutputViewport *viewport,
+                                   const QRectF &outputRect, qreal opacity, QQuickItem **result)
+{
+    if (!item->isVisible() || qobject_cast<WOutputViewport*>(item)
+        || qobject_cast<WBufferRenderer*>(item)) {
+        return false;
+    }
+
+    opacity *= item->opacity();
+    if (qFuzzyIsNull(opacity))
+        return false;
+
+    auto d = QQuickItemPrivate::get(item);
+    bool hasContents = item->flags().testFlag(QQuickItem::ItemHasContents);
+    const bool isLayer = d->extra.isAllocated() && d->extra->layer && d->extra->layer->enabled();
+
+    const auto childItems = d->paintOrderChildItems();
+    int i = childItems.size() - 1;
+    if (!isLayer) {
+        // The children with negative z is painted before the contents of the parent
+        for (; i >= 0 && childItems.at(i)->z() >= 0; --i) {
+            if (findTopmostContentItem(childItems.at(i), viewport, outputRect, opacity, result))
+                return true;
+        }
+    } else {
+        // The item and its children are rendered to a texture, e.g. for effects
+        hasContents = true;
+    }
+
+    if (hasContents) {
+        const QRectF rect = viewport->mapToOutput(item, item->boundingRect());
+        if (rect.intersects(outputRect)) {
+            *result = (isLayer || !qFuzzyCompare(opacity, 1.0)) ? nullptr : item;
+            return true;
+        }
+    }
+
+    if (!isLayer) {
+        for (; i >= 0; --i) {
+            if (findTopmostContentItem(childItems.at(i), viewport, outputRect, opacity, result))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+struct Q_DECL_HIDDEN OcclusionState
+{
+    const WOutputViewport *viewport;
+    QRectF outputRect;
+    // The area covered by the opaque surfaces in the output coordinates
+    QRegion opaque;
+    QSet<WSurfaceItemContent*> *visible;
+    QSet<WSurfaceItemContent*> *occluded;
+};
+
+static QRect innerAlignedRect(const QRectF &rect)
+{
+    const int left = qCeil(rect.left());
+    const int top = qCeil(rect.top());
+    return QRect(QPoint(left, top), QPoint(qFloor(rect.right()) - 1, qFloor(rect.bottom()) - 1));
+}
+
+// The opaque region of the surface in the output coordinates, only if the
+// item isn't rotated, otherwise it's ignored.
+static QRegion opaqueRegionInOutput(WSurfaceItemContent *content, const WOutputViewport *viewport)
+{
+    auto surface = content->surface();
+    if (!surface || !surface->handle())
+        return {};
+
+    auto wsurface = surface->handle()->handle();
+    if (!pixman_region32_not_empty(&wsurface->opaque_region))
+        return {};
+
+    const auto transform = (viewport->mapToViewport(content)
+                            * QMatrix4x4(viewport->sourceRectToTargetRectTransfrom())).toTransform();
+    if (transform.type() > QTransform::TxScale)
+        return {};
+
+    const QSize surfaceSize = surface->size();
+    if (surfaceSize.isEmpty())
+        return {};
+
+    const QRectF geometry(content->ignoreBufferOffset() ? QPointF() : QPointF(content->bufferOffset()),
+                          content->size());
+    const qreal sx = geometry.width() / surfaceSize.width();
+    const qreal sy = geometry.height() / surfaceSize.height();
+
+    QRegion region;
+    int count = 0;
+    const pixman_box32_t *boxes = pixman_region32_rectangles(&wsurface->opaque_region, &count);
+    for (int i = 0; i < count; ++i) {
+        const QRectF rect(geometry.x() + boxes[i].x1 * sx, geometry.y() + boxes[i].y1 * sy,
+                          (boxes[i].x2 - boxes[i].x1) * sx, (boxes[i].y2 - boxes[i].y1) * sy);
+        region += innerAlignedRect(transform.mapRect(rect));
+    }
+
+    return region;
+}
+
+// Walk the items from top to bottom in the same order as findTopmostContentItem,
+// the surfaces used by the effects or in the layers are always visible, and
+// only the opaque surfaces with full opacity can occlude the others.
+static void collectOcclusion(QQuickItem *item, OcclusionState *state, qreal opacity,
+                             bool canOcclude, bool inEffect)
+{
+    if (!item->isVisible() || qobject_cast<WOutputViewport*>(item)
+        || qobject_cast<WBufferRenderer*>(item)) {
+        return;
+    }
+
+    opacity *= item->opacity();
+    if (qFuzzyIsNull(opacity))
+        return;
+
+    auto d = QQuickItemPrivate::get(item);
+    if (d->extra.isAllocated()) {
+        if (d->extra->effectRefCount > 0 || (d->extra->layer && d->extra->layer->enabled()))
+            inEffect = true;
+    }
+    // The opaque region outside the clip isn't painted
+    if (item->clip())
+        canOcclude = false;
+
+    const auto childItems = d->paintOrderChildItems();
+    int i = childItems.size() - 1;
+    // The children with negative z is painted before the contents of the parent
+    for (; i >= 0 && childItems.at(i)->z() >= 0; --i)
+        collectOcclusion(childItems.at(i), state, opacity, canOcclude, inEffect);
+
+    if (auto content = qobject_cast<WSurfaceItemContent*>(item)) {
+        const QRectF rect = state->viewport->mapToOutput(item, item->boundingRect()) & state->outputRect;
+        if (!rect.isEmpty()) {
+            if (inEffect || !(QRegion(rect.toAlignedRect()) - state->opaque).isEmpty())
+                state->visible->insert(content);
+            else
+                state->occluded->insert(content);
+
+            if (canOcclude && !inEffect && qFuzzyCompare(opacity, 1.0))
+                state->opaque += opaqueRegionInOutput(content, state->viewport);
+        }
+    }
+
+    for (; i >= 0; --i)
+        collectOcclusion(childItems.at(i), state, opacity, canOcclude, inEffect);
+}
+
+bool OutputHelper::tryDirectScanout()
+{
+    Q_ASSERT(!m_directScanout);
+
+    static bool disabled = qEnvironmentVariableIsSet("WAYLIB_DISABLE_DIRECT_SCANOUT");
+    if (disabled || output()->offscreen())
+        return false;
+
+    // The contents of this output maybe used by the others
+    if (bufferRenderer()->m_textureProvider || bufferRenderer()->shouldCacheBuffer())
+        return false;
+
+    // The layers and the hardware cursor need compositing
+    for (const LayerData *layer : std::as_const(m_layers)) {
+        if (layer->layer->isEnabled())
+            return false;
+    }
+
+    if (qwoutput()->handle()->transform != WL_OUTPUT_TRANSFORM_NORMAL)
+        return false;
+
+    const QSize pixelSize(qwoutput()->handle()->width, qwoutput()->handle()->height);
+    const QRectF outputRect(QPointF(0, 0), pixelSize / devicePixelRatio());
+    QQuickItem *source = output()->input();
+    if (!source)
+        source = renderWindow()->contentItem();
+
+    QQuickItem *item = nullptr;
+    if (!findTopmostContentItem(source, output(), outputRect, 1.0, &item) || !item)
+        return false;
+    // It's painted above the source, e.g. the software composited layers
+    if (auto extraSource = WOutputViewportPrivate::get(output())->extraRenderSource) {
+        QQuickItem *extraItem = nullptr;
+        if (findTopmostContentItem(extraSource, output(), outputRect, 1.0, &extraItem))
+            return false;
+    }
+
+    auto content = qobject_cast<WSurfaceItemContent*>(item);
+    if (!content || !content->surface())
+        return false;
+
+    auto wsurface = content->surface()->handle()->handle();
+    if (wsurface->current.transform != WL_OUTPUT_TRANSFORM_NORMAL
+        || wsurface->current.viewport.has_src) {
+        return false;
+    }
+
+    // The surface must be opaque, the contents behind it is invisible
+    pixman_box32_t surfaceBox = { 0, 0, wsurface->current.width, wsurface->current.height };
+    if (pixman_region32_contains_rectangle(&wsurface->opaque_region, &surfaceBox) != PIXMAN_REGION_IN)
+        return false;
+
+    auto tp = content->wTextureProvider();
+    qw_buffer *buffer = tp ? tp->qwBuffer() : nullptr;
+    if (!buffer || QSize(buffer->handle()->width, buffer->handle()->height) != pixelSize)
+        return false;
+
+    // The buffer must be mapped to the whole output without scaling and rotation
+    const QRectF geometry(content->ignoreBufferOffset() ? QPointF() : content->bufferOffset(),
+                          content->size());
+    const qreal dpr = devicePixelRatio();
+    const auto isSamePoint = [] (const QPointF &p1, const QPointF &p2) {
+        return qAbs(p1.x() - p2.x()) < 0.01 && qAbs(p1.y() - p2.y()) < 0.01;
+    };
+    if (!isSamePoint(output()->mapToOutput(content, geometry.topLeft()) * dpr, QPointF(0, 0))
+        || !isSamePoint(output()->mapToOutput(content, geometry.topRight()) * dpr,
+                        QPointF(pixelSize.width(), 0))
+        || !isSamePoint(output()->mapToOutput(content, geometry.bottomRight()) * dpr,
+                        QPointF(pixelSize.width(), pixelSize.height()))) {
+        return false;
+    }
+
+    if (!WOutputHelper::testCommit(buffer, {}))
+        return false;
+
+    setBuffer(buffer);
+    m_directScanout = true;
+
+    return true;
+}
+
 bool OutputHelper::commit(WBufferRenderer *buffer)
 {
     if (output()->offscreen())
         return true;
 
+    if (m_directScanout) {
+        m_directScanout = false;
+        // The contents of the output isn't from the WBufferRenderer, the next
+        // commit of it should damage the whole output.
+        m_lastCommitBuffer = nullptr;
+
+        const bool ok = WOutputHelper::commit();
+        WOutputViewportPrivate::get(output())->setDirectScanout(ok);
+        return ok;
+    }
+
+    WOutputViewportPrivate::get(output())->setDirectScanout(false);
+
     if (!buffer || !buffer->currentBuffer()) {
         Q_ASSERT(!this->buffer());
         return WOutputHelper::commit();
@@ -1261,7 +1735,8 @@ void WOutputRenderWindowPrivate::init()
     6. QQuickRenderControlPrivate::maybeUpdate
     7. QQuickRenderControl::sceneChanged
     */
-    // TODO: Get damage regions from the Qt, and use WOutputDamage::add instead of WOutput::update.
+    // The damage regions of the scene are collected by WBufferRenderer itself,
+    // here only needs to notify the outputs there are new contents.
     QObject::connect(rc(), &QQuickRenderControl::renderRequested,
                      q, qOverload<>(&WOutputRenderWindow::update));
     QObject::connect(rc(), &QQuickRenderControl::sceneChanged,
@@ -1412,6 +1887,8 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
                 continue;
 
             if (!helper->contentIsDirty()) {
+                // The input events don't change the contents
+                helper->clearPendingInput();
                 if (helper->needsFrame())
                     renderResults.append(helper);
                 continue;
@@ -1420,6 +1897,12 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
 
         Q_ASSERT(helper->output()->output()->scale() <= helper->output()->devicePixelRatio());
 
+        // Don't render if the buffer of a client can be shown on the output directly
+        if (Q_LIKELY(!forceRender) && helper->tryDirectScanout()) {
+            renderResults.append(helper);
+            continue;
+        }
+
         const auto &format = helper->qwoutput()->handle()->render_format;
         const auto renderMatrix = helper->output()->renderMatrix();
 
@@ -1427,8 +1910,16 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
         if (!helper->output()->depends().isEmpty())
             updateDirtyNodes();
 
+        WBufferRenderer::RenderFlags flags = WBufferRenderer::RedirectOpenGLContextDefaultFrameBufferObject;
+        // Don't wait for the GPU after each output if no one uses the
+        // contents of this output in the current frame.
+        if (batchedRendering && !helper->bufferRenderer()->m_textureProvider
+            && !helper->bufferRenderer()->shouldCacheBuffer()) {
+            flags |= WBufferRenderer::DeferredFinish;
+        }
+
         qw_buffer *buffer = helper->beginRender(helper->bufferRenderer(), helper->output()->output()->size(), format,
-                                                WBufferRenderer::RedirectOpenGLContextDefaultFrameBufferObject);
+                                                flags);
         Q_ASSERT(buffer == helper->bufferRenderer()->currentBuffer());
         if (buffer) {
             helper->render(helper->bufferRenderer(), 0, renderMatrix,
@@ -1439,6 +1930,10 @@ WOutputRenderWindowPrivate::doRenderOutputs(const QList<OutputHelper*> &outputs,
         renderResults.append(helper);
     }
 
+    // Don't wait for the outputs rendered with DeferredFinish here, the CPU work
+    // of afterRender can overlap the GPU. doRender waits once for all of them
+    // before the commit, and WBufferRenderer::render waits by itself if it
+    // renders on the buffer again.
     QVector<std::pair<OutputHelper*, WBufferRenderer*>> needsCommit;
     needsCommit.reserve(renderResults.size());
     for (auto helper : std::as_const(renderResults)) {
@@ -1470,6 +1965,70 @@ static void QQuickAnimatorController_advance(QQuickAnimatorController *ac)
         ac->m_window->update();
 }
 
+void WOutputRenderWindowPrivate::updateOcclusion()
+{
+    if (!occlusionCulling)
+        return;
+
+    W_Q(WOutputRenderWindow);
+    QSet<WSurfaceItemContent*> visible;
+    QSet<WSurfaceItemContent*> occluded;
+
+    for (OutputHelper *helper : std::as_const(outputs)) {
+        if (!helper->qwoutput()->handle()->enabled)
+            continue;
+
+        const QSize pixelSize(helper->qwoutput()->handle()->width, helper->qwoutput()->handle()->height);
+        OcclusionState state {
+            .viewport = helper->output(),
+            .outputRect = QRectF(QPointF(0, 0), pixelSize / helper->devicePixelRatio()),
+            .opaque = {},
+            .visible = &visible,
+            .occluded = &occluded,
+        };
+
+        // The layers are composited separately, they maybe not painted in place
+        bool canOcclude = true;
+        for (const auto layer : std::as_const(helper->m_layers)) {
+            if (layer->layer->isEnabled())
+                canOcclude = false;
+        }
+
+        // It's painted above the source, e.g. the software composited layers
+        if (auto extraSource = WOutputViewportPrivate::get(helper->output())->extraRenderSource)
+            collectOcclusion(extraSource, &state, 1.0, canOcclude, false);
+
+        QQuickItem *source = helper->output()->input();
+        if (!source)
+            source = q->contentItem();
+        collectOcclusion(source, &state, 1.0, canOcclude, false);
+    }
+
+    // Occluded only if it's invisible on all outputs
+    occluded -= visible;
+
+    for (const auto &content : std::as_const(occludedContents)) {
+        if (content && !occluded.contains(content))
+            content->setOccluded(false, 0);
+    }
+
+    occludedContents.clear();
+    occludedContents.reserve(occluded.size());
+    for (auto content : std::as_const(occluded)) {
+        content->setOccluded(true, occludedFrameCallbackInterval);
+        occludedContents.append(content);
+    }
+}
+
+void WOutputRenderWindowPrivate::clearOcclusion()
+{
+    for (const auto &content : std::as_const(occludedContents)) {
+        if (content)
+            content->setOccluded(false, 0);
+    }
+    occludedContents.clear();
+}
+
 void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
                                           bool forceRender, bool doCommit)
 {
@@ -1482,7 +2041,15 @@ void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
         layer->beforeRender(q);
     }
 
+    QElapsedTimer timer;
+    timer.start();
+
+    // The coalesced pointer motion may change the hover state of the items,
+    // deliver it before the polish, otherwise it's shown in the next frame.
+    WSeat::flushPendingMotion(q);
     rc()->polishItems();
+    // After the polish, the geometries of the items are updated
+    updateOcclusion();
 
     if (QSGRendererInterface::isApiRhiBased(WRenderHelper::getGraphicsApi()))
         rc()->beginFrame();
@@ -1497,12 +2064,41 @@ void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
     Q_EMIT q->afterRendering();
     runAndClearJobs(&afterRenderingJobs);
 
-    if (QSGRendererInterface::isApiRhiBased(WRenderHelper::getGraphicsApi()))
+    qint64 waitTime = 0;
+    for (auto helper : std::as_const(outputs))
+        waitTime += helper->takeRenderWaitTime();
+    renderTimings.wait += waitTime;
+    renderTimings.record += timer.nsecsElapsed() - waitTime;
+    timer.restart();
+
+    // Submit the command buffer and wait for the GPU, it's the deferred wait
+    // of the outputs rendered with WBufferRenderer::DeferredFinish.
+    if (QSGRendererInterface::isApiRhiBased(WRenderHelper::getGraphicsApi())) {
+        bool needsFinish = false;
+        for (auto helper : std::as_const(outputs)) {
+            if (std::exchange(helper->bufferRenderer()->state.needsFinish, false))
+                needsFinish = true;
+        }
+
+        // Only the Vulkan backend of QRhi waits for the fence of the frame in
+        // endOffscreenFrame, the OpenGL backend only calls glFlush, so the GPU
+        // may be still writing the buffers when they are committed.
+        if (needsFinish && WRenderHelper::getGraphicsApi() != QSGRendererInterface::Vulkan) {
+            Q_ASSERT(rhi);
+            rhi->finish();
+        }
+
         rc()->endFrame();
+    }
+
+    renderTimings.submit += timer.nsecsElapsed();
+    timer.restart();
 
     if (doCommit) {
         for (auto i : std::as_const(needsCommit)) {
             bool ok = i.first->commit(i.second);
+            if (ok)
+                i.first->inputCommitted();
 
             if (i.second->currentBuffer()) {
                 i.second->endRender();
@@ -1512,6 +2108,9 @@ void WOutputRenderWindowPrivate::doRender(const QList<OutputHelper *> &outputs,
         }
     }
 
+    renderTimings.commit += timer.nsecsElapsed();
+    ++renderTimings.frames;
+
     resetGlState();
 
     // On Intel&Nvidia multi-GPU environment, wlroots using Intel card do render for all
@@ -1830,6 +2429,121 @@ QList<QPointer<QQuickItem>> WOutputRenderWindow::paintOrderItemList(QQuickItem *
     return result;
 }
 
+bool WOutputRenderWindow::batchedRendering() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->batchedRendering;
+}
+
+void WOutputRenderWindow::setBatchedRendering(bool newBatchedRendering)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->batchedRendering == newBatchedRendering)
+        return;
+    d->batchedRendering = newBatchedRendering;
+    Q_EMIT batchedRenderingChanged();
+}
+
+qint64 WOutputRenderWindow::renderBufferPoolBudget() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->renderBufferPoolBudget;
+}
+
+void WOutputRenderWindow::setRenderBufferPoolBudget(qint64 newRenderBufferPoolBudget)
+{
+    Q_D(WOutputRenderWindow);
+    newRenderBufferPoolBudget = std::max<qint64>(newRenderBufferPoolBudget, 0);
+    if (d->renderBufferPoolBudget == newRenderBufferPoolBudget)
+        return;
+    d->renderBufferPoolBudget = newRenderBufferPoolBudget;
+    Q_EMIT renderBufferPoolBudgetChanged();
+}
+
+bool WOutputRenderWindow::occlusionCulling() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->occlusionCulling;
+}
+
+void WOutputRenderWindow::setOcclusionCulling(bool newOcclusionCulling)
+{
+    Q_D(WOutputRenderWindow);
+    if (d->occlusionCulling == newOcclusionCulling)
+        return;
+    d->occlusionCulling = newOcclusionCulling;
+    if (newOcclusionCulling)
+        update();
+    else
+        d->clearOcclusion();
+    Q_EMIT occlusionCullingChanged();
+}
+
+int WOutputRenderWindow::occludedFrameCallbackInterval() const
+{
+    Q_D(const WOutputRenderWindow);
+    return d->occludedFrameCallbackInterval;
+}
+
+void WOutputRenderWindow::setOccludedFrameCallbackInterval(int newInterval)
+{
+    Q_D(WOutputRenderWindow);
+    newInterval = std::max(newInterval, 0);
+    if (d->occludedFrameCallbackInterval == newInterval)
+        return;
+    d->occludedFrameCallbackInterval = newInterval;
+    // Apply to the occluded surfaces in the next rendering
+    d->clearOcclusion();
+    update();
+    Q_EMIT occludedFrameCallbackIntervalChanged();
+}
+
+WInputLatencyStats *WOutputRenderWindow::inputLatency(WOutputViewport *output) const
+{
+    Q_D(const WOutputRenderWindow);
+    auto helper = d->getOutputHelper(output);
+    return helper ? helper->inputLatency() : nullptr;
+}
+
+QVariantMap WOutputRenderWindow::layerTestStats(WOutputViewport *output) const
+{
+    Q_D(const WOutputRenderWindow);
+    auto helper = d->getOutputHelper(output);
+    if (!helper)
+        return {};
+
+    return {
+        {"tests", helper->layerTests()},
+        {"cacheHits", helper->layerTestCacheHits()},
+        {"compositeFallbacks", helper->layerCompositeFallbacks()},
+    };
+}
+
+QVariantMap WOutputRenderWindow::renderTimings() const
+{
+    Q_D(const WOutputRenderWindow);
+    return {
+        {"frames", d->renderTimings.frames},
+        {"record", d->renderTimings.record},
+        {"wait", d->renderTimings.wait},
+        {"submit", d->renderTimings.submit},
+        {"commit", d->renderTimings.commit},
+    };
+}
+
+QVariantMap WOutputRenderWindow::renderBufferPoolStats() const
+{
+    const auto stats = WRenderBufferNode::poolStats(const_cast<WOutputRenderWindow*>(this));
+    return {
+        {"bytesHeld", stats.bytesHeld},
+        {"bytesInUse", stats.bytesInUse},
+        {"hits", stats.hits},
+        {"misses", stats.misses},
+        {"evictions", stats.evictions},
+        {"bytesCopied", stats.bytesCopied},
+    };
+}
+
 bool WOutputRenderWindow::disableLayers() const
 {
     Q_D(const WOutputRenderWindow);
@@ -1954,6 +2668,15 @@ bool WOutputRenderWindow::event(QEvent *event)
         return true;
     }
 
+    if (event->isInputEvent()) {
+        auto seat = WSeat::get(static_cast<QInputEvent*>(event));
+        const qint64 time = seat ? seat->currentInputTime() : WFrameScheduler::monotonicTime();
+        for (auto helper : std::as_const(d->outputs)) {
+            if (helper->isAffectedBy(static_cast<QInputEvent*>(event)))
+                helper->markInputReceived(time);
+        }
+    }
+
     if (QW::RenderWindow::beforeDisposeEventFilter(this, event)) {
         event->accept();
         QW::RenderWindow::afterDisposeEventFilter(this, event);
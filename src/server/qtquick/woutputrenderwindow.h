@@ -11,12 +11,14 @@
 #include <QQmlParserStatus>
 
 Q_MOC_INCLUDE(<wquickoutputlayout.h>)
+Q_MOC_INCLUDE(<winputlatencystats.h>)
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 class WOutputViewport;
 class WOutputLayer;
 class WBufferRenderer;
+class WInputLatencyStats;
 class WOutputRenderWindowPrivate;
 class WAYLIB_SERVER_EXPORT WOutputRenderWindow : public QQuickWindow, public QQmlParserStatus
 {
@@ -25,6 +27,10 @@ class WAYLIB_SERVER_EXPORT WOutputRenderWindow : public QQuickWindow, public QQm
     Q_PROPERTY(qreal width READ width WRITE setWidth NOTIFY widthChanged)
     Q_PROPERTY(qreal height READ height WRITE setHeight NOTIFY heightChanged)
     Q_PROPERTY(bool disableLayers READ disableLayers WRITE setDisableLayers NOTIFY disableLayersChanged FINAL)
+    Q_PROPERTY(bool batchedRendering READ batchedRendering WRITE setBatchedRendering NOTIFY batchedRenderingChanged FINAL)
+    Q_PROPERTY(qint64 renderBufferPoolBudget READ renderBufferPoolBudget WRITE setRenderBufferPoolBudget NOTIFY renderBufferPoolBudgetChanged FINAL)
+    Q_PROPERTY(bool occlusionCulling READ occlusionCulling WRITE setOcclusionCulling NOTIFY occlusionCullingChanged FINAL)
+    Q_PROPERTY(int occludedFrameCallbackInterval READ occludedFrameCallbackInterval WRITE setOccludedFrameCallbackInterval NOTIFY occludedFrameCallbackIntervalChanged FINAL)
     QML_NAMED_ELEMENT(OutputRenderWindow)
     Q_INTERFACES(QQmlParserStatus)
 
@@ -60,6 +66,39 @@ public:
     bool disableLayers() const;
     void setDisableLayers(bool newDisableLayers);
 
+    bool batchedRendering() const;
+    void setBatchedRendering(bool newBatchedRendering);
+
+    // In bytes, the unused buffers of WRenderBufferNode are kept in a pool
+    // until their memory exceeds the budget. The sizes are rounded up, the
+    // buffers are reused by the nodes in the similar sizes, except the ones
+    // used by a ShaderEffect.
+    qint64 renderBufferPoolBudget() const;
+    void setRenderBufferPoolBudget(qint64 newRenderBufferPoolBudget);
+
+    // The surfaces covered by the opaque surfaces on all outputs don't
+    // receive the frame callbacks and don't trigger rendering. It's off by
+    // default, a client may rely on the frame callbacks while it's hidden,
+    // enabled by default if WAYLIB_ENABLE_OCCLUSION_CULLING is set.
+    bool occlusionCulling() const;
+    void setOcclusionCulling(bool newOcclusionCulling);
+    // In milliseconds, the keepalive frame callbacks of the occluded
+    // surfaces, 0 means never.
+    int occludedFrameCallbackInterval() const;
+    void setOccludedFrameCallbackInterval(int newInterval);
+    // The latency from the input events to the commit of the output
+    Q_INVOKABLE WAYLIB_SERVER_NAMESPACE::WInputLatencyStats *inputLatency(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output) const;
+    // Contains bytesHeld, bytesInUse, hits, misses, evictions and bytesCopied
+    Q_INVOKABLE QVariantMap renderBufferPoolStats() const;
+    // Contains tests, cacheHits and compositeFallbacks of the hardware layers
+    Q_INVOKABLE QVariantMap layerTestStats(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output) const;
+    // Contains frames and the time (in nanoseconds) of the render loop since the window
+    // is created: record the commands, wait for the GPU in the middle of the frame,
+    // submit the frame (includes the wait for the GPU) and commit the outputs.
+    // The batched outputs only overlap the GPU with the CPU work on Vulkan, the
+    // other backends still block on QRhi::finish in submit before the commit.
+    Q_INVOKABLE QVariantMap renderTimings() const;
+
 public Q_SLOTS:
     void render();
     void render(WOutputViewport *output, bool doCommit);
@@ -76,7 +115,13 @@ Q_SIGNALS:
     void outputViewportInitialized(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output);
     void initialized();
     void disableLayersChanged();
+    void batchedRenderingChanged();
+    void renderBufferPoolBudgetChanged();
+    void occlusionCullingChanged();
+    void occludedFrameCallbackIntervalChanged();
     void renderEnd();
+    // The timestamp of CLOCK_MONOTONIC in nanoseconds when the contents are presented
+    void outputPresented(WAYLIB_SERVER_NAMESPACE::WOutputViewport *output, qint64 timestamp, qint64 refresh);
     void effectiveDevicePixelRatioChanged(qreal scale);
 
 private:
@@ -493,6 +493,12 @@ void WOutputViewport::setDepends(const QList<WOutputViewport *> &newDepends)
     Q_EMIT dependsChanged();
 }
 
+bool WOutputViewport::directScanout() const
+{
+    W_DC(WOutputViewport);
+    return d->directScanout;
+}
+
 void WOutputViewport::setOutputScale(float scale)
 {
     W_D(WOutputViewport);
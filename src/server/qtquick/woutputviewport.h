@@ -35,6 +35,7 @@ class WAYLIB_SERVER_EXPORT WOutputViewport : public QQuickItem, public virtual W
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputLayer*> layers READ layers NOTIFY layersChanged FINAL)
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputLayer*> hardwareLayers READ hardwareLayers NOTIFY hardwareLayersChanged FINAL)
     Q_PROPERTY(QList<WAYLIB_SERVER_NAMESPACE::WOutputViewport*> depends READ depends WRITE setDepends NOTIFY dependsChanged FINAL)
+    Q_PROPERTY(bool directScanout READ directScanout NOTIFY directScanoutChanged FINAL)
     QML_NAMED_ELEMENT(OutputViewport)
 
 public:
@@ -103,6 +104,8 @@ public:
     QList<WOutputViewport *> depends() const;
     void setDepends(const QList<WOutputViewport *> &newDepends);
 
+    bool directScanout() const;
+
 public Q_SLOTS:
     void setOutputScale(float scale);
     void rotateOutput(WOutput::Transform t);
@@ -126,6 +129,7 @@ Q_SIGNALS:
     void layersChanged();
     void hardwareLayersChanged();
     void dependsChanged();
+    void directScanoutChanged();
 
 private:
     void componentComplete() override;
@@ -20,16 +20,30 @@
 #include <private/qquickitem_p.h>
 #include <private/qsgplaintexture_p.h>
 
+#include <limits>
+#include <unordered_map>
+
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
+// Keep the buffers and their textures of the recently shown cursor images,
+// the frames of an animated xcursor are only uploaded in the first loop.
+// The textures are owned here and passed to WSGTextureProvider::setTexture,
+// it doesn't cache the textures it creates from the non-client buffers.
+static constexpr int MaxCachedCursorImages = 64;
+
 class Q_DECL_HIDDEN CursorTextureProvider : public WSGTextureProvider
 {
 public:
     CursorTextureProvider(WOutputRenderWindow *window)
         : WSGTextureProvider(window)
     {
+        setTextureCacheSize(MaxCachedCursorImages);
+    }
 
+    ~CursorTextureProvider() {
+        resetBuffer();
+        bufferCache.clear();
     }
 
     void setImage(const QImage &image) {
@@ -38,11 +52,26 @@ public:
             return;
         }
 
-        // WImageBufferImpl destroy following qw_buffer
-        auto buffer = qw_buffer::create(new WImageBufferImpl(image),
-                                       image.width(), image.height());
-        this->buffer.reset(buffer);
-        setBuffer(this->buffer.get());
+        auto it = bufferCache.find(image.cacheKey());
+        if (it == bufferCache.end()) {
+            if (bufferCache.size() >= MaxCachedCursorImages)
+                removeLeastRecentlyUsed();
+
+            // WImageBufferImpl destroy following qw_buffer
+            auto buffer = qw_buffer::create(new WImageBufferImpl(image),
+                                           image.width(), image.height());
+            it = bufferCache.emplace(image.cacheKey(), CachedBuffer{}).first;
+            it->second.buffer.reset(buffer);
+            if (auto w = window(); w && w->renderer())
+                it->second.texture.reset(qw_texture::from_buffer(*w->renderer(), *buffer));
+        }
+
+        it->second.lastUsed = ++usageCounter;
+        this->buffer = it->second.buffer.get();
+        if (Q_LIKELY(it->second.texture))
+            setTexture(it->second.texture.get(), this->buffer);
+        else
+            setBuffer(this->buffer);
     }
 
     void setProxy(WSGTextureProvider *proxy) {
@@ -66,10 +95,11 @@ public:
 
     void resetBuffer() {
         setBuffer(nullptr);
-        buffer.reset();
+        buffer = nullptr;
     }
     void reset() {
         resetBuffer();
+        bufferCache.clear();
         setProxy(nullptr);
     }
 
@@ -89,8 +119,33 @@ public:
         return WSGTextureProvider::qwBuffer();
     }
 
-    std::unique_ptr<qw_buffer, qw_buffer::droper> buffer;
+    qw_buffer *buffer = nullptr;
     QPointer<WSGTextureProvider> proxy;
+
+private:
+    void removeLeastRecentlyUsed() {
+        auto lru = bufferCache.end();
+        quint64 lastUsed = std::numeric_limits<quint64>::max();
+        for (auto it = bufferCache.begin(); it != bufferCache.end(); ++it) {
+            if (it->second.buffer.get() != buffer && it->second.lastUsed < lastUsed) {
+                lru = it;
+                lastUsed = it->second.lastUsed;
+            }
+        }
+        if (lru != bufferCache.end())
+            bufferCache.erase(lru);
+    }
+
+    struct CachedBuffer {
+        std::unique_ptr<qw_buffer, qw_buffer::droper> buffer;
+        // Destroyed before the buffer, it keeps a lock of the buffer
+        std::unique_ptr<qw_texture> texture;
+        quint64 lastUsed = 0;
+    };
+
+    // Key is QImage::cacheKey
+    std::unordered_map<qint64, CachedBuffer> bufferCache;
+    quint64 usageCounter = 0;
 };
 
 WQuickCursorAttached::WQuickCursorAttached(QQuickItem *parent)
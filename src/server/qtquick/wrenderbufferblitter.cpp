@@ -65,6 +65,9 @@ public:
     Content *content;
     QQuickItem *container = nullptr;
     mutable BlitTextureProvider *tp = nullptr;
+    // The texture provider is used out of the blitter, e.g. by a ShaderEffect
+    bool textureExported = false;
+    WRenderBufferNode::BlurOptions blur;
 };
 
 class Q_DECL_HIDDEN Content : public QQuickItem
@@ -89,7 +92,15 @@ public:
         if (QQuickItem::isTextureProvider())
             return QQuickItem::textureProvider();
 
-        return d()->ensureTextureProvider();
+        auto d = this->d();
+        if (Q_UNLIKELY(!d->textureExported)) {
+            // The consumers may sample the whole texture, the node needs the
+            // buffers in the exact size since the next frame
+            d->textureExported = true;
+            QMetaObject::invokeMethod(parentItem(), &QQuickItem::update, Qt::QueuedConnection);
+        }
+
+        return d->ensureTextureProvider();
     }
 
     inline bool offscreen() const {
@@ -206,6 +217,56 @@ void WRenderBufferBlitter::setOffscreen(bool newOffscreen)
         Q_EMIT offscreenChanged();
 }
 
+qreal WRenderBufferBlitter::blurRadius() const
+{
+    W_DC(WRenderBufferBlitter);
+    return d->blur.radius;
+}
+
+void WRenderBufferBlitter::setBlurRadius(qreal newBlurRadius)
+{
+    W_D(WRenderBufferBlitter);
+    newBlurRadius = std::max(newBlurRadius, 0.0);
+    if (qFuzzyCompare(d->blur.radius, newBlurRadius))
+        return;
+    d->blur.radius = newBlurRadius;
+    update();
+    Q_EMIT blurRadiusChanged();
+}
+
+qreal WRenderBufferBlitter::blurNoise() const
+{
+    W_DC(WRenderBufferBlitter);
+    return d->blur.noise;
+}
+
+void WRenderBufferBlitter::setBlurNoise(qreal newBlurNoise)
+{
+    W_D(WRenderBufferBlitter);
+    newBlurNoise = std::clamp(newBlurNoise, 0.0, 1.0);
+    if (qFuzzyCompare(d->blur.noise, newBlurNoise))
+        return;
+    d->blur.noise = newBlurNoise;
+    update();
+    Q_EMIT blurNoiseChanged();
+}
+
+QColor WRenderBufferBlitter::blurTint() const
+{
+    W_DC(WRenderBufferBlitter);
+    return d->blur.tint;
+}
+
+void WRenderBufferBlitter::setBlurTint(const QColor &newBlurTint)
+{
+    W_D(WRenderBufferBlitter);
+    if (d->blur.tint == newBlurTint)
+        return;
+    d->blur.tint = newBlurTint;
+    update();
+    Q_EMIT blurTintChanged();
+}
+
 void WRenderBufferBlitter::invalidateSceneGraph()
 {
     W_D(WRenderBufferBlitter);
@@ -226,13 +287,15 @@ QSGNode *WRenderBufferBlitter::updatePaintNode(QSGNode *oldNode, QQuickItem::Upd
 {
     Q_UNUSED(oldData)
 
+    W_D(WRenderBufferBlitter);
     auto node = static_cast<WRenderBufferNode*>(oldNode);
     if (Q_LIKELY(node)) {
         node->resize(size());
+        node->setBlur(d->blur);
+        node->setExactSize(d->textureExported);
         return node;
     }
 
-    W_D(WRenderBufferBlitter);
     if (window()->graphicsApi() == QSGRendererInterface::Software) {
         node = WRenderBufferNode::createSoftwareNode(this);
     } else {
@@ -242,6 +305,8 @@ QSGNode *WRenderBufferBlitter::updatePaintNode(QSGNode *oldNode, QQuickItem::Upd
     node->setContentItem(d->container);
     node->setTextureChangedCallback(onTextureChanged, d);
     node->resize(size());
+    node->setBlur(d->blur);
+    node->setExactSize(d->textureExported);
     onTextureChanged(node, d);
 
     return node;
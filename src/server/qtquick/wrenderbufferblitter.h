@@ -6,6 +6,7 @@
 #include <wglobal.h>
 #include <WOutput>
 #include <QQuickItem>
+#include <QColor>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
@@ -17,6 +18,9 @@ class Q_DECL_EXPORT WRenderBufferBlitter : public QQuickItem, public WObject
     Q_PRIVATE_PROPERTY(WRenderBufferBlitter::d_func(), QQmlListProperty<QObject> data READ data DESIGNABLE false)
     Q_PROPERTY(QQuickItem* content READ content CONSTANT)
     Q_PROPERTY(bool offscreen READ offscreen WRITE setOffscreen NOTIFY offscreenChanged FINAL)
+    Q_PROPERTY(qreal blurRadius READ blurRadius WRITE setBlurRadius NOTIFY blurRadiusChanged FINAL)
+    Q_PROPERTY(qreal blurNoise READ blurNoise WRITE setBlurNoise NOTIFY blurNoiseChanged FINAL)
+    Q_PROPERTY(QColor blurTint READ blurTint WRITE setBlurTint NOTIFY blurTintChanged FINAL)
     QML_NAMED_ELEMENT(RenderBufferBlitter)
 
 public:
@@ -28,8 +32,21 @@ public:
     bool offscreen() const;
     void setOffscreen(bool newOffscreen);
 
+    // The blur is ignored if waylib is built with DISABLE_BLUR
+    qreal blurRadius() const;
+    void setBlurRadius(qreal newBlurRadius);
+
+    qreal blurNoise() const;
+    void setBlurNoise(qreal newBlurNoise);
+
+    QColor blurTint() const;
+    void setBlurTint(const QColor &newBlurTint);
+
 Q_SIGNALS:
     void offscreenChanged();
+    void blurRadiusChanged();
+    void blurNoiseChanged();
+    void blurTintChanged();
 
 private Q_SLOTS:
     void invalidateSceneGraph();
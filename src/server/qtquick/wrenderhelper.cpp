@@ -24,6 +24,7 @@
 #include <private/qrhi_p.h>
 #include <private/qsgplaintexture_p.h>
 #include <private/qsgadaptationlayer_p.h>
+#include <private/qsgdefaultrendercontext_p.h>
 #include <private/qsgsoftwarepixmaptexture_p.h>
 
 extern "C" {
@@ -41,6 +42,46 @@ extern "C" {
 QW_USE_NAMESPACE
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
+struct DepthStencilKey
+{
+    QRhi *rhi = nullptr;
+    QSize pixelSize;
+    int sampleCount = 1;
+
+    bool operator==(const DepthStencilKey &other) const = default;
+};
+
+inline size_t qHash(const DepthStencilKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.rhi, key.pixelSize.width(), key.pixelSize.height(), key.sampleCount);
+}
+
+// The depth-stencil buffer is only used during the rendering of a frame and its
+// contents isn't preserved, so the render targets of the same size can share it,
+// even if they are belong to the different outputs.
+static std::shared_ptr<QRhiRenderBuffer> acquireDepthStencil(QRhi *rhi, const QSize &pixelSize, int sampleCount)
+{
+    static QHash<DepthStencilKey, std::weak_ptr<QRhiRenderBuffer>> depthStencils;
+
+    const DepthStencilKey key { rhi, pixelSize, sampleCount };
+    if (auto depthStencil = depthStencils.value(key).lock())
+        return depthStencil;
+
+    depthStencils.removeIf([] (const auto &it) {
+        return it.value().expired();
+    });
+
+    std::shared_ptr<QRhiRenderBuffer> depthStencil(rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil,
+                                                                        pixelSize, sampleCount));
+    if (!depthStencil->create()) {
+        qWarning("Failed to build depth-stencil buffer for QQuickRenderTarget");
+        return nullptr;
+    }
+
+    depthStencils.insert(key, depthStencil);
+    return depthStencil;
+}
+
 struct Q_DECL_HIDDEN BufferData {
     BufferData() {
 
@@ -55,6 +96,8 @@ struct Q_DECL_HIDDEN BufferData {
     WImageRenderTarget paintDevice;
     QQuickRenderTarget renderTarget;
     QQuickWindowRenderTarget windowRenderTarget;
+    // Not owned by the windowRenderTarget, see acquireDepthStencil
+    std::shared_ptr<QRhiRenderBuffer> depthStencil;
 
     inline void resetWindowRenderTarget() {
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
@@ -96,24 +139,20 @@ struct Q_DECL_HIDDEN BufferData {
         windowRenderTarget.paintDevice = nullptr;
         windowRenderTarget.owns = false;
 #endif
+        // Must be released after the render target
+        depthStencil.reset();
     }
 };
 
-// Copy from qquickrendertarget.cpp
+// Copy from qquickrendertarget.cpp, but the depth-stencil buffer is
+// from the caller and may be null.
 static bool createRhiRenderTarget(const QRhiColorAttachment &colorAttachment,
-                                  const QSize &pixelSize,
-                                  int sampleCount,
+                                  QRhiRenderBuffer *depthStencil,
                                   QRhi *rhi,
                                   QQuickWindowRenderTarget &dst)
 {
-    std::unique_ptr<QRhiRenderBuffer> depthStencil(rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, pixelSize, sampleCount));
-    if (!depthStencil->create()) {
-        qWarning("Failed to build depth-stencil buffer for QQuickRenderTarget");
-        return false;
-    }
-
     QRhiTextureRenderTargetDescription rtDesc(colorAttachment);
-    rtDesc.setDepthStencilBuffer(depthStencil.get());
+    rtDesc.setDepthStencilBuffer(depthStencil);
     std::unique_ptr<QRhiTextureRenderTarget> rt(rhi->newTextureRenderTarget(rtDesc));
     std::unique_ptr<QRhiRenderPassDescriptor> rp(rt->newCompatibleRenderPassDescriptor());
     rt->setRenderPassDescriptor(rp.get());
@@ -126,21 +165,28 @@ static bool createRhiRenderTarget(const QRhiColorAttachment &colorAttachment,
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
     dst.rt.renderTarget = rt.release();
     dst.res.rpDesc = rp.release();
-    dst.implicitBuffers.depthStencil = depthStencil.release();
     dst.rt.owns = true; // ownership of the native resource itself is not transferred but the QRhi objects are on us now
 #else
     dst.renderTarget = rt.release();
     dst.rpDesc = rp.release();
-    dst.depthStencil = depthStencil.release();
     dst.owns = true; // ownership of the native resource itself is not transferred but the QRhi objects are on us now
 #endif
     return true;
 }
 
-bool createRhiRenderTarget(QRhi *rhi, const QQuickRenderTarget &source, QQuickWindowRenderTarget &dst)
+static bool createRhiRenderTarget(QRhi *rhi, const QQuickRenderTarget &source, bool withDepthStencil,
+                                  QQuickWindowRenderTarget &dst, std::shared_ptr<QRhiRenderBuffer> &depthStencil)
 {
     auto rtd = QQuickRenderTargetPrivate::get(&source);
 
+    if (withDepthStencil) {
+        depthStencil = acquireDepthStencil(rhi, rtd->pixelSize, rtd->sampleCount);
+        if (!depthStencil)
+            return false;
+    } else {
+        depthStencil.reset();
+    }
+
     switch (rtd->type) {
     case QQuickRenderTargetPrivate::Type::NativeTexture: {
         const auto format = rtd->u.nativeTexture.rhiFormat == QRhiTexture::UnknownFormat ? QRhiTexture::RGBA8
@@ -160,7 +206,7 @@ bool createRhiRenderTarget(QRhi *rhi, const QQuickRenderTarget &source, QQuickWi
 #endif
             return false;
         QRhiColorAttachment att(texture.get());
-        if (!createRhiRenderTarget(att, rtd->pixelSize, rtd->sampleCount, rhi, dst))
+        if (!createRhiRenderTarget(att, depthStencil.get(), rhi, dst))
             return false;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
         dst.res.texture = texture.release();
@@ -176,7 +222,7 @@ bool createRhiRenderTarget(QRhi *rhi, const QQuickRenderTarget &source, QQuickWi
             return false;
         }
         QRhiColorAttachment att(renderbuffer.get());
-        if (!createRhiRenderTarget(att, rtd->pixelSize, rtd->sampleCount, rhi, dst))
+        if (!createRhiRenderTarget(att, depthStencil.get(), rhi, dst))
             return false;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
         dst.res.renderBuffer = renderbuffer.release();
@@ -207,14 +253,15 @@ public:
 
     void resetRenderBuffer();
     void onBufferDestroy();
-    static bool ensureRhiRenderTarget(QQuickRenderControl *rc, BufferData *data);
+    bool ensureRhiRenderTarget(QQuickRenderControl *rc, BufferData *data) const;
 
     W_DECLARE_PUBLIC(WRenderHelper)
     qw_renderer *renderer;
-    QList<BufferData*> buffers;
+    QHash<qw_buffer*, BufferData*> buffers;
     BufferData *lastBuffer = nullptr;
 
     QSize size;
+    bool depthStencilEnabled = !qEnvironmentVariableIsSet("WAYLIB_NO_DEPTH_STENCIL");
 };
 
 void WRenderHelperPrivate::resetRenderBuffer()
@@ -228,18 +275,15 @@ void WRenderHelperPrivate::onBufferDestroy()
 {
     qw_buffer *buffer = qobject_cast<qw_buffer*>(q_func()->sender());
 
-    for (int i = 0; i < buffers.count(); ++i) {
-        auto data = buffers[i];
-        if (data->buffer == buffer) {
-            if (lastBuffer == data)
-                lastBuffer = nullptr;
-            buffers.removeAt(i);
-            break;
-        }
-    }
+    auto data = buffers.take(buffer);
+    if (!data)
+        return;
+    if (lastBuffer == data)
+        lastBuffer = nullptr;
+    delete data;
 }
 
-bool WRenderHelperPrivate::ensureRhiRenderTarget(QQuickRenderControl *rc, BufferData *data)
+bool WRenderHelperPrivate::ensureRhiRenderTarget(QQuickRenderControl *rc, BufferData *data) const
 {
     data->resetWindowRenderTarget();
 #if QT_VERSION < QT_VERSION_CHECK(6, 6, 0)
@@ -248,7 +292,14 @@ bool WRenderHelperPrivate::ensureRhiRenderTarget(QQuickRenderControl *rc, Buffer
     auto rhi = rc->rhi();
 #endif
     auto tmp = data->renderTarget;
-    bool ok = createRhiRenderTarget(rhi, tmp, data->windowRenderTarget);
+    // Without the depth buffer the renderer of the window must not use depth test,
+    // and the scene must not need the stencil clip (the clip of a rotated item).
+    bool withDepthStencil = depthStencilEnabled;
+    if (!withDepthStencil) {
+        auto context = qobject_cast<QSGDefaultRenderContext*>(QQuickWindowPrivate::get(rc->window())->context);
+        withDepthStencil = !context || context->useDepthBufferFor2D();
+    }
+    bool ok = createRhiRenderTarget(rhi, tmp, withDepthStencil, data->windowRenderTarget, data->depthStencil);
     if (!ok)
         return false;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
@@ -286,6 +337,23 @@ void WRenderHelper::setSize(const QSize &size)
     Q_EMIT sizeChanged();
 }
 
+bool WRenderHelper::depthStencilEnabled() const
+{
+    W_DC(WRenderHelper);
+    return d->depthStencilEnabled;
+}
+
+void WRenderHelper::setDepthStencilEnabled(bool newDepthStencilEnabled)
+{
+    W_D(WRenderHelper);
+    if (d->depthStencilEnabled == newDepthStencilEnabled)
+        return;
+    d->depthStencilEnabled = newDepthStencilEnabled;
+    d->resetRenderBuffer();
+
+    Q_EMIT depthStencilEnabledChanged();
+}
+
 QSGRendererInterface::GraphicsApi WRenderHelper::getGraphicsApi(QQuickRenderControl *rc)
 {
     auto d = QQuickRenderControlPrivate::get(rc);
@@ -510,12 +578,9 @@ QQuickRenderTarget WRenderHelper::acquireRenderTarget(QQuickRenderControl *rc, q
     if (d->size.isEmpty())
         return {};
 
-    for (int i = 0; i < d->buffers.count(); ++i) {
-        auto data = d->buffers[i];
-        if (data->buffer == buffer) {
-            d->lastBuffer = data;
-            return data->renderTarget;
-        }
+    if (auto data = d->buffers.value(buffer)) {
+        d->lastBuffer = data;
+        return data->renderTarget;
     }
 
     std::unique_ptr<BufferData> bufferData(new BufferData);
@@ -564,10 +629,10 @@ QQuickRenderTarget WRenderHelper::acquireRenderTarget(QQuickRenderControl *rc, q
     connect(buffer, SIGNAL(before_destroy()),
             this, SLOT(onBufferDestroy()), Qt::UniqueConnection);
 
-    d->buffers.append(bufferData.release());
-    d->lastBuffer = d->buffers.last();
+    d->lastBuffer = bufferData.release();
+    d->buffers.insert(buffer, d->lastBuffer);
 
-    return d->buffers.last()->renderTarget;
+    return d->lastBuffer->renderTarget;
 }
 
 std::pair<qw_buffer *, QQuickRenderTarget> WRenderHelper::lastRenderTarget() const
@@ -809,6 +874,30 @@ bool WRenderHelper::makeTexture(QRhi *rhi, qw_texture *handle, QSGPlainTexture *
     return true;
 }
 
+quint64 WRenderHelper::nativeTextureOf(qw_texture *handle)
+{
+    auto texture = handle->handle();
+    if (wlr_texture_is_gles2(texture)) {
+        wlr_gles2_texture_attribs attribs;
+        wlr_gles2_texture_get_attribs(texture, &attribs);
+        return attribs.tex;
+    }
+#ifdef ENABLE_VULKAN_RENDER
+    if (wlr_texture_is_vk(texture)) {
+        wlr_vk_image_attribs attribs;
+        wlr_vk_texture_get_image_attribs(texture, &attribs);
+        return vkimage_cast(attribs.image);
+    }
+#endif
+    if (wlr_texture_is_pixman(texture)) {
+        // The pixman texture of a shm buffer uses the memory of the buffer
+        auto image = wlr_pixman_texture_get_image(texture);
+        return reinterpret_cast<quintptr>(pixman_image_get_data(image));
+    }
+
+    return 0;
+}
+
 WAYLIB_SERVER_END_NAMESPACE
 
 #include "moc_wrenderhelper.cpp"
@@ -31,6 +31,10 @@ class WAYLIB_SERVER_EXPORT WRenderHelper : public QObject, public WObject
 {
     Q_OBJECT
     Q_PROPERTY(QSize size READ size WRITE setSize NOTIFY sizeChanged FINAL)
+    // The render targets of the RHI renderers share a depth-stencil buffer per size,
+    // set it to false (or set WAYLIB_NO_DEPTH_STENCIL) if the scene has no stencil
+    // clip, it only takes effect if the depth buffer isn't used by the renderer.
+    Q_PROPERTY(bool depthStencilEnabled READ depthStencilEnabled WRITE setDepthStencilEnabled NOTIFY depthStencilEnabledChanged FINAL)
     W_DECLARE_PRIVATE(WRenderHelper)
 
 public:
@@ -39,6 +43,9 @@ public:
     QSize size() const;
     void setSize(const QSize &size);
 
+    bool depthStencilEnabled() const;
+    void setDepthStencilEnabled(bool newDepthStencilEnabled);
+
     static QSGRendererInterface::GraphicsApi getGraphicsApi(QQuickRenderControl *rc);
     static QSGRendererInterface::GraphicsApi getGraphicsApi();
 
@@ -53,9 +60,13 @@ public:
     static QSGRendererInterface::GraphicsApi probe(QW_NAMESPACE::qw_backend *testBackend, const QList<QSGRendererInterface::GraphicsApi> &apiList);
 
     static bool makeTexture(QRhi *rhi, QW_NAMESPACE::qw_texture *handle, QSGPlainTexture *texture);
+    // The GL texture, the VkImage or the pixels of the pixman image, wlroots may
+    // create a new texture for the same native texture, e.g. for a client buffer.
+    static quint64 nativeTextureOf(QW_NAMESPACE::qw_texture *handle);
 
 Q_SIGNALS:
     void sizeChanged();
+    void depthStencilEnabledChanged();
 
 private:
     W_PRIVATE_SLOT(void onBufferDestroy())
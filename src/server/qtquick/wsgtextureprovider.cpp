@@ -13,6 +13,9 @@
 #include <rhi/qrhi.h>
 #include <private/qsgplaintexture_p.h>
 
+#include <algorithm>
+#include <limits>
+
 WAYLIB_SERVER_BEGIN_NAMESPACE
 
 #ifdef QT_DEBUG
@@ -21,6 +24,33 @@ Q_LOGGING_CATEGORY(lcQtQuickTexture, "waylib.qtquick.texture", QtDebugMsg);
 Q_LOGGING_CATEGORY(lcQtQuickTexture, "waylib.qtquick.texture", QtInfoMsg);
 #endif
 
+// Most of clients only use two or three buffers in turn, keep the textures
+// of the recently used buffers to avoid wrap them again on every commit.
+// wlroots creates a new wlr_client_buffer for each commit of a non-shm
+// buffer, so the textures of the client buffers are keyed by their source
+// buffers, the wl_buffer of the client, and reused only if the native
+// texture isn't changed. The textures created by setBuffer from the other
+// buffers lock them and aren't cached, the buffers must be released when the
+// provider doesn't show them any more. The owner of such buffers can create
+// the textures itself and cache them by setTexture, e.g. the cursor.
+static constexpr int DefaultTextureCacheSize = 4;
+
+struct TextureData
+{
+    qw_texture *texture = nullptr;
+    bool ownsTexture = false;
+    QSGPlainTexture *qtTexture = nullptr;
+    QRhiTexture *rhiTexture = nullptr;
+
+    // for the cached texture, the texture maybe destroyed while it's not
+    // shown, e.g. with its client buffer, only use the native texture
+    bool cached = false;
+    quint64 nativeTexture = 0;
+    QSize size;
+    quint64 lastUsed = 0;
+    QMetaObject::Connection bufferDestroyConnection;
+};
+
 class Q_DECL_HIDDEN WSGTextureProviderPrivate : public WObjectPrivate
 {
 public:
@@ -28,11 +58,7 @@ public:
         : WObjectPrivate(qq)
         , window(window)
     {
-        qtTexture.setOwnsTexture(false);
-        qtTexture.setFiltering(smooth ? QSGTexture::Linear
-                                      : QSGTexture::Nearest);
-        qtTexture.setMipmapFiltering(smooth ? QSGTexture::Linear
-                                            : QSGTexture::Nearest);
+
     }
 
     ~WSGTextureProviderPrivate() {
@@ -40,55 +66,181 @@ public:
     }
 
     void cleanTexture() {
-        if (rhiTexture) {
-            Q_ASSERT(window);
+        detachTexture();
+        for (auto data : std::as_const(textureCache)) {
+            QObject::disconnect(data->bufferDestroyConnection);
+            releaseTexture(data);
+        }
+        textureCache.clear();
+    }
+
+    void releaseTexture(TextureData *data) {
+        if (window) {
             class TextureCleanupJob : public QRunnable
             {
             public:
-                TextureCleanupJob(QRhiTexture *texture)
-                    : texture(texture) { }
+                TextureCleanupJob(QRhiTexture *texture, QSGPlainTexture *qtTexture)
+                    : texture(texture), qtTexture(qtTexture) { }
                 void run() override {
-                    texture->deleteLater();
+                    if (texture)
+                        texture->deleteLater();
+                    delete qtTexture;
                 }
                 QRhiTexture *texture;
+                QSGPlainTexture *qtTexture;
             };
 
-            // Delay clean the qt rhi textures.
-            window->scheduleRenderJob(new TextureCleanupJob(rhiTexture),
+            // Delay clean the qt textures, they maybe still used by the scene
+            // graph nodes until the next synchronization.
+            window->scheduleRenderJob(new TextureCleanupJob(data->rhiTexture, data->qtTexture),
                                       QQuickWindow::AfterSynchronizingStage);
-            rhiTexture = nullptr;
+        } else {
+            if (data->rhiTexture)
+                data->rhiTexture->deleteLater();
+            delete data->qtTexture;
+        }
+
+        if (data->ownsTexture && data->texture)
+            delete data->texture;
+        delete data;
+    }
+
+    void detachTexture() {
+        if (current && !current->cached)
+            releaseTexture(current);
+        current = nullptr;
+    }
+
+    // The client buffer is replaced on each commit, but the source buffer
+    // is kept until the client destroys the wl_buffer.
+    static qw_buffer *cacheKeyOf(qw_buffer *buffer) {
+        if (auto clientBuffer = qw_client_buffer::get(*buffer)) {
+            auto source = clientBuffer->handle()->source;
+            return source ? qw_buffer::from(source) : nullptr;
         }
 
-        if (ownsTexture && texture)
-            delete texture;
-        texture = nullptr;
+        return buffer;
     }
 
-    void updateRhiTexture() {
+    TextureData *createTexture(qw_texture *texture, bool ownsTexture) {
         Q_ASSERT(texture);
-        bool ok = WRenderHelper::makeTexture(window->rhi(), texture, &qtTexture);
+        auto data = new TextureData;
+        data->texture = texture;
+        data->ownsTexture = ownsTexture;
+        data->qtTexture = new QSGPlainTexture();
+        data->qtTexture->setOwnsTexture(false);
+        updateFiltering(data->qtTexture);
+
+        bool ok = WRenderHelper::makeTexture(window->rhi(), texture, data->qtTexture);
         if (Q_UNLIKELY(!ok)) {
             qCWarning(lcQtQuickTexture) << "Failed to make texture:" << texture
                                         << ", width height:" << texture->handle()->width
                                         << texture->handle()->height;
-            return;
+        } else {
+            data->rhiTexture = data->qtTexture->rhiTexture();
+        }
+
+        return data;
+    }
+
+    void updateFiltering(QSGPlainTexture *texture) const {
+        texture->setFiltering(smooth ? QSGTexture::Linear
+                                     : QSGTexture::Nearest);
+        texture->setMipmapFiltering(smooth ? QSGTexture::Linear
+                                           : QSGTexture::Nearest);
+    }
+
+    // The cached texture is reused for the texture of the buffer only if
+    // they have the same native texture.
+    TextureData *findCachedTexture(qw_buffer *key, qw_texture *texture) {
+        auto data = textureCache.value(key);
+        if (data && (data->nativeTexture != WRenderHelper::nativeTextureOf(texture)
+                     || data->size != QSize(texture->handle()->width, texture->handle()->height))) {
+            // The buffer is using a new texture
+            removeCachedTexture(key);
+            data = nullptr;
+        }
+
+        if (!data) {
+            ++cacheMisses;
+            return nullptr;
+        }
+
+        ++cacheHits;
+        data->texture = texture;
+        data->lastUsed = ++usageCounter;
+        return data;
+    }
+
+    void addCachedTexture(qw_buffer *key, TextureData *data) {
+        Q_ASSERT(!textureCache.contains(key));
+
+        if (textureCache.size() >= textureCacheSize)
+            removeLeastRecentlyUsed(textureCache.size() - textureCacheSize + 1);
+
+        data->cached = true;
+        data->nativeTexture = WRenderHelper::nativeTextureOf(data->texture);
+        data->size = QSize(data->texture->handle()->width, data->texture->handle()->height);
+        data->lastUsed = ++usageCounter;
+        data->bufferDestroyConnection = QObject::connect(key, &qw_buffer::before_destroy,
+                                                         q_func(), [this, key] {
+            onBufferDestroy(key);
+        });
+        textureCache.insert(key, data);
+    }
+
+    void removeLeastRecentlyUsed(int count) {
+        while (count-- > 0) {
+            qw_buffer *lru = nullptr;
+            quint64 lastUsed = std::numeric_limits<quint64>::max();
+            for (auto it = textureCache.constBegin(); it != textureCache.constEnd(); ++it) {
+                if (it.value() != current && it.value()->lastUsed < lastUsed) {
+                    lru = it.key();
+                    lastUsed = it.value()->lastUsed;
+                }
+            }
+            if (!lru)
+                break;
+            removeCachedTexture(lru);
         }
+    }
 
-        rhiTexture = qtTexture.rhiTexture();
+    void removeCachedTexture(qw_buffer *key) {
+        auto data = textureCache.take(key);
+        if (!data)
+            return;
+
+        QObject::disconnect(data->bufferDestroyConnection);
+        // It's released when it's detached
+        if (data == current)
+            data->cached = false;
+        else
+            releaseTexture(data);
+    }
+
+    // The client may destroy the wl_buffer after it's committed, the
+    // texture of the client buffer is still shown until it's replaced.
+    void onBufferDestroy(qw_buffer *key) {
+        const bool isCurrent = current && textureCache.value(key) == current;
+        removeCachedTexture(key);
+        if (isCurrent && buffer == key) {
+            buffer = nullptr;
+            detachTexture();
+            Q_EMIT q_func()->textureChanged();
+        }
     }
 
     W_DECLARE_PUBLIC(WSGTextureProvider)
 
     QPointer<WOutputRenderWindow> window;
 
-    // wlroots resources
-    qw_texture *texture = nullptr;
-    bool ownsTexture = false;
     qw_buffer *buffer = nullptr;
-
-    // qt resources
-    QSGPlainTexture qtTexture;
-    QRhiTexture *rhiTexture = nullptr;
+    TextureData *current = nullptr;
+    QHash<qw_buffer*, TextureData*> textureCache;
+    int textureCacheSize = DefaultTextureCacheSize;
+    quint64 usageCounter = 0;
+    quint64 cacheHits = 0;
+    quint64 cacheMisses = 0;
     bool smooth = true;
 };
 
@@ -106,35 +258,51 @@ WOutputRenderWindow *WSGTextureProvider::window() const
 
 void WSGTextureProvider::setBuffer(qw_buffer *buffer)
 {
+    W_D(WSGTextureProvider);
+
     if (buffer && buffer == qwBuffer()) {
+        ++d->cacheHits;
         Q_EMIT textureChanged();
         return;
     }
 
-    W_D(WSGTextureProvider);
-    d->cleanTexture();
+    d->detachTexture();
     d->buffer = buffer;
 
     if (buffer) {
         Q_ASSERT(d->window);
+        qw_texture *texture = nullptr;
+        // The texture created from the buffer keeps a lock of the buffer
+        bool ownsTexture = false;
         if (auto clientBuffer = qw_client_buffer::get(*buffer)) {
             // Acquire texture from client buffer. wlroots already generate texture for us if this is a client buffer.
             // By the way, there is something wrong with getting texture from a client buffer using wlr_texture_from_buffer,
             // See: https://gitlab.freedesktop.org/wlroots/wlroots/-/issues/3897
             // Possible patch:  https://gitlab.freedesktop.org/wlroots/wlroots/-/merge_requests/4889
-            d->texture = qw_texture::from(clientBuffer->handle()->texture);
-            d->ownsTexture = false;
+            texture = qw_texture::from(clientBuffer->handle()->texture);
         } else {
-            d->texture = qw_texture::from_buffer(*d->window->renderer(), *buffer);
-            d->ownsTexture = true;
+            texture = qw_texture::from_buffer(*d->window->renderer(), *buffer);
+            ownsTexture = true;
         }
-        if (Q_UNLIKELY(!d->texture)) {
+        if (Q_UNLIKELY(!texture)) {
             qCWarning(lcQtQuickTexture) << "Failed to update texture from buffer:" << buffer
                                         << ", width height:" << buffer->handle()->width
                                         << buffer->handle()->height
                                         << ", n_locks:" << buffer->handle()->n_locks;
+        } else if (ownsTexture) {
+            // Don't cache the texture locking the buffer, the owner of the
+            // buffer can't get it back until the texture is evicted, e.g. the
+            // swapchain would run out of the buffers.
+            d->current = d->createTexture(texture, ownsTexture);
         } else {
-            d->updateRhiTexture();
+            auto key = d->cacheKeyOf(buffer);
+            if (key)
+                d->current = d->findCachedTexture(key, texture);
+            if (!d->current) {
+                d->current = d->createTexture(texture, ownsTexture);
+                if (key)
+                    d->addCachedTexture(key, d->current);
+            }
         }
     }
 
@@ -144,12 +312,21 @@ void WSGTextureProvider::setBuffer(qw_buffer *buffer)
 void WSGTextureProvider::setTexture(qw_texture *texture, qw_buffer *srcBuffer)
 {
     W_D(WSGTextureProvider);
-    d->cleanTexture();
-    d->texture = texture;
+    d->detachTexture();
     d->buffer = srcBuffer;
-    d->ownsTexture = false;
-    if (texture)
-        d->updateRhiTexture();
+
+    if (texture) {
+        // Can't know when the texture is destroyed without the buffer
+        auto key = srcBuffer ? d->cacheKeyOf(srcBuffer) : nullptr;
+        if (key)
+            d->current = d->findCachedTexture(key, texture);
+
+        if (!d->current) {
+            d->current = d->createTexture(texture, false);
+            if (key)
+                d->addCachedTexture(key, d->current);
+        }
+    }
 
     Q_EMIT textureChanged();
 }
@@ -166,13 +343,13 @@ void WSGTextureProvider::invalidate()
 QSGTexture *WSGTextureProvider::texture() const
 {
     W_DC(WSGTextureProvider);
-    return d->texture ? const_cast<QSGPlainTexture*>(&d->qtTexture) : nullptr;
+    return d->current ? d->current->qtTexture : nullptr;
 }
 
 qw_texture *WSGTextureProvider::qwTexture() const
 {
     W_DC(WSGTextureProvider);
-    return d->texture;
+    return d->current ? d->current->texture : nullptr;
 }
 
 qw_buffer *WSGTextureProvider::qwBuffer() const
@@ -193,12 +370,38 @@ void WSGTextureProvider::setSmooth(bool newSmooth)
     if (d->smooth == newSmooth)
         return;
     d->smooth = newSmooth;
-    d->qtTexture.setFiltering(newSmooth ? QSGTexture::Linear
-                                        : QSGTexture::Nearest);
-    d->qtTexture.setMipmapFiltering(newSmooth ? QSGTexture::Linear
-                                              : QSGTexture::Nearest);
+    for (auto data : std::as_const(d->textureCache))
+        d->updateFiltering(data->qtTexture);
+    if (d->current && !d->current->cached)
+        d->updateFiltering(d->current->qtTexture);
 
     Q_EMIT smoothChanged();
 }
 
+int WSGTextureProvider::textureCacheSize() const
+{
+    W_DC(WSGTextureProvider);
+    return d->textureCacheSize;
+}
+
+void WSGTextureProvider::setTextureCacheSize(int size)
+{
+    W_D(WSGTextureProvider);
+    d->textureCacheSize = std::max(size, 1);
+    if (d->textureCache.size() > d->textureCacheSize)
+        d->removeLeastRecentlyUsed(d->textureCache.size() - d->textureCacheSize);
+}
+
+quint64 WSGTextureProvider::textureCacheHits() const
+{
+    W_DC(WSGTextureProvider);
+    return d->cacheHits;
+}
+
+quint64 WSGTextureProvider::textureCacheMisses() const
+{
+    W_DC(WSGTextureProvider);
+    return d->cacheMisses;
+}
+
 WAYLIB_SERVER_END_NAMESPACE
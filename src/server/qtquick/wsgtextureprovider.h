@@ -38,6 +38,14 @@ public:
     bool smooth() const;
     void setSmooth(bool newSmooth);
 
+    // The count of the recently used buffers whose textures are kept
+    int textureCacheSize() const;
+    void setTextureCacheSize(int size);
+
+    // Count of setBuffer/setTexture reusing or creating the texture of a buffer
+    quint64 textureCacheHits() const;
+    quint64 textureCacheMisses() const;
+
 Q_SIGNALS:
     void smoothChanged();
 };
@@ -10,6 +10,7 @@
 #include "woutputviewport.h"
 #include "wsgtextureprovider.h"
 #include "woutputrenderwindow.h"
+#include "wsgdamagetracker_p.h"
 
 #include <qwcompositor.h>
 #include <qwsubcompositor.h>
@@ -19,8 +20,10 @@
 #include <qwbox.h>
 
 #include <QQuickWindow>
+#include <QTimer>
 #include <QSGImageNode>
 #include <QSGRenderNode>
+#include <QtMath>
 #include <private/qquickitem_p.h>
 
 QW_USE_NAMESPACE
@@ -181,6 +184,8 @@ public:
             cleanTextureProvider();
             q->update();
         }
+
+        fullBufferDamage = true;
     }
 
     void init() {
@@ -195,6 +200,9 @@ public:
 
         Q_ASSERT(!updateTextureConnection);
         updateTextureConnection = surface->safeConnect(&WSurface::bufferChanged, q, [q, this] {
+            // Accumulate until the texture is updated in updatePaintNode
+            bufferDamage += surface->bufferDamage();
+
             if (!live) {
                 pendingBuffer.reset(surface->buffer());
                 if (pendingBuffer)
@@ -204,13 +212,18 @@ public:
                 // lock buffer to ensure the WSurfaceItem can keep the last frame after WSurface destroyed.
                 if (buffer)
                     buffer->lock();
-                q->update();
+                // Nothing to show, repaint after it's uncovered
+                if (occluded)
+                    updateDeferred = true;
+                else
+                    q->update();
             }
         });
 
         updateFrameDoneConnection();
         updateSurfaceState();
         rendered = true;
+        fullBufferDamage = true;
     }
 
     void updateFrameDoneConnection() {
@@ -223,6 +236,13 @@ public:
 
         // wayland protocol job should not run in rendering thread, so set context qobject to contentItem
         frameDoneConnection = QObject::connect(q->window(), &QQuickWindow::afterRendering, q, [this, q](){
+            // The occluded surface is still painted under the others, but
+            // it's invisible, only the keepalive timer sends the frame done.
+            if (occluded) {
+                rendered = false;
+                return;
+            }
+
             if ((rendered || q->isVisible()) && live) {
                 surface->notifyFrameDone();
                 rendered = false;
@@ -255,6 +275,33 @@ public:
         q->setImplicitSize(s.width(), s.height());
     }
 
+    // Map the damage of the buffer to this item's coordinate system in the
+    // same way as the QSGImageNode maps the texture, return false if the
+    // whole texture is damaged.
+    bool takeBufferDamage(const QRectF &targetGeometry, QRegion *damage) {
+        const QRectF &source = bufferSourceBox;
+        if (std::exchange(fullBufferDamage, false) || source.isEmpty() || targetGeometry.isEmpty()) {
+            bufferDamage = QRegion();
+            return false;
+        }
+
+        const qreal sx = targetGeometry.width() / source.width();
+        const qreal sy = targetGeometry.height() / source.height();
+        // The linear filtering maybe samples the neighboring texels
+        const int margin = qCeil(qMax(sx, sy));
+        QRegion region;
+        for (const QRect &rect : std::as_const(bufferDamage)) {
+            const QRectF r((rect.x() - source.x()) * sx + targetGeometry.x(),
+                           (rect.y() - source.y()) * sy + targetGeometry.y(),
+                           rect.width() * sx, rect.height() * sy);
+            region += r.toAlignedRect().adjusted(-margin, -margin, margin, margin);
+        }
+        bufferDamage = QRegion();
+
+        *damage = region & targetGeometry.toAlignedRect();
+        return true;
+    }
+
     inline void swapBufferIfNeeded() {
         if (pendingBuffer) {
             buffer.reset(pendingBuffer.release());
@@ -284,6 +331,16 @@ public:
     bool live = true;
     bool ignoreBufferOffset = false;
     QAtomicInteger<bool> rendered = false;
+    // The damage of the buffers in buffer coordinates since the last
+    // texture update, the whole texture is changed if fullBufferDamage.
+    QRegion bufferDamage;
+    bool fullBufferDamage = true;
+
+    bool occluded = false;
+    // The buffer is changed while it's occluded
+    bool updateDeferred = false;
+    // Send the frame done at a low rate while it's occluded
+    QTimer *occludedFrameTimer = nullptr;
 };
 
 
@@ -460,6 +517,38 @@ qreal WSurfaceItemContent::devicePixelRatio() const
     return d->devicePixelRatio;
 }
 
+bool WSurfaceItemContent::isOccluded() const
+{
+    W_DC(WSurfaceItemContent);
+    return d->occluded;
+}
+
+void WSurfaceItemContent::setOccluded(bool occluded, int frameCallbackInterval)
+{
+    W_D(WSurfaceItemContent);
+    if (d->occluded == occluded)
+        return;
+    d->occluded = occluded;
+
+    if (occluded && frameCallbackInterval > 0) {
+        if (!d->occludedFrameTimer) {
+            d->occludedFrameTimer = new QTimer(this);
+            connect(d->occludedFrameTimer, &QTimer::timeout, this, [d] {
+                if (d->surface && d->live)
+                    d->surface->notifyFrameDone();
+            });
+        }
+        d->occludedFrameTimer->start(frameCallbackInterval);
+    } else if (d->occludedFrameTimer) {
+        d->occludedFrameTimer->stop();
+    }
+
+    if (!occluded && std::exchange(d->updateDeferred, false))
+        update();
+
+    Q_EMIT occludedChanged();
+}
+
 void WSurfaceItemContent::componentComplete()
 {
     QQuickItem::componentComplete();
@@ -487,6 +576,18 @@ public:
             m_owner->d_func()->rendered = true;
     }
 
+    // Nothing is painted, but keep the rect same as the image node,
+    // so it's rendered when the surface is repainted.
+    RenderingFlags flags() const override
+    {
+        return BoundedRectRendering;
+    }
+
+    QRectF rect() const override
+    {
+        return static_cast<const QSGImageNode*>(parent())->rect();
+    }
+
     QPointer<WSurfaceItemContent> m_owner;
 };
 
@@ -495,6 +596,7 @@ QSGNode *WSurfaceItemContent::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeD
     W_D(WSurfaceItemContent);
 
     auto tp = wTextureProvider();
+    bool textureUpdated = false;
     if (d->live || !tp->texture()) {
         auto texture = d->surface ? d->surface->handle()->get_texture() : nullptr;
         if (texture) {
@@ -502,6 +604,7 @@ QSGNode *WSurfaceItemContent::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeD
         } else {
             tp->setBuffer(d->buffer.get());
         }
+        textureUpdated = true;
     }
 
     if (!tp->texture() || width() <= 0 || height() <= 0) {
@@ -517,11 +620,20 @@ QSGNode *WSurfaceItemContent::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeD
         node->appendChildNode(fpnode);
     }
 
+    const QRectF targetGeometry(d->ignoreBufferOffset ? QPointF() : d->bufferOffset, size());
+    // Only the damaged area of the client buffer needs to repaint, the node
+    // is damaged entirely if its geometry is also changed.
+    QRegion damage;
+    const bool partialDamage = !textureUpdated || d->takeBufferDamage(targetGeometry, &damage);
+    if (partialDamage)
+        WSGDamageTracker::beginNodeDamageHint(node, damage);
     auto texture = tp->texture();
     node->setTexture(texture);
+    if (partialDamage)
+        WSGDamageTracker::endNodeDamageHint();
+
     const QRectF textureGeometry = d->bufferSourceBox;
     node->setSourceRect(textureGeometry);
-    const QRectF targetGeometry(d->ignoreBufferOffset ? QPointF() : d->bufferOffset, size());
     node->setRect(targetGeometry);
     node->setFiltering(smooth() ? QSGTexture::Linear : QSGTexture::Nearest);
 
@@ -544,6 +656,8 @@ void WSurfaceItemContent::itemChange(ItemChange change, const ItemChangeData &da
     QQuickItem::itemChange(change, data);
     W_D(WSurfaceItemContent);
     if (change == QQuickItem::ItemSceneChange) {
+        // The occlusion is computed by the new window
+        setOccluded(false, 0);
         d->updateFrameDoneConnection();
         d->setDevicePixelRatio(data.window ? data.window->effectiveDevicePixelRatio() : 1.0);
     } else if (change == QQuickItem::ItemDevicePixelRatioHasChanged) {
@@ -33,6 +33,7 @@ class WAYLIB_SERVER_EXPORT WSurfaceItemContent : public QQuickItem, public virtu
     Q_PROPERTY(bool ignoreBufferOffset READ ignoreBufferOffset WRITE setIgnoreBufferOffset NOTIFY ignoreBufferOffsetChanged FINAL)
     Q_PROPERTY(QRectF bufferSourceRect READ bufferSourceRect NOTIFY bufferSourceRectChanged FINAL)
     Q_PROPERTY(qreal devicePixelRatio READ devicePixelRatio NOTIFY devicePixelRatioChanged FINAL)
+    Q_PROPERTY(bool occluded READ isOccluded NOTIFY occludedChanged FINAL)
     QML_NAMED_ELEMENT(SurfaceItemContent)
 
 public:
@@ -61,6 +62,10 @@ public:
     QRectF bufferSourceRect() const;
     qreal devicePixelRatio() const;
 
+    // Fully covered by the opaque surfaces on all outputs, see
+    // WOutputRenderWindow::occlusionCulling
+    bool isOccluded() const;
+
 Q_SIGNALS:
     void surfaceChanged();
     void cacheLastBufferChanged();
@@ -69,12 +74,16 @@ Q_SIGNALS:
     void ignoreBufferOffsetChanged();
     void bufferSourceRectChanged();
     void devicePixelRatioChanged();
+    void occludedChanged();
 
 private:
     friend class WSurfaceItem;
     friend class WSurfaceItemPrivate;
     friend class WSGTextureProvider;
     friend class WSGRenderFootprintNode;
+    friend class WOutputRenderWindowPrivate;
+
+    void setOccluded(bool occluded, int frameCallbackInterval);
 
     void componentComplete() override;
     QSGNode *updatePaintNode(QSGNode *, UpdatePaintNodeData *) override;
@@ -5,12 +5,31 @@
 #include "woutputrenderwindow.h"
 #include "private/wglobal_p.h"
 
+#include <QPointer>
+#include <QPromise>
+#include <QQuickRenderControl>
+#include <QRunnable>
+#include <QThreadPool>
+
 #include <rhi/qrhi.h>
 #include <private/qquickwindow_p.h>
+#include <private/qsgplaintexture_p.h>
+
+#include <memory>
 
 WAYLIB_SERVER_BEGIN_NAMESPACE
 Q_LOGGING_CATEGORY(qLcTextureProvider, "waylib.server.texture.provider")
 
+struct CaptureRequest
+{
+    QPromise<QImage> promise;
+    QRect sourceRect;
+    qreal scale;
+    QImage::Format format;
+};
+
+using CaptureRequests = QList<std::shared_ptr<CaptureRequest>>;
+
 class Q_DECL_HIDDEN WTextureCapturerPrivate : public WObjectPrivate
 {
 public:
@@ -21,14 +40,71 @@ public:
         , renderWindow(p->outputRenderWindow())
     {}
 
-    QPromise<QImage> imgPromise;
+    void scheduleCapture();
+    void doCapture();
+
     WTextureProviderProvider *const provider;
     WOutputRenderWindow *const renderWindow;
+    // Waiting for the next frame of the render window
+    CaptureRequests pendingRequests;
+    bool captureScheduled = false;
 };
 
-static void cleanupRbResult(void *rbResult)
+static QImage::Format imageFormatOf(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::RGBA8:
+        return QImage::Format_RGBA8888_Premultiplied;
+    case QRhiTexture::BGRA8:
+        return QImage::Format_ARGB32_Premultiplied;
+    case QRhiTexture::RGB10A2:
+        return QImage::Format_A2BGR30_Premultiplied;
+    case QRhiTexture::RGBA16F:
+        return QImage::Format_RGBA16FPx4_Premultiplied;
+    case QRhiTexture::RGBA32F:
+        return QImage::Format_RGBA32FPx4_Premultiplied;
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+static void failRequests(const CaptureRequests &requests, const char *error)
+{
+    for (const auto &request : requests) {
+        request->promise.setException(std::make_exception_ptr(std::runtime_error(error)));
+        request->promise.finish();
+    }
+}
+
+// Crop, scale and convert the image out of the render thread
+static void finishRequests(const CaptureRequests &requests, const QImage &image)
 {
-    delete reinterpret_cast<QRhiReadbackResult*>(rbResult);
+    for (const auto &request : requests) {
+        QThreadPool::globalInstance()->start([request, image] {
+            if (request->promise.isCanceled()) {
+                request->promise.finish();
+                return;
+            }
+
+            QImage result = image;
+            if (!request->sourceRect.isNull())
+                result = result.copy(request->sourceRect & result.rect());
+            if (!result.isNull() && !qFuzzyCompare(request->scale, 1.0)) {
+                const QSize size = (QSizeF(result.size()) * request->scale).toSize();
+                result = size.isEmpty() ? QImage()
+                                        : result.scaled(size, Qt::IgnoreAspectRatio,
+                                                        Qt::SmoothTransformation);
+            }
+            // Don't share the data with the source, e.g. the image of the software renderer
+            if (result.format() != request->format)
+                result.convertTo(request->format);
+            else if (result.constBits() == image.constBits())
+                result = result.copy();
+
+            request->promise.addResult(result);
+            request->promise.finish();
+        });
+    }
 }
 
 WTextureCapturer::WTextureCapturer(WTextureProviderProvider *provider, QObject *parent)
@@ -38,54 +114,106 @@ WTextureCapturer::WTextureCapturer(WTextureProviderProvider *provider, QObject *
 
 }
 
-QFuture<QImage> WTextureCapturer::grabToImage()
+QFuture<QImage> WTextureCapturer::grabToImage(const QRect &sourceRect, qreal scale,
+                                              QImage::Format format)
 {
     W_D(WTextureCapturer);
-    auto future = d->imgPromise.future();
-    moveToThread(QQuickWindowPrivate::get(d->renderWindow)->context->thread());
-    if (d->renderWindow->inRendering()) {
-        connect(d->renderWindow, &WOutputRenderWindow::renderEnd, this, &WTextureCapturer::doGrabToImage, Qt::AutoConnection);
-    } else {
-        // FIXME What if a new render process start before this job is executed?
-        QMetaObject::invokeMethod(this, &WTextureCapturer::doGrabToImage, Qt::AutoConnection);
+
+    auto request = std::make_shared<CaptureRequest>();
+    request->sourceRect = sourceRect;
+    request->scale = scale;
+    request->format = format;
+    request->promise.start();
+    auto future = request->promise.future();
+
+    if (scale <= 0 || format == QImage::Format_Invalid) {
+        failRequests({request}, "Invalid capture parameters.");
+        return future;
     }
+
+    moveToThread(QQuickWindowPrivate::get(d->renderWindow)->context->thread());
+    d->pendingRequests.append(request);
+    d->scheduleCapture();
+
     return future;
 }
 
-void WTextureCapturer::doGrabToImage()
+void WTextureCapturerPrivate::scheduleCapture()
 {
-    W_D(WTextureCapturer);
-    if (d->imgPromise.isCanceled())
+    if (captureScheduled)
+        return;
+    captureScheduled = true;
+
+    // Read back in the frame of the render window, the result is ready when the
+    // frame ends, without starting another offscreen frame and waiting for it.
+    QPointer<WTextureCapturer> capturer = q_func();
+    renderWindow->scheduleRenderJob(QRunnable::create([capturer] {
+        if (capturer)
+            capturer->d_func()->doCapture();
+    }), QQuickWindow::AfterRenderingStage);
+
+    // Maybe in rendering, request a new frame after it
+    QMetaObject::invokeMethod(renderWindow, &WOutputRenderWindow::scheduleRender,
+                              Qt::QueuedConnection);
+}
+
+void WTextureCapturerPrivate::doCapture()
+{
+    captureScheduled = false;
+
+    CaptureRequests requests;
+    for (auto &request : std::exchange(pendingRequests, {})) {
+        if (request->promise.isCanceled())
+            request->promise.finish();
+        else
+            requests.append(std::move(request));
+    }
+    if (requests.isEmpty())
+        return;
+
+    WSGTextureProvider *textureProvider = provider->wTextureProvider();
+    QSGTexture *texture = textureProvider ? textureProvider->texture() : nullptr;
+    if (!texture) {
+        failRequests(requests, "Texture provider is not valid.");
         return;
-    d->imgPromise.start();
-    WSGTextureProvider *textureProvider = d->provider->wTextureProvider();
-    if (textureProvider && textureProvider->texture() && textureProvider->texture()->rhiTexture()) {
-        // Perform rhi texture read back
-        auto texture = textureProvider->texture()->rhiTexture();
-        qCInfo(qLcTextureProvider) << "Perform rhi texture read back for texture" << texture;
-        QRhiReadbackResult *rbResult = new QRhiReadbackResult;
-        QRhiCommandBuffer *cb;
-        d->renderWindow->rhi()->beginOffscreenFrame(&cb);
-        auto ub = d->renderWindow->rhi()->nextResourceUpdateBatch();
-        cb->beginComputePass(ub);
-        QRhiReadbackDescription rbd(texture);
-        ub->readBackTexture(rbd, rbResult);
-        cb->endComputePass(ub);
-        auto frameOpResult = d->renderWindow->rhi()->endOffscreenFrame();
-        if (frameOpResult == QRhi::FrameOpSuccess) {
-            d->imgPromise.addResult(QImage(reinterpret_cast<const uchar *>(rbResult->data.constData()),
-                                       rbResult->pixelSize.width(),
-                                       rbResult->pixelSize.height(),
-                                       QImage::Format_RGBA8888_Premultiplied,
-                                       cleanupRbResult,
-                                       rbResult)); // TODO: Automatically get data format.
-        } else {
-            d->imgPromise.setException(std::make_exception_ptr(std::runtime_error("Offscreen frame operation failed.")));
+    }
+
+    if (auto rhiTexture = texture->rhiTexture()) {
+        const QImage::Format format = imageFormatOf(rhiTexture->format());
+        auto rc = QQuickWindowPrivate::get(renderWindow)->renderControl;
+        QRhiCommandBuffer *cb = rc ? rc->commandBuffer() : nullptr;
+        if (format == QImage::Format_Invalid || !cb) {
+            failRequests(requests, "Can't read back the texture.");
+            return;
         }
+
+        qCDebug(qLcTextureProvider) << "Perform rhi texture read back for texture" << rhiTexture
+                                    << "requests:" << requests.size();
+        auto rbResult = new QRhiReadbackResult;
+        rbResult->completed = [rbResult, requests, format] {
+            auto data = new QByteArray(std::move(rbResult->data));
+            const QImage image(reinterpret_cast<const uchar *>(data->constData()),
+                               rbResult->pixelSize.width(), rbResult->pixelSize.height(),
+                               format, [] (void *data) {
+                delete static_cast<QByteArray*>(data);
+            }, data);
+            finishRequests(requests, image);
+            // Can't delete in its completed callback
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [rbResult] {
+                delete rbResult;
+            }, Qt::QueuedConnection);
+        };
+
+        auto ub = renderWindow->rhi()->nextResourceUpdateBatch();
+        ub->readBackTexture(QRhiReadbackDescription(rhiTexture), rbResult);
+        cb->resourceUpdate(ub);
+    } else if (auto plainTexture = qobject_cast<QSGPlainTexture*>(texture);
+               plainTexture && !plainTexture->image().isNull()) {
+        // Software renderer, the image is implicitly shared
+        finishRequests(requests, plainTexture->image());
     } else {
-        d->imgPromise.setException(std::make_exception_ptr(std::runtime_error("Texture provider is not valid.")));
+        failRequests(requests, "Texture provider is not valid.");
     }
-    d->imgPromise.finish();
 }
 
 WAYLIB_SERVER_END_NAMESPACE
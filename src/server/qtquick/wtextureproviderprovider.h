@@ -4,6 +4,10 @@
 #pragma once
 
 #include <wsgtextureprovider.h>
+
+#include <QFuture>
+#include <QImage>
+
 WAYLIB_SERVER_BEGIN_NAMESPACE
 class WTextureCapturerPrivate;
 
@@ -20,10 +24,13 @@ class WAYLIB_SERVER_EXPORT WTextureCapturer: public QObject, public WObject
     W_DECLARE_PRIVATE(WTextureCapturer)
 public:
     explicit WTextureCapturer(WTextureProviderProvider *provider, QObject *parent = nullptr);
-    QFuture<QImage> grabToImage();
 
-private:
-    void doGrabToImage();
+    // The texture is read back in the next frame of the render window without
+    // blocking it, the sourceRect (in texture pixels, null for the whole texture)
+    // is cropped and scaled, and converted to the format in a worker thread.
+    // Any count of captures can be pending at the same time.
+    QFuture<QImage> grabToImage(const QRect &sourceRect = QRect(), qreal scale = 1.0,
+                                QImage::Format format = QImage::Format_RGBA8888_Premultiplied);
 };
 
 WAYLIB_SERVER_END_NAMESPACE
@@ -483,6 +483,7 @@ public:
     }
 
     void setImage(const QImage &image, const QPoint &hotspot);
+    void setXCursorImage(int index);
     void updateCursorImage();
     void playXCursor();
 
@@ -496,6 +497,9 @@ public:
     float scale = 1.0;
 
     wlr_xcursor *xcursor = nullptr;
+    // The images of the xcursor, the same QImage (and its cacheKey) is used
+    // in each loop of the animation, so its texture can be cached.
+    QList<QImage> xcursorImages;
     int currentXCursorImageIndex = 0;
     QTimer *xcursorPlayTimer = nullptr;
 
@@ -510,9 +514,22 @@ void WCursorImagePrivate::setImage(const QImage &image, const QPoint &hotspot) {
     Q_EMIT q_func()->imageChanged();
 }
 
+void WCursorImagePrivate::setXCursorImage(int index)
+{
+    Q_ASSERT(xcursor);
+    Q_ASSERT(index < xcursorImages.size());
+
+    auto ximage = xcursor->images[index];
+    QImage &image = xcursorImages[index];
+    // Avoid detach in setImage
+    image.setDevicePixelRatio(scale);
+    setImage(image, QPoint(ximage->hotspot_x, ximage->hotspot_y));
+}
+
 void WCursorImagePrivate::updateCursorImage()
 {
     xcursor = nullptr;
+    xcursorImages.clear();
     currentXCursorImageIndex = 0;
 
     std::unique_ptr<QTimer, QScopedPointerObjectDeleteLater<QTimer>> tempTimer(xcursorPlayTimer);
@@ -544,12 +561,17 @@ void WCursorImagePrivate::updateCursorImage()
         return;
     }
 
+    xcursorImages.reserve(xcursor->image_count);
+    for (uint i = 0; i < xcursor->image_count; ++i) {
+        auto ximage = xcursor->images[i];
+        // Copy the data, the image maybe kept after the xcursor theme is destroyed
+        xcursorImages.append(QImage(static_cast<const uchar*>(ximage->buffer),
+                                    ximage->width, ximage->height,
+                                    QImage::Format_ARGB32_Premultiplied).copy());
+    }
+
     if (xcursor->image_count == 1) {
-        auto ximage = xcursor->images[0];
-        setImage(QImage(static_cast<const uchar*>(ximage->buffer),
-                        ximage->width, ximage->height,
-                        QImage::Format_ARGB32_Premultiplied),
-                 QPoint(ximage->hotspot_x, ximage->hotspot_y));
+        setXCursorImage(0);
         return;
     }
 
@@ -573,10 +595,7 @@ void WCursorImagePrivate::playXCursor()
     Q_ASSERT(!xcursorPlayTimer->isActive());
 
     auto ximage = xcursor->images[currentXCursorImageIndex];
-    setImage(QImage(static_cast<const uchar*>(ximage->buffer),
-                    ximage->width, ximage->height,
-                    QImage::Format_ARGB32_Premultiplied),
-             QPoint(ximage->hotspot_x, ximage->hotspot_y));
+    setXCursorImage(currentXCursorImageIndex);
 
     currentXCursorImageIndex = (currentXCursorImageIndex + 1) % xcursor->image_count;
     xcursorPlayTimer->start(ximage->delay);
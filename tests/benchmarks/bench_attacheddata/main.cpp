@@ -0,0 +1,131 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Look up the attached data of many objects, and print the time of each
+// lookup by the owner (the linear list) and by the type (the slot), e.g.
+//   bench_attacheddata --objects 10000 --rounds 100
+
+#include <wglobal.h>
+#include <wsocket.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+// Every object has the data of all these types, the surfaces usually have
+// the data of their shell surface, the decoration, the foreign toplevel...
+static constexpr int TypeCount = 8;
+
+template<int N>
+struct Tag
+{
+    int value = N;
+};
+
+template<int N>
+static inline const void *ownerOf()
+{
+    return typeid(Tag<N>).name();
+}
+
+template<std::size_t... N>
+static void attach(WObject *object, std::index_sequence<N...>)
+{
+    (object->setAttachedData<Tag<N>>(ownerOf<N>(), new Tag<N>), ...);
+    (object->setAttachedData<Tag<N>>(new Tag<N>), ...);
+}
+
+template<std::size_t... N>
+static void detach(WObject *object, std::index_sequence<N...>)
+{
+    (delete object->getAttachedData<Tag<N>>(ownerOf<N>()), ...);
+    (object->removeAttachedData<Tag<N>>(ownerOf<N>()), ...);
+    (delete object->getAttachedData<Tag<N>>(), ...);
+    (object->removeAttachedData<Tag<N>>(), ...);
+}
+
+template<std::size_t... N>
+static int lookupByOwner(const WObject *object, std::index_sequence<N...>)
+{
+    return (object->getAttachedData<Tag<N>>(ownerOf<N>())->value + ...);
+}
+
+template<std::size_t... N>
+static int lookupBySlot(const WObject *object, std::index_sequence<N...>)
+{
+    return (object->getAttachedData<Tag<N>>()->value + ...);
+}
+
+template<typename Lookup>
+static qint64 measure(const std::vector<std::unique_ptr<WSocket>> &objects, int rounds,
+                      Lookup lookup, qint64 *checksum)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < rounds; ++i) {
+        for (const auto &object : objects)
+            *checksum += lookup(object.get(), std::make_index_sequence<TypeCount>());
+    }
+    return timer.nsecsElapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption objectsOption("objects", "The count of the objects.", "count", "10000");
+    QCommandLineOption roundsOption("rounds", "The lookup rounds of all objects.", "count", "100");
+    parser.addOptions({objectsOption, roundsOption});
+    parser.process(app);
+
+    const int objectCount = std::max(1, parser.value(objectsOption).toInt());
+    const int rounds = std::max(1, parser.value(roundsOption).toInt());
+
+    std::vector<std::unique_ptr<WSocket>> objects;
+    objects.reserve(objectCount);
+    for (int i = 0; i < objectCount; ++i) {
+        objects.emplace_back(new WSocket(false));
+        attach(objects.back().get(), std::make_index_sequence<TypeCount>());
+    }
+
+    qint64 ownerChecksum = 0;
+    qint64 slotChecksum = 0;
+    // Warm up the caches
+    measure(objects, 1, [] (const WObject *object, auto types) {
+        return lookupByOwner(object, types);
+    }, &ownerChecksum);
+    measure(objects, 1, [] (const WObject *object, auto types) {
+        return lookupBySlot(object, types);
+    }, &slotChecksum);
+
+    const qint64 ownerTime = measure(objects, rounds, [] (const WObject *object, auto types) {
+        return lookupByOwner(object, types);
+    }, &ownerChecksum);
+    const qint64 slotTime = measure(objects, rounds, [] (const WObject *object, auto types) {
+        return lookupBySlot(object, types);
+    }, &slotChecksum);
+
+    if (ownerChecksum != slotChecksum)
+        qFatal("The lookups of the owner and the slot are different");
+
+    const qreal lookups = qreal(objectCount) * rounds * TypeCount;
+    printf("objects: %d, attached data per object: %d, lookups: %.0f\n",
+           objectCount, TypeCount, lookups);
+    printf("by owner: %.2f ns per lookup, by slot: %.2f ns per lookup\n",
+           ownerTime / lookups, slotTime / lookups);
+    fflush(stdout);
+
+    for (const auto &object : objects)
+        detach(object.get(), std::make_index_sequence<TypeCount>());
+
+    return 0;
+}
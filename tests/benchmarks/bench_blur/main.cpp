@@ -0,0 +1,254 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Blur an animated background by a RenderBufferBlitter on a headless output,
+// print the time of the frames for each blur radius, e.g.
+//   bench_blur
+//   bench_blur --radius 0,16,64 --noise 0.02 --tint "#40ffffff"
+//   WLR_RENDERER=vulkan bench_blur
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wrenderbufferblitter.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QTimer>
+
+#include <algorithm>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+// The background is changed in every frame, so the blur can't be skipped
+static const char backgroundQml[] = R"(
+import QtQuick
+
+Rectangle {
+    gradient: Gradient {
+        GradientStop { position: 0.0; color: "#203040" }
+        GradientStop { position: 1.0; color: "#e0c080" }
+    }
+
+    Repeater {
+        model: 8
+
+        Rectangle {
+            x: index * parent.width / 8
+            width: parent.width / 16
+            height: parent.height
+            color: index % 2 ? "steelblue" : "orange"
+
+            RotationAnimation on rotation {
+                from: 0
+                to: 360
+                duration: 4000
+                loops: Animation.Infinite
+            }
+        }
+    }
+}
+)";
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void enableOutput(WOutput *output)
+{
+    auto qwoutput = output->handle();
+    qw_output_state newState;
+
+    if (!qwoutput->handle()->current_mode) {
+        if (auto mode = qwoutput->preferred_mode())
+            newState.set_mode(mode);
+    }
+    newState.set_enabled(true);
+    bool ok = qwoutput->commit_state(newState);
+    Q_ASSERT(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption radiusOption("radius", "The blur radius to measure, separated by commas.",
+                                    "radius", "0,4,8,16,32,64");
+    QCommandLineOption noiseOption("noise", "The noise of the blur.", "noise", "0");
+    QCommandLineOption tintOption("tint", "The tint color of the blur.", "color", "transparent");
+    QCommandLineOption framesOption("frames", "The number of the frames to measure for each radius.", "count", "200");
+    QCommandLineOption widthOption("width", "The width of the output.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "The height of the output.", "pixels", "1080");
+    parser.addOptions({radiusOption, noiseOption, tintOption, framesOption, widthOption, heightOption});
+    parser.process(app);
+
+    QList<qreal> radiuses;
+    for (const auto &value : parser.value(radiusOption).split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const qreal radius = value.trimmed().toDouble(&ok);
+        if (!ok || radius < 0)
+            qFatal("Invalid radius: %s", qPrintable(value));
+        radiuses.append(radius);
+    }
+    if (radiuses.isEmpty())
+        qFatal("No radius to measure");
+
+    const int frameCount = std::max(1, parser.value(framesOption).toInt());
+    // The frames after the radius changed allocate the buffers, don't measure them
+    const int warmupFrames = 10;
+    const QSize outputSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width());
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(backgroundQml, QUrl());
+    if (component.isError())
+        qFatal("%s", qPrintable(component.errorString()));
+
+    auto background = qobject_cast<QQuickItem*>(component.create());
+    Q_ASSERT(background);
+    background->setParent(&window);
+    background->setParentItem(window.contentItem());
+    background->setSize(outputSize);
+
+    auto blitter = new WRenderBufferBlitter(window.contentItem());
+    blitter->setSize(outputSize / 2);
+    blitter->setPosition(QPointF(outputSize.width() / 4, outputSize.height() / 4));
+    blitter->setZ(1);
+    blitter->setBlurNoise(parser.value(noiseOption).toDouble());
+    blitter->setBlurTint(QColor(parser.value(tintOption)));
+    blitter->setBlurRadius(radiuses.first());
+
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        auto viewport = new WOutputViewport(window.contentItem());
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+
+        enableOutput(output);
+    });
+
+    backend->handle()->start();
+
+    auto headless = findHeadlessBackend(backend->handle());
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    printf("output: %dx%d, blur: %dx%d, renderer: %s\n",
+           outputSize.width(), outputSize.height(), int(blitter->width()), int(blitter->height()),
+           qgetenv("WLR_RENDERER").constData());
+
+    int radiusIndex = 0;
+    int skippedFrames = 0;
+    QList<qint64> frameTimes;
+    frameTimes.reserve(frameCount);
+    QElapsedTimer frameTimer;
+
+    QObject::connect(&window, &WOutputRenderWindow::beforeRendering, &window, [&] {
+        frameTimer.start();
+    }, Qt::DirectConnection);
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &window, [&] {
+        if (!frameTimer.isValid())
+            return;
+        const qint64 elapsed = frameTimer.nsecsElapsed();
+        frameTimer.invalidate();
+
+        if (skippedFrames < warmupFrames) {
+            ++skippedFrames;
+            return;
+        }
+
+        frameTimes.append(elapsed);
+        if (frameTimes.size() < frameCount)
+            return;
+
+        std::sort(frameTimes.begin(), frameTimes.end());
+        qint64 sum = 0;
+        for (auto t : std::as_const(frameTimes))
+            sum += t;
+
+        const auto toMs = [] (qint64 nsecs) { return nsecs / 1000000.0; };
+        printf("radius: %6.1f, frames: %lld, mean: %.3f ms, median: %.3f ms, p95: %.3f ms, max: %.3f ms\n",
+               radiuses.at(radiusIndex), qint64(frameTimes.size()), toMs(sum / frameTimes.size()),
+               toMs(frameTimes.at(frameTimes.size() / 2)),
+               toMs(frameTimes.at(frameTimes.size() * 95 / 100)),
+               toMs(frameTimes.last()));
+        fflush(stdout);
+
+        if (++radiusIndex >= radiuses.size()) {
+            QCoreApplication::quit();
+            return;
+        }
+
+        frameTimes.clear();
+        skippedFrames = 0;
+        blitter->setBlurRadius(radiuses.at(radiusIndex));
+    });
+
+    // Avoid to wait forever if the output can't be rendered
+    QTimer::singleShot(std::chrono::minutes(5), &app, [] {
+        qCritical("Timeout, the frames aren't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    return app.exec();
+}
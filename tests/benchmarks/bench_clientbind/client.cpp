@@ -0,0 +1,57 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Only the interfaces of libwayland-client are known, the events of the
+// others can't be parsed. The ones of ClientConnection are bound already.
+const wl_interface *const knownInterfaces[] = {
+    &wl_output_interface,
+    &wl_seat_interface,
+    &wl_data_device_manager_interface,
+};
+
+void handleGlobal(void *data, wl_registry *registry, uint32_t name,
+                  const char *interface, uint32_t version)
+{
+    auto bound = static_cast<std::vector<wl_proxy*>*>(data);
+    for (auto known : knownInterfaces) {
+        if (strcmp(known->name, interface) != 0)
+            continue;
+
+        const uint32_t v = std::min<uint32_t>(version, known->version);
+        bound->push_back(static_cast<wl_proxy*>(wl_registry_bind(registry, name, known, v)));
+        break;
+    }
+}
+
+} // namespace
+
+int connectAndBindGlobals(const char *socket)
+{
+    std::vector<wl_proxy*> bound;
+    ClientConnection connection;
+    connection.globalHandler = handleGlobal;
+    connection.globalHandlerData = &bound;
+
+    // The first roundtrip for the globals, the second for the binds
+    const bool ok = connectClient(socket, &connection)
+                    && wl_display_roundtrip(connection.display) >= 0;
+    const int count = ok ? int(bound.size()) + !!connection.compositor + !!connection.subcompositor
+                               + !!connection.shm + !!connection.wmBase
+                         : -1;
+
+    for (auto proxy : bound)
+        wl_proxy_destroy(proxy);
+    disconnectClient(&connection);
+
+    return count;
+}
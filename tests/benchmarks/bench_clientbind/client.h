@@ -0,0 +1,11 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+// Connect to the socket, bind all known globals and wait for the server to
+// handle the requests, returns the count of the bound globals, or -1 if failed.
+int connectAndBindGlobals(const char *socket);
@@ -0,0 +1,172 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Connect many clients one by one to a server with many headless outputs, each
+// client binds the globals and disconnects, print the time of each connection,
+// e.g. compare the result of:
+//   bench_clientbind --outputs 1
+//   bench_clientbind --outputs 64
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wseat.h>
+#include <wsocket.h>
+#include <woutputlayout.h>
+#include <wxdgshell.h>
+#include <wlayershell.h>
+#include <wxdgdecorationmanager.h>
+#include <wcursorshapemanagerv1.h>
+#include <woutputmanagerv1.h>
+#include <wrenderhelper.h>
+
+#include <qwbackend.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <time.h>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static qint64 monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+static qint64 percentile(const QList<qint64> &sorted, qreal fraction)
+{
+    const int index = std::clamp<int>(sorted.size() * fraction, 0, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption clientsOption("clients", "The count of the clients.", "count", "500");
+    QCommandLineOption outputsOption("outputs", "The count of the headless outputs.", "count", "32");
+    parser.addOptions({clientsOption, outputsOption});
+    parser.process(app);
+
+    const int clients = std::max(1, parser.value(clientsOption).toInt());
+    const int outputs = std::max(1, parser.value(outputsOption).toInt());
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    auto seat = server.attach<WSeat>();
+    auto xdgShell = server.attach<WXdgShell>(5);
+    server.attach<WLayerShell>(xdgShell);
+    server.attach<WXdgDecorationManager>();
+    server.attach<WCursorShapeManagerV1>();
+    server.attach<WOutputManagerV1>();
+    auto layout = new WOutputLayout(&server);
+
+    // Let the global filter find the WServerInterface of each global
+    seat->setFilter([] (WClient *) {
+        return true;
+    });
+
+    auto socket = new WSocket(false);
+    if (!socket->autoCreate())
+        qFatal("Failed to create socket");
+    server.addSocket(socket);
+    server.start();
+
+    QObject::connect(backend, &WBackend::outputAdded, layout, [layout] (WOutput *output) {
+        layout->autoAdd(output);
+    });
+
+    backend->handle()->start();
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle()->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+    if (!headless && wlr_backend_is_headless(backend->handle()->handle()))
+        headless = backend->handle()->handle();
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    for (int i = 0; i < outputs; ++i)
+        wlr_headless_add_output(headless, 800, 600);
+
+    const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+    QList<qint64> times;
+    int boundGlobals = 0;
+    times.reserve(clients);
+
+    // The clients block on the roundtrip, run them out of the server thread
+    auto clientThread = QThread::create([&] {
+        for (int i = 0; i < clients; ++i) {
+            const qint64 begin = monotonicTime();
+            boundGlobals = connectAndBindGlobals(socketName.constData());
+            if (boundGlobals < 0)
+                break;
+            times.append(monotonicTime() - begin);
+        }
+    });
+
+    QObject::connect(clientThread, &QThread::finished, &app, [&] {
+        if (times.size() != clients) {
+            qCritical("The client %d failed to bind the globals", int(times.size()));
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        qint64 total = 0;
+        for (auto time : std::as_const(times))
+            total += time;
+        std::sort(times.begin(), times.end());
+
+        printf("clients: %d, outputs: %d, server interfaces: %d, bound globals per client: %d\n",
+               clients, outputs, int(server.interfaceList().size()), boundGlobals);
+        printf("bind time: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms, total %.1f ms\n",
+               total / 1000000.0 / clients, percentile(times, 0.5) / 1000000.0,
+               percentile(times, 0.99) / 1000000.0, times.last() / 1000000.0,
+               total / 1000000.0);
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+
+    QTimer::singleShot(0, clientThread, [clientThread] {
+        clientThread->start();
+    });
+
+    // The client thread may be blocked on the roundtrip, can't wait it
+    QTimer::singleShot(std::chrono::seconds(120), &app, [] {
+        qFatal("Timeout, the clients aren't finished");
+    });
+
+    int exitCode = app.exec();
+    clientThread->wait();
+    delete clientThread;
+
+    return exitCode;
+}
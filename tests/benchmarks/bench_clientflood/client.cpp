@@ -0,0 +1,118 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <cerrno>
+#include <poll.h>
+
+namespace {
+
+struct ClientState
+{
+    ClientConnection connection;
+    wl_display *display = nullptr;
+    wl_surface *surface = nullptr;
+};
+
+bool connectSurfaceClient(const char *socket, ClientState *state)
+{
+    if (!connectClient(socket, &state->connection) || !state->connection.compositor)
+        return false;
+
+    state->display = state->connection.display;
+    state->surface = wl_compositor_create_surface(state->connection.compositor);
+    return true;
+}
+
+void disconnectSurfaceClient(ClientState *state)
+{
+    if (state->surface)
+        wl_surface_destroy(state->surface);
+    disconnectClient(&state->connection);
+}
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    *static_cast<bool*>(data) = true;
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+} // namespace
+
+long long runFloodingClient(const char *socket, int seconds, bool *disconnected)
+{
+    ClientState state;
+    *disconnected = false;
+    if (!connectSurfaceClient(socket, &state)) {
+        disconnectSurfaceClient(&state);
+        return -1;
+    }
+
+    // Keep the batch smaller than the buffer of the connection
+    constexpr int BatchSize = 100;
+    const long long end = monotonicTime() + (long long)seconds * 1000000000;
+    long long count = 0;
+    struct pollfd pfd = { wl_display_get_fd(state.display), POLLOUT, 0 };
+
+    while (monotonicTime() < end) {
+        for (int i = 0; i < BatchSize; ++i) {
+            wl_surface_damage(state.surface, 0, 0, 1, 1);
+            wl_surface_commit(state.surface);
+        }
+        count += BatchSize * 2;
+
+        // Don't wait for the server, only wait for the space of the socket
+        while (wl_display_flush(state.display) < 0) {
+            if (errno != EAGAIN) {
+                *disconnected = true;
+                break;
+            }
+            poll(&pfd, 1, -1);
+        }
+        if (*disconnected)
+            break;
+    }
+
+    if (!*disconnected && wl_display_roundtrip(state.display) < 0)
+        *disconnected = true;
+
+    disconnectSurfaceClient(&state);
+    return count;
+}
+
+std::vector<long long> runFrameClient(const char *socket, int seconds)
+{
+    ClientState state;
+    std::vector<long long> latencies;
+    if (!connectSurfaceClient(socket, &state)) {
+        disconnectSurfaceClient(&state);
+        return latencies;
+    }
+
+    const long long end = monotonicTime() + (long long)seconds * 1000000000;
+    while (monotonicTime() < end) {
+        bool done = false;
+        auto callback = wl_surface_frame(state.surface);
+        wl_callback_add_listener(callback, &frameListener, &done);
+        wl_surface_commit(state.surface);
+
+        const long long begin = monotonicTime();
+        while (!done) {
+            if (wl_display_dispatch(state.display) < 0) {
+                disconnectSurfaceClient(&state);
+                return {};
+            }
+        }
+        latencies.push_back(monotonicTime() - begin);
+    }
+
+    disconnectSurfaceClient(&state);
+    return latencies;
+}
@@ -0,0 +1,19 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <vector>
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+// Commit a surface as fast as possible for the seconds, returns the count of
+// the sent requests, or -1 if failed to connect. Stops early if the server
+// disconnects the client.
+long long runFloodingClient(const char *socket, int seconds, bool *disconnected);
+
+// Request a frame callback and commit in a loop for the seconds, returns the
+// time (nanoseconds) from each commit to its frame callback, or an empty list
+// if failed.
+std::vector<long long> runFrameClient(const char *socket, int seconds);
@@ -0,0 +1,218 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// One client floods the server by commits, the other clients request a frame
+// callback and commit in a loop, the frame callbacks are sent at 60Hz. Print
+// the latency from the commit to the frame callback of the well-behaved
+// clients, e.g. compare the result of:
+//   bench_clientflood
+//   bench_clientflood --max-requests 2000 --policy throttle
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <wsocket.h>
+#include <wrenderhelper.h>
+
+#include <qwbackend.h>
+#include <qwrenderer.h>
+#include <qwcompositor.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QMetaEnum>
+#include <QTimer>
+
+#include <algorithm>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+struct ChildProcess
+{
+    pid_t pid = -1;
+    int resultFd = -1;
+};
+
+// The clients are in the child processes, the server can freeze or
+// deprioritize them without affecting itself.
+template<typename Function>
+static ChildProcess forkClient(Function function)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        return {};
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        function(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    return {pid, fds[0]};
+}
+
+static QByteArray readAll(int fd)
+{
+    QByteArray data;
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0)
+        data.append(buffer, size);
+    close(fd);
+    return data;
+}
+
+static qint64 percentile(const QList<qint64> &sorted, qreal fraction)
+{
+    const int index = std::clamp<int>(sorted.size() * fraction, 0, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    const auto policies = QMetaEnum::fromType<WSocket::RateLimitPolicy>();
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption clientsOption("clients", "The count of the well-behaved clients.", "count", "4");
+    QCommandLineOption secondsOption("seconds", "The duration of the flooding.", "seconds", "5");
+    QCommandLineOption maxRequestsOption("max-requests", "WSocket::maxRequestsPerDispatch, 0 is no limit.", "count", "0");
+    QCommandLineOption policyOption("policy", "WSocket::rateLimitPolicy, e.g. Throttle.", "policy", "Notify");
+    parser.addOptions({clientsOption, secondsOption, maxRequestsOption, policyOption});
+    parser.process(app);
+
+    const int clients = std::max(1, parser.value(clientsOption).toInt());
+    const int seconds = std::max(1, parser.value(secondsOption).toInt());
+    bool ok = false;
+    const int policy = policies.keyToValue(parser.value(policyOption).toLatin1(), &ok);
+    if (!ok)
+        qFatal("Unknown policy: %s", qPrintable(parser.value(policyOption)));
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+
+    auto socket = new WSocket(false);
+    if (!socket->autoCreate())
+        qFatal("Failed to create socket");
+    socket->setMaxRequestsPerDispatch(parser.value(maxRequestsOption).toInt());
+    socket->setRateLimitPolicy(WSocket::RateLimitPolicy(policy));
+    server.addSocket(socket);
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto compositor = qw_compositor::create(*server.handle(), 6, *renderer);
+
+    // Send the frame callbacks like an output at 60Hz
+    QList<qw_surface*> surfaces;
+    QObject::connect(compositor, &qw_compositor::notify_new_surface, &app, [&] (wlr_surface *handle) {
+        auto surface = qw_surface::from(handle);
+        surfaces.append(surface);
+        QObject::connect(surface, &qw_surface::before_destroy, &app, [&surfaces, surface] {
+            surfaces.removeOne(surface);
+        });
+    });
+    QTimer frameTimer;
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    frameTimer.setInterval(std::chrono::microseconds(16667));
+    QObject::connect(&frameTimer, &QTimer::timeout, &app, [&surfaces] {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (auto surface : std::as_const(surfaces))
+            wlr_surface_send_frame_done(surface->handle(), &now);
+    });
+    frameTimer.start();
+
+    quint64 exceededCount = 0;
+    QObject::connect(socket, &WSocket::clientRateLimitExceeded, &app, [&exceededCount] {
+        ++exceededCount;
+    });
+
+    backend->handle()->start();
+
+    const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+    QList<ChildProcess> children;
+    children.append(forkClient([&] (int fd) {
+        bool disconnected = false;
+        const long long count = runFloodingClient(socketName.constData(), seconds, &disconnected);
+        const QByteArray result = QByteArray::number(count) + (disconnected ? " disconnected" : "");
+        write(fd, result.constData(), result.size());
+    }));
+    for (int i = 0; i < clients; ++i) {
+        children.append(forkClient([&] (int fd) {
+            const auto latencies = runFrameClient(socketName.constData(), seconds);
+            write(fd, latencies.data(), latencies.size() * sizeof(long long));
+        }));
+    }
+    for (const auto &child : std::as_const(children)) {
+        if (child.pid < 0)
+            qFatal("Failed to fork the client");
+    }
+
+    // Keep serving the clients until they are exited
+    QTimer waitTimer;
+    waitTimer.setInterval(10);
+    QObject::connect(&waitTimer, &QTimer::timeout, &app, [&] {
+        for (const auto &child : std::as_const(children)) {
+            if (waitpid(child.pid, nullptr, WNOHANG) == 0)
+                return;
+        }
+        waitTimer.stop();
+
+        const QByteArray flooding = readAll(children.first().resultFd);
+        QList<qint64> latencies;
+        for (int i = 1; i < children.size(); ++i) {
+            const QByteArray data = readAll(children.at(i).resultFd);
+            if (data.isEmpty()) {
+                qCritical("The client %d is failed", i);
+                QCoreApplication::exit(1);
+                return;
+            }
+            const auto values = reinterpret_cast<const long long*>(data.constData());
+            for (qsizetype j = 0; j < data.size() / qsizetype(sizeof(long long)); ++j)
+                latencies.append(values[j]);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        printf("policy: %s, max requests per dispatch: %d, well-behaved clients: %d\n",
+               policies.valueToKey(policy), socket->maxRequestsPerDispatch(), clients);
+        printf("flooding client: %s requests, exceeded the limit %llu times\n",
+               flooding.constData(), exceededCount);
+        printf("frame callback latency: p50 %.2f ms, p99 %.2f ms, max %.2f ms, frames: %d\n",
+               percentile(latencies, 0.5) / 1000000.0, percentile(latencies, 0.99) / 1000000.0,
+               latencies.last() / 1000000.0, int(latencies.size()));
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+    waitTimer.start();
+
+    QTimer::singleShot(std::chrono::seconds(seconds * 2 + 60), &app, [&children] {
+        for (const auto &child : std::as_const(children))
+            kill(child.pid, SIGKILL);
+        qFatal("Timeout, the clients aren't finished");
+    });
+
+    return app.exec();
+}
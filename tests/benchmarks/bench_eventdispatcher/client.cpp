@@ -0,0 +1,45 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+void *connectIdleClient(const char *socket)
+{
+    auto connection = new ClientConnection;
+    if (!connectClient(socket, connection)) {
+        disconnectIdleClient(connection);
+        return nullptr;
+    }
+
+    return connection;
+}
+
+void disconnectIdleClient(void *client)
+{
+    auto connection = static_cast<ClientConnection*>(client);
+    disconnectClient(connection);
+    delete connection;
+}
+
+long long runChattyClient(const char *socket, const std::atomic_bool &stop)
+{
+    ClientConnection connection;
+    if (!connectClient(socket, &connection)) {
+        disconnectClient(&connection);
+        return -1;
+    }
+
+    long long count = 0;
+    while (!stop) {
+        if (wl_display_roundtrip(connection.display) < 0) {
+            count = -1;
+            break;
+        }
+        ++count;
+    }
+
+    disconnectClient(&connection);
+    return count;
+}
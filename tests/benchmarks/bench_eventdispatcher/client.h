@@ -0,0 +1,17 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+// Connect to the socket and wait for the registry, returns nullptr if failed
+void *connectIdleClient(const char *socket);
+void disconnectIdleClient(void *client);
+
+// Send wl_display.sync and wait for the callback until the stop is true,
+// returns the count of the roundtrips, or -1 if failed.
+long long runChattyClient(const char *socket, const std::atomic_bool &stop);
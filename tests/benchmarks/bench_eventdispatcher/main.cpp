@@ -0,0 +1,211 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Serve many idle clients and some chatty clients (roundtrip in a loop), and
+// print the event loop iterations, the context switches and the read/write
+// syscalls of the server thread, e.g. compare the result of:
+//   bench_eventdispatcher
+//   bench_eventdispatcher --epoll
+// For the count of all syscalls, run it by:
+//   perf stat -e 'syscalls:sys_enter_*' --per-thread bench_eventdispatcher
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <wseat.h>
+#include <wsocket.h>
+#include <wrenderhelper.h>
+
+#include <qwbackend.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QAbstractEventDispatcher>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+struct ThreadCounters
+{
+    qint64 cpuTime = 0;
+    long contextSwitches = 0;
+    qint64 readSyscalls = 0;
+    qint64 writeSyscalls = 0;
+
+    static ThreadCounters current() {
+        ThreadCounters counters;
+
+        struct timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        counters.cpuTime = qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+        struct rusage usage;
+        getrusage(RUSAGE_THREAD, &usage);
+        counters.contextSwitches = usage.ru_nvcsw + usage.ru_nivcsw;
+
+        // The main thread, the clients are in the other threads
+        QFile io(QStringLiteral("/proc/self/task/%1/io").arg(getpid()));
+        if (io.open(QIODevice::ReadOnly)) {
+            const auto lines = io.readAll().split('\n');
+            for (const auto &line : lines) {
+                if (line.startsWith("syscr:"))
+                    counters.readSyscalls = line.mid(6).trimmed().toLongLong();
+                else if (line.startsWith("syscw:"))
+                    counters.writeSyscalls = line.mid(6).trimmed().toLongLong();
+            }
+        }
+
+        return counters;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    // Must be set before creating the QGuiApplication
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--epoll") == 0)
+            qputenv("WAYLIB_EPOLL_EVENT_DISPATCHER", "1");
+    }
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption idleOption("idle", "The count of the idle clients.", "count", "300");
+    QCommandLineOption chattyOption("chatty", "The count of the chatty clients.", "count", "16");
+    QCommandLineOption secondsOption("seconds", "The duration of the measurement.", "seconds", "5");
+    QCommandLineOption epollOption("epoll", "Use WAYLIB_EPOLL_EVENT_DISPATCHER.");
+    parser.addOptions({idleOption, chattyOption, secondsOption, epollOption});
+    parser.process(app);
+
+    const int idleCount = std::max(0, parser.value(idleOption).toInt());
+    const int chattyCount = std::max(1, parser.value(chattyOption).toInt());
+    const int seconds = std::max(1, parser.value(secondsOption).toInt());
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    server.attach<WSeat>();
+
+    auto socket = new WSocket(false);
+    if (!socket->autoCreate())
+        qFatal("Failed to create socket");
+    server.addSocket(socket);
+    server.start();
+    backend->handle()->start();
+
+    quint64 iterations = 0;
+    auto dispatcher = QThread::currentThread()->eventDispatcher();
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::awake, &app, [&iterations] {
+        ++iterations;
+    });
+
+    const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+    std::atomic_bool stop = false;
+    std::atomic_llong roundtrips = 0;
+    std::atomic_bool failed = false;
+
+    QList<void*> idleClients;
+    auto idleThread = QThread::create([&] {
+        for (int i = 0; i < idleCount; ++i) {
+            auto client = connectIdleClient(socketName.constData());
+            if (!client) {
+                failed = true;
+                break;
+            }
+            idleClients.append(client);
+        }
+    });
+
+    QList<QThread*> chattyThreads;
+    for (int i = 0; i < chattyCount; ++i) {
+        chattyThreads.append(QThread::create([&] {
+            const auto count = runChattyClient(socketName.constData(), stop);
+            if (count < 0)
+                failed = true;
+            else
+                roundtrips += count;
+        }));
+    }
+
+    ThreadCounters begin;
+    quint64 iterationsBegin = 0;
+    QTimer measureTimer;
+    measureTimer.setSingleShot(true);
+    measureTimer.setInterval(std::chrono::seconds(seconds));
+
+    // Measure after all idle clients are connected
+    QObject::connect(idleThread, &QThread::finished, &app, [&] {
+        for (auto thread : std::as_const(chattyThreads))
+            thread->start();
+        begin = ThreadCounters::current();
+        iterationsBegin = iterations;
+        measureTimer.start();
+    });
+
+    QObject::connect(&measureTimer, &QTimer::timeout, &app, [&] {
+        const auto end = ThreadCounters::current();
+        const quint64 loops = std::max<quint64>(iterations - iterationsBegin, 1);
+        stop = true;
+
+        // Keep serving the clients until they are stopped
+        QTimer::singleShot(0, &app, [&, end, loops] {
+            for (auto thread : std::as_const(chattyThreads)) {
+                while (!thread->wait(1))
+                    QCoreApplication::processEvents();
+            }
+
+            if (failed) {
+                qCritical("Some clients are failed");
+                QCoreApplication::exit(1);
+                return;
+            }
+
+            printf("dispatcher: %s, idle clients: %d, chatty clients: %d\n",
+                   dispatcher->metaObject()->className(), idleCount, chattyCount);
+            printf("iterations: %llu, roundtrips: %lld, cpu time: %.3f ms per second\n",
+                   loops, roundtrips.load(), (end.cpuTime - begin.cpuTime) / 1000000.0 / seconds);
+            printf("per iteration: %.2f context switches, %.2f read syscalls, %.2f write syscalls\n",
+                   qreal(end.contextSwitches - begin.contextSwitches) / loops,
+                   qreal(end.readSyscalls - begin.readSyscalls) / loops,
+                   qreal(end.writeSyscalls - begin.writeSyscalls) / loops);
+            fflush(stdout);
+
+            QCoreApplication::quit();
+        });
+    });
+
+    idleThread->start();
+
+    // The client threads may be blocked on the roundtrip, can't wait them
+    QTimer::singleShot(std::chrono::seconds(seconds * 2 + 60), &app, [] {
+        qFatal("Timeout, the clients aren't finished");
+    });
+
+    int exitCode = app.exec();
+
+    idleThread->wait();
+    for (auto client : std::as_const(idleClients))
+        disconnectIdleClient(client);
+    delete idleThread;
+    qDeleteAll(chattyThreads);
+
+    return exitCode;
+}
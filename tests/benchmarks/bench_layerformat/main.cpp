@@ -0,0 +1,277 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Render an animated item in a WOutputLayer on a headless output, print the
+// negotiated format of the layer's buffer and the time of each frame, e.g.
+//   bench_layerformat
+//   bench_layerformat --formats XRGB2101010,ARGB8888
+//   bench_layerformat --formats ABGR16161616F --opaque
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputlayer.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QTimer>
+
+#include <algorithm>
+#include <drm_fourcc.h>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static const char contentsQml[] = R"(
+import QtQuick
+
+Rectangle {
+    gradient: Gradient {
+        GradientStop { position: 0.0; color: "#202020" }
+        GradientStop { position: 1.0; color: "#e0e0e0" }
+    }
+
+    Rectangle {
+        width: parent.width / 4
+        height: parent.height / 4
+        anchors.centerIn: parent
+        color: "steelblue"
+
+        RotationAnimation on rotation {
+            from: 0
+            to: 360
+            duration: 2000
+            loops: Animation.Infinite
+        }
+    }
+}
+)";
+
+static const struct {
+    const char *name;
+    uint32_t format;
+} formatNames[] = {
+    {"ARGB8888", DRM_FORMAT_ARGB8888},
+    {"XRGB8888", DRM_FORMAT_XRGB8888},
+    {"ABGR8888", DRM_FORMAT_ABGR8888},
+    {"XBGR8888", DRM_FORMAT_XBGR8888},
+    {"ARGB2101010", DRM_FORMAT_ARGB2101010},
+    {"XRGB2101010", DRM_FORMAT_XRGB2101010},
+    {"ABGR2101010", DRM_FORMAT_ABGR2101010},
+    {"XBGR2101010", DRM_FORMAT_XBGR2101010},
+    {"ABGR16161616", DRM_FORMAT_ABGR16161616},
+    {"XBGR16161616", DRM_FORMAT_XBGR16161616},
+    {"ARGB16161616F", DRM_FORMAT_ARGB16161616F},
+    {"ABGR16161616F", DRM_FORMAT_ABGR16161616F},
+    {"RGB565", DRM_FORMAT_RGB565},
+};
+
+static uint32_t formatFromName(const QString &name)
+{
+    for (const auto &i : formatNames) {
+        if (name.compare(QLatin1String(i.name), Qt::CaseInsensitive) == 0)
+            return i.format;
+    }
+
+    bool ok = false;
+    const uint32_t format = name.toUInt(&ok, 16);
+    return ok ? format : DRM_FORMAT_INVALID;
+}
+
+static QByteArray formatName(uint32_t format)
+{
+    for (const auto &i : formatNames) {
+        if (i.format == format)
+            return i.name;
+    }
+
+    return "0x" + QByteArray::number(format, 16);
+}
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void enableOutput(WOutput *output)
+{
+    auto qwoutput = output->handle();
+    qw_output_state newState;
+
+    if (!qwoutput->handle()->current_mode) {
+        if (auto mode = qwoutput->preferred_mode())
+            newState.set_mode(mode);
+    }
+    newState.set_enabled(true);
+    bool ok = qwoutput->commit_state(newState);
+    Q_ASSERT(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption formatsOption("formats", "The preferred formats of the layer, separated by commas.",
+                                     "formats", "XRGB2101010");
+    QCommandLineOption opaqueOption("opaque", "Set the NoAlpha flag of the layer.");
+    QCommandLineOption framesOption("frames", "The number of the frames to measure.", "count", "300");
+    QCommandLineOption widthOption("width", "The width of the output.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "The height of the output.", "pixels", "1080");
+    parser.addOptions({formatsOption, opaqueOption, framesOption, widthOption, heightOption});
+    parser.process(app);
+
+    QList<quint32> formats;
+    for (const auto &name : parser.value(formatsOption).split(',', Qt::SkipEmptyParts)) {
+        const auto format = formatFromName(name.trimmed());
+        if (format == DRM_FORMAT_INVALID)
+            qFatal("Unknown format: %s", qPrintable(name));
+        formats.append(format);
+    }
+
+    const int frameCount = std::max(1, parser.value(framesOption).toInt());
+    const QSize outputSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width());
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(contentsQml, QUrl());
+    if (component.isError())
+        qFatal("%s", qPrintable(component.errorString()));
+
+    auto contents = qobject_cast<QQuickItem*>(component.create());
+    Q_ASSERT(contents);
+    contents->setParent(&window);
+    contents->setParentItem(window.contentItem());
+    contents->setSize(outputSize / 2);
+    contents->setPosition(QPointF(outputSize.width() / 4, outputSize.height() / 4));
+
+    auto layer = new WOutputLayer(contents);
+    layer->setFormats(formats);
+    if (parser.isSet(opaqueOption))
+        layer->setFlags(WOutputLayer::NoAlpha);
+    // The headless output has no hardware layers, keep the layer in the software composite
+    layer->setKeepLayer(true);
+
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        auto viewport = new WOutputViewport(window.contentItem());
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+
+        layer->setOutputs({viewport});
+        layer->setEnabled(true);
+
+        enableOutput(output);
+    });
+
+    backend->handle()->start();
+
+    auto headless = findHeadlessBackend(backend->handle());
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    QList<qint64> frameTimes;
+    frameTimes.reserve(frameCount);
+    QElapsedTimer frameTimer;
+
+    QObject::connect(&window, &WOutputRenderWindow::beforeRendering, &window, [&] {
+        frameTimer.start();
+    }, Qt::DirectConnection);
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &window, [&] {
+        if (!frameTimer.isValid())
+            return;
+        frameTimes.append(frameTimer.nsecsElapsed());
+        frameTimer.invalidate();
+
+        if (frameTimes.size() < frameCount)
+            return;
+
+        std::sort(frameTimes.begin(), frameTimes.end());
+        qint64 sum = 0;
+        for (auto t : std::as_const(frameTimes))
+            sum += t;
+
+        QByteArrayList preferred;
+        for (auto format : std::as_const(formats))
+            preferred << formatName(format);
+
+        const auto toMs = [] (qint64 nsecs) { return nsecs / 1000000.0; };
+        printf("preferred: %s, opaque: %s, renderer: %s\n",
+               preferred.isEmpty() ? "<default>" : preferred.join(',').constData(),
+               parser.isSet(opaqueOption) ? "yes" : "no", qgetenv("WLR_RENDERER").constData());
+        printf("negotiated format: %s\n", formatName(layer->renderFormat()).constData());
+        printf("frames: %lld, mean: %.3f ms, median: %.3f ms, p95: %.3f ms, max: %.3f ms\n",
+               qint64(frameTimes.size()), toMs(sum / frameTimes.size()),
+               toMs(frameTimes.at(frameTimes.size() / 2)),
+               toMs(frameTimes.at(frameTimes.size() * 95 / 100)),
+               toMs(frameTimes.last()));
+        fflush(stdout);
+
+        QCoreApplication::exit(layer->renderFormat() ? 0 : 1);
+    });
+
+    // Avoid to wait forever if the output can't be rendered
+    QTimer::singleShot(std::chrono::minutes(5), &app, [] {
+        qCritical("Timeout, the frames aren't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    return app.exec();
+}
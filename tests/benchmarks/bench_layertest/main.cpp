@@ -0,0 +1,244 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Render some items in the WOutputLayers on a headless output, print the test
+// commits of the hardware layers and how many of them are answered by the cache,
+// e.g. compare the result of:
+//   bench_layertest --layers 4
+//   bench_layertest --layers 4 --move
+//   bench_layertest --layers 4 --no-cache
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <woutputlayer.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QTimer>
+
+#include <algorithm>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+// The contents of the layer is changed in every frame, but its geometry isn't
+static const char layerQml[] = R"(
+import QtQuick
+
+Rectangle {
+    color: "steelblue"
+
+    Rectangle {
+        width: parent.width / 2
+        height: parent.height / 2
+        anchors.centerIn: parent
+        color: "orange"
+
+        RotationAnimation on rotation {
+            from: 0
+            to: 360
+            duration: 2000
+            loops: Animation.Infinite
+        }
+    }
+}
+)";
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void enableOutput(WOutput *output)
+{
+    auto qwoutput = output->handle();
+    qw_output_state newState;
+
+    if (!qwoutput->handle()->current_mode) {
+        if (auto mode = qwoutput->preferred_mode())
+            newState.set_mode(mode);
+    }
+    newState.set_enabled(true);
+    bool ok = qwoutput->commit_state(newState);
+    Q_ASSERT(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption layersOption("layers", "The number of the output layers.", "count", "4");
+    QCommandLineOption framesOption("frames", "The number of the frames to measure.", "count", "300");
+    QCommandLineOption moveOption("move", "Move the layers in every frame, the test result can't be reused.");
+    QCommandLineOption noCacheOption("no-cache", "Set WAYLIB_DISABLE_LAYER_TEST_CACHE.");
+    parser.addOptions({layersOption, framesOption, moveOption, noCacheOption});
+    parser.process(app);
+
+    if (parser.isSet(noCacheOption))
+        qputenv("WAYLIB_DISABLE_LAYER_TEST_CACHE", "1");
+
+    const int layerCount = std::max(1, parser.value(layersOption).toInt());
+    const int frameCount = std::max(1, parser.value(framesOption).toInt());
+    const bool move = parser.isSet(moveOption);
+    const QSize outputSize(1920, 1080);
+    const QSizeF layerSize(outputSize.width() / (layerCount + 1), outputSize.height() / 4);
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width());
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(layerQml, QUrl());
+    if (component.isError())
+        qFatal("%s", qPrintable(component.errorString()));
+
+    QList<QQuickItem*> items;
+    QList<WOutputLayer*> layers;
+    for (int i = 0; i < layerCount; ++i) {
+        auto item = qobject_cast<QQuickItem*>(component.create());
+        Q_ASSERT(item);
+        item->setParent(&window);
+        item->setParentItem(window.contentItem());
+        item->setSize(layerSize);
+        item->setPosition(QPointF(layerSize.width() * (i + 0.5), outputSize.height() / 3.0));
+        items << item;
+
+        auto layer = new WOutputLayer(item);
+        layer->setZ(i);
+        // The headless output may reject the layers, keep them in the software composite
+        layer->setKeepLayer(true);
+        layers << layer;
+    }
+
+    WOutputViewport *viewport = nullptr;
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        viewport = new WOutputViewport(window.contentItem());
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+
+        for (auto layer : std::as_const(layers)) {
+            layer->setOutputs({viewport});
+            layer->setEnabled(true);
+        }
+
+        enableOutput(output);
+    });
+
+    backend->handle()->start();
+
+    auto headless = findHeadlessBackend(backend->handle());
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    QList<qint64> frameTimes;
+    frameTimes.reserve(frameCount);
+    QElapsedTimer frameTimer;
+
+    QObject::connect(&window, &WOutputRenderWindow::beforeRendering, &window, [&] {
+        frameTimer.start();
+    }, Qt::DirectConnection);
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &window, [&] {
+        if (!frameTimer.isValid())
+            return;
+        frameTimes.append(frameTimer.nsecsElapsed());
+        frameTimer.invalidate();
+
+        if (move) {
+            const qreal offset = (frameTimes.size() % 2) ? 1 : -1;
+            for (auto item : std::as_const(items))
+                item->setY(item->y() + offset);
+        }
+
+        if (frameTimes.size() < frameCount)
+            return;
+
+        std::sort(frameTimes.begin(), frameTimes.end());
+        qint64 sum = 0;
+        for (auto t : std::as_const(frameTimes))
+            sum += t;
+
+        const auto stats = window.layerTestStats(viewport);
+        const auto toMs = [] (qint64 nsecs) { return nsecs / 1000000.0; };
+        printf("layers: %d, move: %s, cache: %s, renderer: %s\n",
+               layerCount, move ? "yes" : "no",
+               qEnvironmentVariableIsSet("WAYLIB_DISABLE_LAYER_TEST_CACHE") ? "no" : "yes",
+               qgetenv("WLR_RENDERER").constData());
+        printf("tests: %llu, cache hits: %llu, composite fallbacks: %llu\n",
+               stats.value("tests").toULongLong(),
+               stats.value("cacheHits").toULongLong(),
+               stats.value("compositeFallbacks").toULongLong());
+        printf("frames: %lld, mean: %.3f ms, median: %.3f ms, p95: %.3f ms, max: %.3f ms\n",
+               qint64(frameTimes.size()), toMs(sum / frameTimes.size()),
+               toMs(frameTimes.at(frameTimes.size() / 2)),
+               toMs(frameTimes.at(frameTimes.size() * 95 / 100)),
+               toMs(frameTimes.last()));
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+
+    // Avoid to wait forever if the output can't be rendered
+    QTimer::singleShot(std::chrono::minutes(5), &app, [] {
+        qCritical("Timeout, the frames aren't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+namespace {
+
+struct ClientState
+{
+    bool frameDone = true;
+    int frames = 0;
+};
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto state = static_cast<ClientState*>(data);
+    state->frameDone = true;
+    ++state->frames;
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+} // namespace
+
+int runSurfaceClient(const char *socket, int width, int height, int seconds)
+{
+    ClientConnection connection;
+    ShmBuffer buffer;
+    if (!connectClient(socket, &connection) || !connection.compositor || !connection.shm
+        || !createShmBuffer(connection.shm, width, height, 0xff336699, &buffer)) {
+        disconnectClient(&connection);
+        return -1;
+    }
+
+    ClientState state;
+    auto surface = wl_compositor_create_surface(connection.compositor);
+    auto opaque = wl_compositor_create_region(connection.compositor);
+    wl_region_add(opaque, 0, 0, width, height);
+    wl_surface_set_opaque_region(surface, opaque);
+    wl_region_destroy(opaque);
+
+    const long long end = monotonicTime() + (long long)seconds * 1000000000;
+    bool ok = true;
+
+    for (long long now = monotonicTime(); ok && now < end; now = monotonicTime()) {
+        if (state.frameDone) {
+            state.frameDone = false;
+            auto callback = wl_surface_frame(surface);
+            wl_callback_add_listener(callback, &frameListener, &state);
+            commitShmBuffer(surface, &buffer);
+        }
+
+        // The occluded surface maybe never receives the frame callback
+        ok = dispatchClientEvents(connection.display, int((end - now) / 1000000) + 1);
+    }
+
+    wl_surface_destroy(surface);
+    destroyShmBuffer(&buffer);
+    disconnectClient(&connection);
+
+    return ok ? state.frames : -1;
+}
@@ -0,0 +1,12 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+// Show an opaque surface and commit a new frame on each frame callback for
+// the seconds, returns the count of the received frame callbacks, or -1 if
+// failed.
+int runSurfaceClient(const char *socket, int width, int height, int seconds);
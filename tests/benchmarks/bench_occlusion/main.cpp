@@ -0,0 +1,212 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Show two opaque client surfaces on a headless output, the second one covers
+// the first one entirely, and print the frame callbacks received by each
+// client, e.g. compare the result of:
+//   bench_occlusion
+//   bench_occlusion --no-culling
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSurface>
+#include <woutputlayout.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wsurfaceitem.h>
+#include <wsocket.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwcompositor.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+struct ChildProcess
+{
+    pid_t pid = -1;
+    int resultFd = -1;
+};
+
+static ChildProcess forkClient(const QByteArray &socket, QSize size, int seconds)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        return {};
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        const int frames = runSurfaceClient(socket.constData(), size.width(), size.height(), seconds);
+        write(fds[1], &frames, sizeof(frames));
+        _exit(0);
+    }
+
+    close(fds[1]);
+    return {pid, fds[0]};
+}
+
+static int readResult(const ChildProcess &child)
+{
+    int frames = -1;
+    if (read(child.resultFd, &frames, sizeof(frames)) != sizeof(frames))
+        frames = -1;
+    close(child.resultFd);
+    return frames;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption secondsOption("seconds", "The duration of the clients.", "seconds", "5");
+    QCommandLineOption keepaliveOption("keepalive", "WOutputRenderWindow::occludedFrameCallbackInterval.", "ms", "1000");
+    QCommandLineOption noCullingOption("no-culling", "Disable WOutputRenderWindow::occlusionCulling.");
+    parser.addOptions({secondsOption, keepaliveOption, noCullingOption});
+    parser.process(app);
+
+    const int seconds = std::max(1, parser.value(secondsOption).toInt());
+    const QSize outputSize(800, 600);
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    auto layout = new WOutputLayout(&server);
+
+    auto socket = new WSocket(false);
+    if (!socket->autoCreate())
+        qFatal("Failed to create socket");
+    server.addSocket(socket);
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+    auto compositor = qw_compositor::create(*server.handle(), 6, *renderer);
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width());
+    window.setHeight(outputSize.height());
+    window.setOcclusionCulling(!parser.isSet(noCullingOption));
+    window.setOccludedFrameCallbackInterval(parser.value(keepaliveOption).toInt());
+    window.init(renderer, allocator);
+
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        auto viewport = new WOutputViewport(window.contentItem());
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+        layout->add(output, QPoint(0, 0));
+
+        qw_output_state newState;
+        if (auto mode = output->handle()->preferred_mode())
+            newState.set_mode(mode);
+        newState.set_enabled(true);
+        bool ok = output->handle()->commit_state(newState);
+        Q_ASSERT(ok);
+    });
+
+    backend->handle()->start();
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle()->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+    if (!headless && wlr_backend_is_headless(backend->handle()->handle()))
+        headless = backend->handle()->handle();
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+    QList<ChildProcess> children;
+    QList<WSurfaceItemContent*> contents;
+
+    // The surfaces are stacked by the creation order, start the covering
+    // client after the surface of the first client is shown.
+    QObject::connect(compositor, &qw_compositor::notify_new_surface, &window, [&] (wlr_surface *handle) {
+        auto surface = new WSurface(qw_surface::from(handle), &window);
+        auto content = new WSurfaceItemContent(window.contentItem());
+        content->setSurface(surface);
+        contents.append(content);
+
+        if (contents.size() == 1)
+            children.append(forkClient(socketName, outputSize, seconds));
+    });
+    children.append(forkClient(socketName, outputSize, seconds));
+
+    // Keep serving the clients until they are exited
+    QTimer waitTimer;
+    waitTimer.setInterval(10);
+    QObject::connect(&waitTimer, &QTimer::timeout, &app, [&] {
+        if (children.size() < 2)
+            return;
+        for (const auto &child : std::as_const(children)) {
+            if (waitpid(child.pid, nullptr, WNOHANG) == 0)
+                return;
+        }
+        waitTimer.stop();
+
+        const int hiddenFrames = readResult(children.at(0));
+        const int coverFrames = readResult(children.at(1));
+        if (hiddenFrames < 0 || coverFrames < 0) {
+            qCritical("The clients are failed");
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        printf("occlusion culling: %s, keepalive interval: %d ms\n",
+               window.occlusionCulling() ? "yes" : "no", window.occludedFrameCallbackInterval());
+        printf("covered client: %d frame callbacks (%.1f per second)\n",
+               hiddenFrames, qreal(hiddenFrames) / seconds);
+        printf("covering client: %d frame callbacks (%.1f per second)\n",
+               coverFrames, qreal(coverFrames) / seconds);
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+    waitTimer.start();
+
+    QTimer::singleShot(std::chrono::seconds(seconds * 2 + 60), &app, [&children] {
+        for (const auto &child : std::as_const(children))
+            kill(child.pid, SIGKILL);
+        qFatal("Timeout, the clients aren't finished");
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,231 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Render the animated contents on some headless outputs, and print the time
+// of each frame of WOutputRenderWindow, e.g. compare the result of:
+//   bench_outputrender --outputs 1
+//   bench_outputrender --outputs 4
+//   bench_outputrender --outputs 4 --batched
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QTimer>
+
+#include <algorithm>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static const char contentsQml[] = R"(
+import QtQuick
+
+Item {
+    id: root
+    clip: true
+
+    Repeater {
+        model: 64
+
+        Rectangle {
+            required property int index
+
+            width: root.width / 6
+            height: root.height / 6
+            x: (index % 8) * root.width / 8
+            y: Math.floor(index / 8) * root.height / 8
+            radius: 12
+            color: Qt.hsla(index / 64, 0.6, 0.5, 0.8)
+
+            RotationAnimation on rotation {
+                from: 0
+                to: 360
+                duration: 2000 + index * 20
+                loops: Animation.Infinite
+            }
+        }
+    }
+}
+)";
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void enableOutput(WOutput *output)
+{
+    auto qwoutput = output->handle();
+    qw_output_state newState;
+
+    if (!qwoutput->handle()->current_mode) {
+        if (auto mode = qwoutput->preferred_mode())
+            newState.set_mode(mode);
+    }
+    newState.set_enabled(true);
+    bool ok = qwoutput->commit_state(newState);
+    Q_ASSERT(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption outputsOption("outputs", "The number of the headless outputs.", "count", "4");
+    QCommandLineOption framesOption("frames", "The number of the frames to measure.", "count", "300");
+    QCommandLineOption widthOption("width", "The width of each output.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "The height of each output.", "pixels", "1080");
+    QCommandLineOption batchedOption("batched", "Enable WOutputRenderWindow::batchedRendering.");
+    parser.addOptions({outputsOption, framesOption, widthOption, heightOption, batchedOption});
+    parser.process(app);
+
+    const int outputCount = std::max(1, parser.value(outputsOption).toInt());
+    const int frameCount = std::max(1, parser.value(framesOption).toInt());
+    const QSize outputSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setBatchedRendering(parser.isSet(batchedOption));
+    window.setWidth(outputSize.width() * outputCount);
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(contentsQml, QUrl());
+    if (component.isError())
+        qFatal("%s", qPrintable(component.errorString()));
+
+    int viewportCount = 0;
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        auto contents = qobject_cast<QQuickItem*>(component.create());
+        Q_ASSERT(contents);
+        contents->setParent(&window);
+        contents->setParentItem(window.contentItem());
+        contents->setPosition(QPointF(viewportCount * outputSize.width(), 0));
+        contents->setSize(outputSize);
+
+        auto viewport = new WOutputViewport(window.contentItem());
+        viewport->setInput(contents);
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+        ++viewportCount;
+
+        enableOutput(output);
+    });
+
+    backend->handle()->start();
+
+    auto headless = findHeadlessBackend(backend->handle());
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    for (int i = 0; i < outputCount; ++i)
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    QList<qint64> frameTimes;
+    frameTimes.reserve(frameCount);
+    QElapsedTimer frameTimer;
+
+    QObject::connect(&window, &WOutputRenderWindow::beforeRendering, &window, [&] {
+        frameTimer.start();
+    }, Qt::DirectConnection);
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &window, [&] {
+        if (!frameTimer.isValid())
+            return;
+        frameTimes.append(frameTimer.nsecsElapsed());
+        frameTimer.invalidate();
+
+        if (frameTimes.size() < frameCount)
+            return;
+
+        std::sort(frameTimes.begin(), frameTimes.end());
+        qint64 sum = 0;
+        for (auto t : std::as_const(frameTimes))
+            sum += t;
+
+        const auto toMs = [] (qint64 nsecs) { return nsecs / 1000000.0; };
+        printf("outputs: %d, size: %dx%d, batched: %s, renderer: %s\n",
+               outputCount, outputSize.width(), outputSize.height(),
+               window.batchedRendering() ? "yes" : "no", qgetenv("WLR_RENDERER").constData());
+        printf("frames: %lld, mean: %.3f ms, median: %.3f ms, p95: %.3f ms, max: %.3f ms\n",
+               qint64(frameTimes.size()), toMs(sum / frameTimes.size()),
+               toMs(frameTimes.at(frameTimes.size() / 2)),
+               toMs(frameTimes.at(frameTimes.size() * 95 / 100)),
+               toMs(frameTimes.last()));
+        printf("mean per output: %.3f ms\n", toMs(sum / frameTimes.size() / outputCount));
+        // Accumulated since the window is created, includes the frames not measured
+        const auto timings = window.renderTimings();
+        const qint64 renderedFrames = std::max<qint64>(1, timings.value("frames").toLongLong());
+        const auto perFrame = [&] (const char *key) {
+            return toMs(timings.value(key).toLongLong() / renderedFrames);
+        };
+        printf("breakdown per frame: record: %.3f ms, wait: %.3f ms, submit: %.3f ms, commit: %.3f ms\n",
+               perFrame("record"), perFrame("wait"), perFrame("submit"), perFrame("commit"));
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+
+    // Avoid to wait forever if the outputs can't be rendered
+    QTimer::singleShot(std::chrono::minutes(5), &app, [] {
+        qCritical("Timeout, the frames aren't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,265 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Move a synthetic pointer at 1000Hz over a headless output full of hoverable
+// items, and print the CPU time spent per second and the latency from the
+// motion to the commit of the output, e.g. compare the result of:
+//   bench_pointermotion
+//   bench_pointermotion --coalesce
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSeat>
+#include <WCursor>
+#include <winputdevice.h>
+#include <woutputlayout.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <winputlatencystats.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QQmlEngine>
+#include <QQmlComponent>
+#include <QQuickItem>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <time.h>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/interfaces/wlr_pointer.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static const char contentsQml[] = R"(
+import QtQuick
+
+Grid {
+    columns: 20
+
+    Repeater {
+        model: 400
+
+        Rectangle {
+            width: 64
+            height: 48
+            color: area.containsMouse ? "steelblue" : "lightgray"
+
+            MouseArea {
+                id: area
+                anchors.fill: parent
+                hoverEnabled: true
+            }
+        }
+    }
+}
+)";
+
+static const wlr_pointer_impl benchPointerImpl = {
+    .name = "bench-pointer",
+};
+
+static qint64 processCpuTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+class MouseMoveCounter : public QObject
+{
+public:
+    using QObject::QObject;
+
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (event->type() == QEvent::MouseMove)
+            ++count;
+        return QObject::eventFilter(watched, event);
+    }
+
+    quint64 count = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption secondsOption("seconds", "The duration of the pointer motion.", "seconds", "5");
+    QCommandLineOption rateOption("rate", "The motion events per second.", "hz", "1000");
+    QCommandLineOption coalesceOption("coalesce", "Enable WSeat::coalescePointerMotion.");
+    parser.addOptions({secondsOption, rateOption, coalesceOption});
+    parser.process(app);
+
+    const int seconds = std::max(1, parser.value(secondsOption).toInt());
+    const int rate = std::clamp(parser.value(rateOption).toInt(), 1, 1000);
+    const QSize outputSize(1280, 960);
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    auto seat = server.attach<WSeat>();
+    auto layout = new WOutputLayout(&server);
+    auto cursor = new WCursor(&server);
+    seat->setCursor(cursor);
+    seat->setCoalescePointerMotion(parser.isSet(coalesceOption));
+    cursor->setLayout(layout);
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width());
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+    cursor->setEventWindow(&window);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(contentsQml, QUrl());
+    if (component.isError())
+        qFatal("%s", qPrintable(component.errorString()));
+
+    auto contents = qobject_cast<QQuickItem*>(component.create());
+    Q_ASSERT(contents);
+    contents->setParent(&window);
+    contents->setParentItem(window.contentItem());
+
+    WOutputViewport *viewport = nullptr;
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        viewport = new WOutputViewport(window.contentItem());
+        viewport->setInput(contents);
+        viewport->setOutput(output);
+        viewport->setSize(outputSize);
+        layout->add(output, QPoint(0, 0));
+
+        qw_output_state newState;
+        if (auto mode = output->handle()->preferred_mode())
+            newState.set_mode(mode);
+        newState.set_enabled(true);
+        bool ok = output->handle()->commit_state(newState);
+        Q_ASSERT(ok);
+    });
+    QObject::connect(backend, &WBackend::inputAdded, seat, [seat] (WInputDevice *device) {
+        seat->attachInputDevice(device);
+    });
+    QObject::connect(backend, &WBackend::inputRemoved, seat, [seat] (WInputDevice *device) {
+        seat->detachInputDevice(device);
+    });
+
+    backend->handle()->start();
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle()->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+    if (!headless && wlr_backend_is_headless(backend->handle()->handle()))
+        headless = backend->handle()->handle();
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    // The headless backend has no input devices, add a pointer driven by the timer
+    wlr_pointer pointer;
+    wlr_pointer_init(&pointer, &benchPointerImpl, benchPointerImpl.name);
+    wl_signal_emit_mutable(&backend->handle()->handle()->events.new_input, &pointer.base);
+    seat->setCursorPosition(QPointF(outputSize.width() / 2 - 400, outputSize.height() / 2));
+
+    MouseMoveCounter counter;
+    window.installEventFilter(&counter);
+
+    quint64 motions = 0;
+    qint64 cpuTimeBegin = 0;
+    QPointF lastPos(-400, 0);
+    QTimer motionTimer;
+    motionTimer.setTimerType(Qt::PreciseTimer);
+    motionTimer.setInterval(1000 / rate);
+    QObject::connect(&motionTimer, &QTimer::timeout, &app, [&] {
+        if (motions == 0) {
+            cpuTimeBegin = processCpuTime();
+            counter.count = 0;
+            window.inputLatency(viewport)->reset();
+        }
+
+        // Circle around the center of the output, one turn per second
+        const qreal angle = 2 * M_PI * (motions % rate) / rate;
+        const QPointF pos(-std::cos(angle) * 400, std::sin(angle) * 300);
+        const QPointF delta = pos - lastPos;
+        lastPos = pos;
+        ++motions;
+
+        wlr_pointer_motion_event event = {
+            .pointer = &pointer,
+            .time_msec = uint32_t(motions * 1000 / rate),
+            .delta_x = delta.x(),
+            .delta_y = delta.y(),
+            .unaccel_dx = delta.x(),
+            .unaccel_dy = delta.y(),
+        };
+        wl_signal_emit_mutable(&pointer.events.motion, &event);
+        wl_signal_emit_mutable(&pointer.events.frame, &pointer);
+
+        if (motions < quint64(seconds) * rate)
+            return;
+
+        motionTimer.stop();
+        const qint64 cpuTime = processCpuTime() - cpuTimeBegin;
+        printf("coalesce: %s, renderer: %s\n", seat->coalescePointerMotion() ? "yes" : "no",
+               qgetenv("WLR_RENDERER").constData());
+        printf("motions: %llu, mouse move events: %llu, cpu time: %.3f ms per second\n",
+               motions, counter.count, cpuTime / 1000000.0 / seconds);
+        const auto latency = window.inputLatency(viewport);
+        printf("input latency: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms, frames: %llu\n",
+               latency->p50(), latency->p95(), latency->p99(), latency->max(), latency->samples());
+        fflush(stdout);
+
+        QCoreApplication::quit();
+    });
+
+    // Start after the first frame, don't measure the startup
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &motionTimer, [&] {
+        if (!motionTimer.isActive() && motions == 0)
+            motionTimer.start();
+    });
+
+    QTimer::singleShot(std::chrono::seconds(seconds * 10 + 30), &app, [] {
+        qCritical("Timeout, the output isn't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    int exitCode = app.exec();
+    wlr_pointer_finish(&pointer);
+
+    return exitCode;
+}
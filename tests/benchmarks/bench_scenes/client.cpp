@@ -0,0 +1,331 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Rect
+{
+    int x, y, width, height;
+};
+
+struct ClientState
+{
+    ClientConnection connection;
+    int frames = 0;
+};
+
+struct Window
+{
+    int index = 0;
+    ClientState *state = nullptr;
+    int width = 0;
+    int height = 0;
+    DamagePattern damage = DamagePattern::Full;
+
+    wl_surface *surface = nullptr;
+    xdg_surface *xdgSurface = nullptr;
+    xdg_toplevel *toplevel = nullptr;
+    bool configured = false;
+    bool frameDone = false;
+    int frame = 0;
+    // Triple buffering, the buffer may be still used by the compositor
+    ShmBuffer buffers[3];
+
+    wl_surface *childSurface = nullptr;
+    wl_subsurface *subsurface = nullptr;
+    ShmBuffer childBuffer;
+
+    wl_surface *popupSurface = nullptr;
+    xdg_surface *popupXdgSurface = nullptr;
+    xdg_popup *popup = nullptr;
+    ShmBuffer popupBuffer;
+};
+
+// The damage of the frames is only decided by the index of the window and
+// the frame, so the scenes are reproducible.
+std::vector<Rect> frameDamage(const Window &window)
+{
+    const int width = window.width;
+    const int height = window.height;
+
+    // The whole contents of the new window are shown
+    if (window.frame == 0)
+        return {{0, 0, width, height}};
+
+    switch (window.damage) {
+    case DamagePattern::Full:
+        return {{0, 0, width, height}};
+    case DamagePattern::Partial: {
+        const int blockWidth = std::max(1, width / 8);
+        const int blockHeight = std::max(1, height / 8);
+        return {{(window.frame * 8) % std::max(1, width - blockWidth),
+                 (window.frame * 3 + window.index * 16) % std::max(1, height - blockHeight),
+                 blockWidth, blockHeight}};
+    }
+    case DamagePattern::Scattered: {
+        const int blockWidth = std::max(1, width / 16);
+        const int blockHeight = std::max(1, height / 16);
+        uint32_t seed = uint32_t(window.index) * 7919u + uint32_t(window.frame) * 104729u + 1;
+        std::vector<Rect> rects;
+        for (int i = 0; i < 8; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            const int x = int((seed >> 8) % uint32_t(std::max(1, width - blockWidth)));
+            seed = seed * 1664525u + 1013904223u;
+            const int y = int((seed >> 8) % uint32_t(std::max(1, height - blockHeight)));
+            rects.push_back({x, y, blockWidth, blockHeight});
+        }
+        return rects;
+    }
+    }
+
+    return {};
+}
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto window = static_cast<Window*>(data);
+    window->frameDone = true;
+    ++window->state->frames;
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+// Returns false if all buffers are used by the compositor
+bool commitFrame(Window &window)
+{
+    auto buffer = std::find_if(std::begin(window.buffers), std::end(window.buffers),
+                               [] (const ShmBuffer &buffer) { return !buffer.busy; });
+    if (buffer == std::end(window.buffers))
+        return false;
+
+    // The undamaged area of the reused buffer is stale, it doesn't matter for
+    // the benchmark, the compositor only reads the damaged area
+    const uint32_t color = 0xff000000 | ((uint32_t(window.frame) * 0x010305u
+                                          + uint32_t(window.index) * 0x203040u) & 0xffffff);
+    for (const auto &rect : frameDamage(window)) {
+        fillShmBuffer(buffer, rect.x, rect.y, rect.width, rect.height, color);
+        wl_surface_damage(window.surface, rect.x, rect.y, rect.width, rect.height);
+    }
+
+    auto callback = wl_surface_frame(window.surface);
+    wl_callback_add_listener(callback, &frameListener, &window);
+    wl_surface_attach(window.surface, buffer->handle, 0, 0);
+    wl_surface_commit(window.surface);
+
+    buffer->busy = true;
+    window.frameDone = false;
+    ++window.frame;
+
+    return true;
+}
+
+void handlePopupSurfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+{
+    auto window = static_cast<Window*>(data);
+    xdg_surface_ack_configure(xdgSurface, serial);
+
+    if (!window->popupBuffer.busy)
+        commitShmBuffer(window->popupSurface, &window->popupBuffer);
+    else
+        wl_surface_commit(window->popupSurface);
+}
+
+const xdg_surface_listener popupSurfaceListener = {
+    .configure = handlePopupSurfaceConfigure,
+};
+
+void handlePopupConfigure(void *, xdg_popup *, int32_t, int32_t, int32_t, int32_t)
+{
+}
+
+void handlePopupDone(void *, xdg_popup *)
+{
+}
+
+const xdg_popup_listener popupListener = {
+    .configure = handlePopupConfigure,
+    .popup_done = handlePopupDone,
+};
+
+bool createPopup(Window &window)
+{
+    const int width = std::max(1, window.width / 3);
+    const int height = std::max(1, window.height / 2);
+    if (!createShmBuffer(window.state->connection.shm, width, height, 0xffe0e0e0, &window.popupBuffer))
+        return false;
+
+    window.popupSurface = wl_compositor_create_surface(window.state->connection.compositor);
+    window.popupXdgSurface = xdg_wm_base_get_xdg_surface(window.state->connection.wmBase, window.popupSurface);
+    xdg_surface_add_listener(window.popupXdgSurface, &popupSurfaceListener, &window);
+
+    // Like a context menu near the right edge, it's partly out of the window
+    auto positioner = xdg_wm_base_create_positioner(window.state->connection.wmBase);
+    xdg_positioner_set_size(positioner, width, height);
+    xdg_positioner_set_anchor_rect(positioner, std::max(0, window.width - 32), 32, 1, 1);
+    xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_TOP_LEFT);
+    xdg_positioner_set_gravity(positioner, XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+    window.popup = xdg_surface_get_popup(window.popupXdgSurface, window.xdgSurface, positioner);
+    xdg_positioner_destroy(positioner);
+    xdg_popup_add_listener(window.popup, &popupListener, &window);
+    wl_surface_commit(window.popupSurface);
+
+    return true;
+}
+
+bool createSubsurface(Window &window)
+{
+    const int width = std::max(1, window.width / 4);
+    const int height = std::max(1, window.height / 4);
+    if (!window.state->connection.subcompositor
+        || !createShmBuffer(window.state->connection.shm, width, height, 0xff406080, &window.childBuffer)) {
+        return false;
+    }
+
+    // Like a toolbar at the top right corner of the window
+    window.childSurface = wl_compositor_create_surface(window.state->connection.compositor);
+    window.subsurface = wl_subcompositor_get_subsurface(window.state->connection.subcompositor,
+                                                        window.childSurface, window.surface);
+    wl_subsurface_set_position(window.subsurface, window.width - width - 16, 16);
+    // Applied with the next commit of the parent surface
+    commitShmBuffer(window.childSurface, &window.childBuffer);
+
+    return true;
+}
+
+void handleSurfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+{
+    auto window = static_cast<Window*>(data);
+    xdg_surface_ack_configure(xdgSurface, serial);
+    if (window->configured)
+        return;
+
+    window->configured = true;
+    window->frameDone = true;
+}
+
+const xdg_surface_listener surfaceListener = {
+    .configure = handleSurfaceConfigure,
+};
+
+void handleToplevelConfigure(void *, xdg_toplevel *, int32_t, int32_t, wl_array *)
+{
+    // Keep the size of the options, the compositor doesn't resize it
+}
+
+void handleToplevelClose(void *, xdg_toplevel *)
+{
+}
+
+const xdg_toplevel_listener toplevelListener = {
+    .configure = handleToplevelConfigure,
+    .close = handleToplevelClose,
+};
+
+bool createWindow(Window &window)
+{
+    for (auto &buffer : window.buffers) {
+        if (!createShmBuffer(window.state->connection.shm, window.width, window.height, 0xff336699, &buffer))
+            return false;
+    }
+
+    window.surface = wl_compositor_create_surface(window.state->connection.compositor);
+    window.xdgSurface = xdg_wm_base_get_xdg_surface(window.state->connection.wmBase, window.surface);
+    xdg_surface_add_listener(window.xdgSurface, &surfaceListener, &window);
+    window.toplevel = xdg_surface_get_toplevel(window.xdgSurface);
+    xdg_toplevel_add_listener(window.toplevel, &toplevelListener, &window);
+    xdg_toplevel_set_title(window.toplevel, "bench_scenes");
+    // The initial commit without buffer, wait for the configure
+    wl_surface_commit(window.surface);
+
+    return true;
+}
+
+void destroyWindow(Window &window)
+{
+    if (window.popup)
+        xdg_popup_destroy(window.popup);
+    if (window.popupXdgSurface)
+        xdg_surface_destroy(window.popupXdgSurface);
+    if (window.popupSurface)
+        wl_surface_destroy(window.popupSurface);
+    destroyShmBuffer(&window.popupBuffer);
+
+    if (window.subsurface)
+        wl_subsurface_destroy(window.subsurface);
+    if (window.childSurface)
+        wl_surface_destroy(window.childSurface);
+    destroyShmBuffer(&window.childBuffer);
+
+    if (window.toplevel)
+        xdg_toplevel_destroy(window.toplevel);
+    if (window.xdgSurface)
+        xdg_surface_destroy(window.xdgSurface);
+    if (window.surface)
+        wl_surface_destroy(window.surface);
+    for (auto &buffer : window.buffers)
+        destroyShmBuffer(&buffer);
+}
+
+} // namespace
+
+int runSceneClient(const char *socket, const SceneClientOptions &options,
+                   const std::atomic<bool> &quit)
+{
+    ClientState state;
+    bool ok = connectClient(socket, &state.connection) && state.connection.compositor
+              && state.connection.shm && state.connection.wmBase;
+
+    // The address of the window is used by the listeners, don't move it
+    std::vector<std::unique_ptr<Window>> windows;
+    for (int i = 0; ok && i < options.windows; ++i) {
+        auto window = std::make_unique<Window>();
+        window->index = i;
+        window->state = &state;
+        window->width = options.width;
+        window->height = options.height;
+        window->damage = options.damage;
+        ok = createWindow(*window);
+        windows.push_back(std::move(window));
+    }
+
+    while (ok && !quit.load(std::memory_order_relaxed)) {
+        for (auto &window : windows) {
+            if (!window->configured || !window->frameDone)
+                continue;
+
+            if (options.subsurface && !window->subsurface && !createSubsurface(*window)) {
+                ok = false;
+                break;
+            }
+            // Retry after a buffer is released
+            if (!commitFrame(*window))
+                continue;
+            // The parent of the popup must be mapped
+            if (options.popup && !window->popup && !createPopup(*window)) {
+                ok = false;
+                break;
+            }
+        }
+
+        // Wake up to check the quit even if no events
+        if (ok)
+            ok = dispatchClientEvents(state.connection.display, 100);
+    }
+
+    for (auto &window : windows)
+        destroyWindow(*window);
+    disconnectClient(&state.connection);
+
+    return ok ? state.frames : -1;
+}
@@ -0,0 +1,35 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+#include <atomic>
+
+enum class DamagePattern {
+    // Redraw the whole window in each frame, e.g. a video player
+    Full,
+    // Redraw a small block moving in the window, e.g. a blinking cursor
+    Partial,
+    // Redraw some small blocks spread in the window, e.g. a list updating
+    Scattered,
+};
+
+struct SceneClientOptions
+{
+    int windows = 1;
+    int width = 400;
+    int height = 300;
+    DamagePattern damage = DamagePattern::Full;
+    // A static subsurface and a static xdg popup for each window
+    bool subsurface = false;
+    bool popup = false;
+};
+
+// Show the xdg toplevel windows and commit a new frame to each one on its
+// frame callback until the quit is set, returns the count of the received
+// frame callbacks, or -1 if failed. It's safe to run in a thread.
+int runSceneClient(const char *socket, const SceneClientOptions &options,
+                   const std::atomic<bool> &quit);
@@ -0,0 +1,512 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Render a reproducible scene of the xdg windows on the headless outputs, the
+// windows are shown by the synthetic clients in the threads of this process,
+// and print the time of the frames, the CPU time and the allocations of the
+// compositor thread as JSON, e.g.
+//   bench_scenes --scene many-windows
+//   bench_scenes --scene fullscreen-video --frames 600
+//   bench_scenes --scene blur --blur-radius 64
+//   bench_scenes --scene multi-output --outputs 4 --damage full
+//   WLR_RENDERER=vulkan bench_scenes --scene blur --output blur.json
+// Run it with the same options before and after a change to compare.
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSurface>
+#include <WXdgShell>
+#include <woutputlayout.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wrenderbufferblitter.h>
+#include <wsocket.h>
+#include <wxdgpopupsurface.h>
+#include <wxdgtoplevelsurface.h>
+#include <wxdgpopupsurfaceitem.h>
+#include <wxdgtoplevelsurfaceitem.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwcompositor.h>
+#include <qwsubcompositor.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <time.h>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+// Count the allocations of each thread, the allocations of the clients are in
+// their own threads. All of Qt, wlroots, pixman and operator new allocate by
+// malloc, so only count malloc, calloc and realloc, the memory is still
+// managed by glibc.
+static thread_local quint64 allocationCount = 0;
+static thread_local quint64 allocationBytes = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size) noexcept;
+void *__libc_calloc(size_t count, size_t size) noexcept;
+void *__libc_realloc(void *ptr, size_t size) noexcept;
+
+void *malloc(size_t size) noexcept
+{
+    ++allocationCount;
+    allocationBytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    ++allocationCount;
+    allocationBytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept
+{
+    ++allocationCount;
+    allocationBytes += size;
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+struct Scene
+{
+    const char *name;
+    int outputs;
+    int windows;
+    // Empty is the size of the output
+    QSize windowSize;
+    DamagePattern damage;
+    bool subsurfaces;
+    bool popups;
+    qreal blurRadius;
+};
+
+static const Scene scenes[] = {
+    // Overlapped windows, each one has a toolbar and a menu
+    { "many-windows", 1, 32, QSize(480, 360), DamagePattern::Partial, true, true, 0 },
+    // A video player with a control bar
+    { "fullscreen-video", 1, 1, QSize(), DamagePattern::Full, true, false, 0 },
+    // Some windows behind a blurred panel
+    { "blur", 1, 8, QSize(640, 480), DamagePattern::Partial, false, false, 32 },
+    // The windows across the outputs
+    { "multi-output", 3, 12, QSize(800, 600), DamagePattern::Scattered, true, true, 0 },
+};
+
+static const char *damageNames[] = { "full", "partial", "scattered" };
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void enableOutput(WOutput *output)
+{
+    auto qwoutput = output->handle();
+    qw_output_state newState;
+
+    if (!qwoutput->handle()->current_mode) {
+        if (auto mode = qwoutput->preferred_mode())
+            newState.set_mode(mode);
+    }
+    newState.set_enabled(true);
+    bool ok = qwoutput->commit_state(newState);
+    Q_ASSERT(ok);
+}
+
+static qint64 threadCpuTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+static double toMs(qint64 nsecs)
+{
+    return nsecs / 1000000.0;
+}
+
+// The nearest-rank percentile of the sorted values
+static qint64 percentile(const QList<qint64> &sorted, int p)
+{
+    const qsizetype rank = qsizetype(std::ceil(sorted.size() * p / 100.0));
+    return sorted.at(std::clamp<qsizetype>(rank - 1, 0, sorted.size() - 1));
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("WLR_BACKENDS"))
+        qputenv("WLR_BACKENDS", "headless");
+    if (!qEnvironmentVariableIsSet("WLR_RENDERER"))
+        qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QStringList sceneNames;
+    for (const auto &scene : scenes)
+        sceneNames.append(scene.name);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption sceneOption("scene", "The scene to render: " + sceneNames.join(", ") + ".",
+                                   "name", scenes[0].name);
+    QCommandLineOption framesOption("frames", "The number of the frames to measure.", "count", "300");
+    QCommandLineOption warmupOption("warmup", "The number of the frames to skip after the windows are shown.", "count", "30");
+    QCommandLineOption outputsOption("outputs", "The number of the headless outputs, overrides the scene.", "count");
+    QCommandLineOption widthOption("width", "The width of each output.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "The height of each output.", "pixels", "1080");
+    QCommandLineOption windowsOption("windows", "The number of the windows, overrides the scene.", "count");
+    QCommandLineOption damageOption("damage", "The damage of the windows in each frame: full, partial or scattered, overrides the scene.", "pattern");
+    QCommandLineOption noSubsurfacesOption("no-subsurfaces", "Don't show the subsurfaces.");
+    QCommandLineOption noPopupsOption("no-popups", "Don't show the popups.");
+    QCommandLineOption blurRadiusOption("blur-radius", "The blur radius of the panel, 0 is no panel, overrides the scene.", "radius");
+    QCommandLineOption outputOption("output", "Write the result to the file instead of stdout.", "file");
+    parser.addOptions({sceneOption, framesOption, warmupOption, outputsOption, widthOption, heightOption,
+                       windowsOption, damageOption, noSubsurfacesOption, noPopupsOption,
+                       blurRadiusOption, outputOption});
+    parser.process(app);
+
+    const auto sceneIt = std::find_if(std::begin(scenes), std::end(scenes), [&] (const Scene &scene) {
+        return parser.value(sceneOption) == QLatin1String(scene.name);
+    });
+    if (sceneIt == std::end(scenes))
+        qFatal("Invalid scene: %s", qPrintable(parser.value(sceneOption)));
+    Scene scene = *sceneIt;
+
+    if (parser.isSet(outputsOption))
+        scene.outputs = parser.value(outputsOption).toInt();
+    if (parser.isSet(windowsOption))
+        scene.windows = parser.value(windowsOption).toInt();
+    if (parser.isSet(damageOption)) {
+        const auto it = std::find(std::begin(damageNames), std::end(damageNames), parser.value(damageOption));
+        if (it == std::end(damageNames))
+            qFatal("Invalid damage pattern: %s", qPrintable(parser.value(damageOption)));
+        scene.damage = DamagePattern(it - std::begin(damageNames));
+    }
+    if (parser.isSet(noSubsurfacesOption))
+        scene.subsurfaces = false;
+    if (parser.isSet(noPopupsOption))
+        scene.popups = false;
+    if (parser.isSet(blurRadiusOption))
+        scene.blurRadius = parser.value(blurRadiusOption).toDouble();
+
+    const int frameCount = std::max(1, parser.value(framesOption).toInt());
+    const int warmupFrames = std::max(0, parser.value(warmupOption).toInt());
+    const QSize outputSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+    scene.outputs = std::max(1, scene.outputs);
+    scene.windows = std::max(1, scene.windows);
+    if (scene.windowSize.isEmpty())
+        scene.windowSize = outputSize;
+
+    WServer server;
+    auto backend = server.attach<WBackend>();
+    auto xdgShell = server.attach<WXdgShell>(5);
+    auto layout = new WOutputLayout(&server);
+
+    auto socket = new WSocket(false);
+    if (!socket->autoCreate())
+        qFatal("Failed to create socket");
+    server.addSocket(socket);
+    server.start();
+
+    auto renderer = WRenderHelper::createRenderer(backend->handle());
+    if (!renderer)
+        qFatal("Failed to create renderer");
+    auto allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+    renderer->init_wl_display(*server.handle());
+    qw_compositor::create(*server.handle(), 6, *renderer);
+    qw_subcompositor::create(*server.handle());
+
+    WOutputRenderWindow window;
+    window.setWidth(outputSize.width() * scene.outputs);
+    window.setHeight(outputSize.height());
+    window.init(renderer, allocator);
+
+    // The windows are spread on all outputs by their index, some ones are
+    // overlapped or across the outputs.
+    const QSize desktopSize(window.width(), window.height());
+    const auto windowPosition = [&] (int index) {
+        if (scene.windowSize == outputSize)
+            return QPointF(0, 0);
+        return QPointF((index * 347) % std::max(1, desktopSize.width() - scene.windowSize.width()),
+                       (index * 149) % std::max(1, desktopSize.height() - scene.windowSize.height()));
+    };
+
+    auto desktop = new QQuickItem(window.contentItem());
+    desktop->setSize(desktopSize);
+
+    QHash<WSurface*, WSurfaceItem*> surfaceItems;
+    int toplevelCount = 0;
+    int popupCount = 0;
+
+    QObject::connect(xdgShell, &WXdgShell::toplevelSurfaceAdded, &window, [&] (WXdgToplevelSurface *surface) {
+        auto item = new WXdgToplevelSurfaceItem(desktop);
+        item->setShellSurface(surface);
+        item->setPosition(windowPosition(toplevelCount++));
+        surfaceItems.insert(surface->surface(), item);
+    });
+    QObject::connect(xdgShell, &WXdgShell::toplevelSurfaceRemoved, &window, [&] (WXdgToplevelSurface *surface) {
+        if (auto item = surfaceItems.take(surface->surface()))
+            item->deleteLater();
+    });
+    QObject::connect(xdgShell, &WXdgShell::popupSurfaceAdded, &window, [&] (WXdgPopupSurface *surface) {
+        auto parent = surfaceItems.value(surface->parentSurface());
+        Q_ASSERT(parent);
+        auto item = new WXdgPopupSurfaceItem(parent);
+        item->setShellSurface(surface);
+        QObject::connect(item, &WXdgPopupSurfaceItem::implicitPositionChanged, item, [item] {
+            item->setPosition(item->implicitPosition());
+        });
+        item->setPosition(item->implicitPosition());
+        surfaceItems.insert(surface->surface(), item);
+        ++popupCount;
+    });
+    QObject::connect(xdgShell, &WXdgShell::popupSurfaceRemoved, &window, [&] (WXdgPopupSurface *surface) {
+        if (auto item = surfaceItems.take(surface->surface()))
+            item->deleteLater();
+    });
+
+    if (scene.blurRadius > 0) {
+        auto blitter = new WRenderBufferBlitter(window.contentItem());
+        blitter->setSize(outputSize / 2);
+        blitter->setPosition(QPointF(outputSize.width() / 4, outputSize.height() / 4));
+        blitter->setZ(1);
+        blitter->setBlurRadius(scene.blurRadius);
+    }
+
+    int outputIndex = 0;
+    QObject::connect(backend, &WBackend::outputAdded, &window, [&] (WOutput *output) {
+        const QPoint position(outputIndex++ * outputSize.width(), 0);
+        auto viewport = new WOutputViewport(window.contentItem());
+        viewport->setOutput(output);
+        viewport->setPosition(position);
+        viewport->setSize(outputSize);
+        layout->add(output, position);
+
+        enableOutput(output);
+    });
+
+    backend->handle()->start();
+
+    auto headless = findHeadlessBackend(backend->handle());
+    if (!headless)
+        qFatal("The headless backend is not found, please set WLR_BACKENDS=headless");
+    for (int i = 0; i < scene.outputs; ++i)
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+    SceneClientOptions clientOptions;
+    clientOptions.windows = scene.windows;
+    clientOptions.width = scene.windowSize.width();
+    clientOptions.height = scene.windowSize.height();
+    clientOptions.damage = scene.damage;
+    clientOptions.subsurface = scene.subsurfaces;
+    clientOptions.popup = scene.popups;
+
+    const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+    std::atomic<bool> quitClient = false;
+    int clientFrames = -1;
+    auto clientThread = QThread::create([&] {
+        clientFrames = runSceneClient(socketName.constData(), clientOptions, quitClient);
+    });
+
+    int skippedFrames = 0;
+    bool measuring = false;
+    QList<qint64> frameTimes;
+    frameTimes.reserve(frameCount);
+    QElapsedTimer frameTimer;
+    qint64 beginCpuTime = 0;
+    qint64 cpuTime = 0;
+    quint64 beginAllocationCount = 0;
+    quint64 beginAllocationBytes = 0;
+    quint64 allocations = 0;
+    quint64 allocatedBytes = 0;
+    QVariantMap beginTimings;
+    QVariantMap endTimings;
+
+    QObject::connect(&window, &WOutputRenderWindow::beforeRendering, &window, [&] {
+        frameTimer.start();
+    }, Qt::DirectConnection);
+    QObject::connect(&window, &WOutputRenderWindow::renderEnd, &window, [&] {
+        if (!frameTimer.isValid())
+            return;
+        const qint64 elapsed = frameTimer.nsecsElapsed();
+        frameTimer.invalidate();
+
+        if (quitClient || toplevelCount < scene.windows || (scene.popups && popupCount < scene.windows))
+            return;
+
+        // The frames after the windows are shown allocate the buffers
+        if (skippedFrames < warmupFrames) {
+            ++skippedFrames;
+            return;
+        }
+
+        // The CPU time and the allocations are measured between the frames,
+        // includes the event processing of the clients
+        if (!measuring) {
+            measuring = true;
+            beginCpuTime = threadCpuTime();
+            beginAllocationCount = allocationCount;
+            beginAllocationBytes = allocationBytes;
+            beginTimings = window.renderTimings();
+            return;
+        }
+
+        frameTimes.append(elapsed);
+        if (frameTimes.size() < frameCount)
+            return;
+
+        cpuTime = threadCpuTime() - beginCpuTime;
+        allocations = allocationCount - beginAllocationCount;
+        allocatedBytes = allocationBytes - beginAllocationBytes;
+        endTimings = window.renderTimings();
+        quitClient = true;
+    });
+
+    QObject::connect(clientThread, &QThread::finished, &app, [&] {
+        if (!quitClient || clientFrames < 0) {
+            qCritical("The client is failed");
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        QList<qint64> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        qint64 sum = 0;
+        for (auto t : std::as_const(sorted))
+            sum += t;
+
+        QJsonObject frameTime {
+            {"mean", toMs(sum / sorted.size())},
+            {"p50", toMs(percentile(sorted, 50))},
+            {"p90", toMs(percentile(sorted, 90))},
+            {"p95", toMs(percentile(sorted, 95))},
+            {"p99", toMs(percentile(sorted, 99))},
+            {"max", toMs(sorted.last())},
+        };
+
+        const qint64 renderedFrames = std::max<qint64>(1, endTimings.value("frames").toLongLong()
+                                                              - beginTimings.value("frames").toLongLong());
+        const auto perFrame = [&] (const char *key) {
+            return toMs((endTimings.value(key).toLongLong() - beginTimings.value(key).toLongLong())
+                        / renderedFrames);
+        };
+        QJsonObject breakdown {
+            {"record", perFrame("record")},
+            {"wait", perFrame("wait")},
+            {"submit", perFrame("submit")},
+            {"commit", perFrame("commit")},
+        };
+
+        QJsonArray samples;
+        for (auto t : std::as_const(frameTimes))
+            samples.append(toMs(t));
+
+        QJsonObject result {
+            {"scene", QJsonObject {
+                {"name", scene.name},
+                {"outputs", scene.outputs},
+                {"outputSize", QJsonArray {outputSize.width(), outputSize.height()}},
+                {"windows", scene.windows},
+                {"windowSize", QJsonArray {scene.windowSize.width(), scene.windowSize.height()}},
+                {"damage", damageNames[int(scene.damage)]},
+                {"subsurfaces", scene.subsurfaces},
+                {"popups", scene.popups},
+                {"blurRadius", scene.blurRadius},
+            }},
+            {"renderer", QString::fromLocal8Bit(qgetenv("WLR_RENDERER"))},
+            {"frames", qint64(frameTimes.size())},
+            {"frameTime", frameTime},
+            {"breakdown", breakdown},
+            {"cpuTime", QJsonObject {
+                {"total", toMs(cpuTime)},
+                {"perFrame", toMs(cpuTime / frameTimes.size())},
+            }},
+            {"clientFrames", clientFrames},
+            {"frameTimes", samples},
+        };
+#ifdef __GLIBC__
+        result.insert("allocations", QJsonObject {
+            {"count", qint64(allocations)},
+            {"bytes", qint64(allocatedBytes)},
+            {"perFrame", double(allocations) / frameTimes.size()},
+            {"bytesPerFrame", double(allocatedBytes) / frameTimes.size()},
+        });
+#endif
+
+        const QByteArray json = QJsonDocument(result).toJson();
+        if (parser.isSet(outputOption)) {
+            QFile file(parser.value(outputOption));
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+                qCritical("Failed to write %s", qPrintable(file.fileName()));
+                QCoreApplication::exit(1);
+                return;
+            }
+        } else {
+            fwrite(json.constData(), 1, json.size(), stdout);
+            fflush(stdout);
+        }
+
+        QCoreApplication::quit();
+    });
+    clientThread->start();
+
+    // Avoid to wait forever if the outputs can't be rendered
+    QTimer::singleShot(std::chrono::minutes(5), &app, [] {
+        qCritical("Timeout, the frames aren't rendered");
+        QCoreApplication::exit(1);
+    });
+
+    const int ret = app.exec();
+    quitClient = true;
+    clientThread->wait();
+    delete clientThread;
+
+    return ret;
+}
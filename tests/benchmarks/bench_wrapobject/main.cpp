@@ -0,0 +1,99 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Create many wrapped objects with many safe connections each, disconnect
+// them by the receivers and the connections, and destroy the objects, print
+// the time of each step, e.g.
+//   bench_wrapobject --objects 20000 --receivers 16 --connections 4
+
+#include <WServer>
+#include <woutputlayout.h>
+
+#include <qwoutputlayout.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption objectsOption("objects", "The count of the wrapped objects.", "count", "20000");
+    QCommandLineOption receiversOption("receivers", "The receivers of each object.", "count", "16");
+    QCommandLineOption connectionsOption("connections", "The connections of each receiver.", "count", "4");
+    parser.addOptions({objectsOption, receiversOption, connectionsOption});
+    parser.process(app);
+
+    const int objectCount = std::max(1, parser.value(objectsOption).toInt());
+    const int receiverCount = std::max(2, parser.value(receiversOption).toInt());
+    const int connectionCount = std::max(1, parser.value(connectionsOption).toInt());
+
+    WServer server;
+    std::vector<std::unique_ptr<QObject>> receivers;
+    for (int i = 0; i < receiverCount; ++i)
+        receivers.emplace_back(new QObject);
+
+    quint64 calls = 0;
+    std::vector<WOutputLayout*> objects;
+    objects.reserve(objectCount);
+    std::vector<QMetaObject::Connection> lastConnections;
+    lastConnections.reserve(objectCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < objectCount; ++i) {
+        auto object = new WOutputLayout(&server);
+        objects.push_back(object);
+
+        QMetaObject::Connection connection;
+        for (const auto &receiver : receivers) {
+            for (int j = 0; j < connectionCount; ++j) {
+                connection = object->safeConnect(&qw_output_layout::notify_change,
+                                                 receiver.get(), [&calls] {
+                    ++calls;
+                });
+            }
+        }
+        lastConnections.push_back(connection);
+    }
+    const qint64 connectTime = timer.nsecsElapsed();
+
+    // Disconnect the half of the receivers
+    timer.restart();
+    for (auto object : objects) {
+        for (int i = 0; i < receiverCount / 2; ++i)
+            object->safeDisconnect(receivers.at(i).get());
+    }
+    const qint64 receiverDisconnectTime = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < objectCount; ++i)
+        objects.at(i)->safeDisconnect(lastConnections.at(i));
+    const qint64 connectionDisconnectTime = timer.nsecsElapsed();
+
+    // The rest connections are disconnected on invalidate
+    timer.restart();
+    for (auto object : objects)
+        object->safeDeleteLater();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    const qint64 destroyTime = timer.nsecsElapsed();
+
+    const qint64 connections = qint64(objectCount) * receiverCount * connectionCount;
+    printf("objects: %d, connections: %lld\n", objectCount, connections);
+    printf("create and connect: %.1f ms, disconnect by receiver: %.1f ms,"
+           " disconnect by connection: %.1f ms, destroy: %.1f ms\n",
+           connectTime / 1000000.0, receiverDisconnectTime / 1000000.0,
+           connectionDisconnectTime / 1000000.0, destroyTime / 1000000.0);
+    fflush(stdout);
+
+    return calls == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "testclient.h"
+
+#include <algorithm>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+void handleGlobal(void *data, wl_registry *registry, uint32_t name,
+                  const char *interface, uint32_t version)
+{
+    auto connection = static_cast<ClientConnection*>(data);
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        connection->compositor = static_cast<wl_compositor*>(wl_registry_bind(registry, name,
+                                                                              &wl_compositor_interface, 1));
+    } else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+        connection->subcompositor = static_cast<wl_subcompositor*>(wl_registry_bind(registry, name,
+                                                                                    &wl_subcompositor_interface, 1));
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        connection->shm = static_cast<wl_shm*>(wl_registry_bind(registry, name, &wl_shm_interface, 1));
+    } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        connection->wmBase = static_cast<xdg_wm_base*>(wl_registry_bind(registry, name,
+                                                                        &xdg_wm_base_interface, 1));
+    }
+
+    if (connection->globalHandler)
+        connection->globalHandler(connection->globalHandlerData, registry, name, interface, version);
+}
+
+void handleGlobalRemove(void *, wl_registry *, uint32_t)
+{
+}
+
+const wl_registry_listener registryListener = {
+    .global = handleGlobal,
+    .global_remove = handleGlobalRemove,
+};
+
+void handlePing(void *, xdg_wm_base *wmBase, uint32_t serial)
+{
+    xdg_wm_base_pong(wmBase, serial);
+}
+
+const xdg_wm_base_listener wmBaseListener = {
+    .ping = handlePing,
+};
+
+void handleBufferRelease(void *data, wl_buffer *)
+{
+    static_cast<ShmBuffer*>(data)->busy = false;
+}
+
+const wl_buffer_listener bufferListener = {
+    .release = handleBufferRelease,
+};
+
+} // namespace
+
+long long monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+bool connectClient(const char *socket, ClientConnection *connection)
+{
+    connection->display = wl_display_connect(socket);
+    if (!connection->display)
+        return false;
+
+    auto registry = wl_display_get_registry(connection->display);
+    wl_registry_add_listener(registry, &registryListener, connection);
+    const bool ok = wl_display_roundtrip(connection->display) >= 0;
+    wl_registry_destroy(registry);
+
+    if (connection->wmBase)
+        xdg_wm_base_add_listener(connection->wmBase, &wmBaseListener, connection);
+
+    return ok;
+}
+
+void disconnectClient(ClientConnection *connection)
+{
+    if (connection->wmBase)
+        xdg_wm_base_destroy(connection->wmBase);
+    if (connection->shm)
+        wl_shm_destroy(connection->shm);
+    if (connection->subcompositor)
+        wl_subcompositor_destroy(connection->subcompositor);
+    if (connection->compositor)
+        wl_compositor_destroy(connection->compositor);
+    if (connection->display)
+        wl_display_disconnect(connection->display);
+
+    *connection = {};
+}
+
+bool dispatchClientEvents(wl_display *display, int timeout)
+{
+    while (wl_display_prepare_read(display) != 0) {
+        if (wl_display_dispatch_pending(display) < 0)
+            return false;
+    }
+    wl_display_flush(display);
+
+    struct pollfd pfd = { wl_display_get_fd(display), POLLIN, 0 };
+    if (poll(&pfd, 1, timeout) > 0) {
+        if (wl_display_read_events(display) < 0)
+            return false;
+    } else {
+        wl_display_cancel_read(display);
+    }
+
+    return wl_display_dispatch_pending(display) >= 0;
+}
+
+bool createShmBuffer(wl_shm *shm, int width, int height, uint32_t color, ShmBuffer *buffer)
+{
+    const int stride = width * 4;
+    const int size = stride * height;
+    const int fd = memfd_create("waylib-test-client", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    auto pool = wl_shm_create_pool(shm, fd, size);
+    buffer->handle = wl_shm_pool_create_buffer(pool, 0, width, height, stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    buffer->data = static_cast<uint32_t*>(data);
+    buffer->width = width;
+    buffer->height = height;
+    buffer->busy = false;
+    wl_buffer_add_listener(buffer->handle, &bufferListener, buffer);
+    fillShmBuffer(buffer, 0, 0, width, height, color);
+
+    return true;
+}
+
+void destroyShmBuffer(ShmBuffer *buffer)
+{
+    if (!buffer->handle)
+        return;
+    wl_buffer_destroy(buffer->handle);
+    munmap(buffer->data, buffer->width * buffer->height * 4);
+    *buffer = {};
+}
+
+void fillShmBuffer(ShmBuffer *buffer, int x, int y, int width, int height, uint32_t color)
+{
+    for (int row = y; row < y + height; ++row)
+        std::fill_n(buffer->data + row * buffer->width + x, width, color);
+}
+
+void commitShmBuffer(wl_surface *surface, ShmBuffer *buffer)
+{
+    buffer->busy = true;
+    wl_surface_attach(surface, buffer->handle, 0, 0);
+    wl_surface_damage(surface, 0, 0, buffer->width, buffer->height);
+    wl_surface_commit(surface);
+}
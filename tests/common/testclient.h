@@ -0,0 +1,60 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The helpers of the test clients, only include it in the client side
+// translation units, wayland-client.h and wayland-server.h can't be used
+// together.
+
+#include "xdg-shell-client-protocol.h"
+
+#include <wayland-client.h>
+
+#include <cstdint>
+
+long long monotonicTime();
+
+// Called for each global of the registry, after the known ones are bound
+using GlobalHandler = void (*)(void *data, wl_registry *registry, uint32_t name,
+                               const char *interface, uint32_t version);
+
+struct ClientConnection
+{
+    wl_display *display = nullptr;
+    wl_compositor *compositor = nullptr;
+    wl_subcompositor *subcompositor = nullptr;
+    wl_shm *shm = nullptr;
+    xdg_wm_base *wmBase = nullptr;
+
+    GlobalHandler globalHandler = nullptr;
+    void *globalHandlerData = nullptr;
+};
+
+// Connect to the socket and bind the globals of the connection that the
+// server provides, the ping of xdg_wm_base is answered. Returns false if
+// failed, call disconnectClient in any case.
+bool connectClient(const char *socket, ClientConnection *connection);
+void disconnectClient(ClientConnection *connection);
+
+// Flush the requests, wait for the events up to the timeout (in milliseconds,
+// -1 is infinite) and dispatch them, returns false if the connection is broken.
+bool dispatchClientEvents(wl_display *display, int timeout);
+
+// A XRGB8888 buffer in its own shm pool, the busy is cleared when the server
+// releases it.
+struct ShmBuffer
+{
+    wl_buffer *handle = nullptr;
+    uint32_t *data = nullptr;
+    int width = 0;
+    int height = 0;
+    bool busy = false;
+};
+
+bool createShmBuffer(wl_shm *shm, int width, int height, uint32_t color, ShmBuffer *buffer);
+void destroyShmBuffer(ShmBuffer *buffer);
+void fillShmBuffer(ShmBuffer *buffer, int x, int y, int width, int height, uint32_t color);
+
+// Attach the buffer to the surface, damage the whole buffer and commit
+void commitShmBuffer(wl_surface *surface, ShmBuffer *buffer);
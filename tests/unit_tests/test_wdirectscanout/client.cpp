@@ -0,0 +1,79 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <algorithm>
+
+namespace {
+
+struct ClientState
+{
+    bool frameDone = true;
+    int frames = 0;
+};
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto state = static_cast<ClientState*>(data);
+    state->frameDone = true;
+    ++state->frames;
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+} // namespace
+
+int runOpaqueSurfaceClient(const char *socket, int width, int height,
+                           const std::atomic<bool> &quit)
+{
+    ClientConnection connection;
+    // Double buffering, the scanned out buffer is locked by the output
+    ShmBuffer buffers[2];
+    bool ok = connectClient(socket, &connection) && connection.compositor && connection.shm;
+    for (auto &buffer : buffers)
+        ok = ok && createShmBuffer(connection.shm, width, height, 0xff336699, &buffer);
+
+    if (!ok) {
+        for (auto &buffer : buffers)
+            destroyShmBuffer(&buffer);
+        disconnectClient(&connection);
+        return -1;
+    }
+
+    ClientState state;
+    auto surface = wl_compositor_create_surface(connection.compositor);
+    auto opaque = wl_compositor_create_region(connection.compositor);
+    wl_region_add(opaque, 0, 0, width, height);
+    wl_surface_set_opaque_region(surface, opaque);
+    wl_region_destroy(opaque);
+
+    while (ok && !quit.load(std::memory_order_relaxed)) {
+        if (state.frameDone) {
+            auto buffer = std::find_if(std::begin(buffers), std::end(buffers),
+                                       [] (const ShmBuffer &buffer) { return !buffer.busy; });
+            // Retry after a buffer is released
+            if (buffer != std::end(buffers)) {
+                state.frameDone = false;
+                auto callback = wl_surface_frame(surface);
+                wl_callback_add_listener(callback, &frameListener, &state);
+                commitShmBuffer(surface, buffer);
+            }
+        }
+
+        // Wake up to check the quit even if no events
+        ok = dispatchClientEvents(connection.display, 100);
+    }
+
+    wl_surface_destroy(surface);
+    for (auto &buffer : buffers)
+        destroyShmBuffer(&buffer);
+    disconnectClient(&connection);
+
+    return ok ? state.frames : -1;
+}
@@ -0,0 +1,15 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+#include <atomic>
+
+// Show an opaque surface and commit a new frame on each frame callback until
+// the quit is set, returns the count of the received frame callbacks, or -1
+// if failed. It's safe to run in a thread.
+int runOpaqueSurfaceClient(const char *socket, int width, int height,
+                           const std::atomic<bool> &quit);
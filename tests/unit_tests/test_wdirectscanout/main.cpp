@@ -0,0 +1,221 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Show an opaque shm client covering a headless output, and check the output
+// commits the buffer of the client instead of a composited one.
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSurface>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wsurfaceitem.h>
+#include <wsocket.h>
+
+#include <qwbackend.h>
+#include <qwbuffer.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwcompositor.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QPointer>
+#include <QThread>
+#include <QTest>
+
+#include <atomic>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/types/wlr_output.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+class DirectScanoutTest : public QObject
+{
+    Q_OBJECT
+public:
+    DirectScanoutTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        qunsetenv("WAYLIB_DISABLE_DIRECT_SCANOUT");
+
+        backend = server.attach<WBackend>();
+        socket = new WSocket(false);
+        QVERIFY(socket->autoCreate());
+        server.addSocket(socket);
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+        compositor = qw_compositor::create(*server.handle(), 6, *renderer);
+        QVERIFY(compositor);
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+
+        QObject::connect(compositor, &qw_compositor::notify_new_surface, &window, [this] (wlr_surface *handle) {
+            surface = new WSurface(qw_surface::from(handle), &window);
+            auto content = new WSurfaceItemContent(window.contentItem());
+            content->setSurface(surface);
+            content->setSize(outputSize);
+        });
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+
+            QObject::connect(output->handle(), qOverload<wlr_output_event_commit*>(&qw_output::notify_commit),
+                             this, [this] (wlr_output_event_commit *event) {
+                if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER))
+                    return;
+
+                auto clientBuffer = surface && surface->buffer() ? surface->buffer()->handle() : nullptr;
+                if (clientBuffer && event->state->buffer == clientBuffer)
+                    ++scanoutCommits;
+                else
+                    ++composedCommits;
+            });
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+        QTRY_VERIFY(viewport);
+
+        const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+        clientThread = QThread::create([this, socketName] {
+            clientFrames = runOpaqueSurfaceClient(socketName.constData(), outputSize.width(),
+                                                  outputSize.height(), quit);
+        });
+        clientThread->start();
+    }
+
+    void cleanupTestCase()
+    {
+        if (clientThread) {
+            quit = true;
+            // The client only waits for the events of the compositor with a
+            // timeout, it's safe to block the event loop here.
+            QVERIFY(clientThread->wait(5000));
+            delete clientThread;
+            QVERIFY(clientFrames >= 0);
+        }
+    }
+
+    void testScanoutClientBuffer()
+    {
+        QTRY_VERIFY_WITH_TIMEOUT(viewport->directScanout(), 10000);
+        const int composed = composedCommits;
+        const int scanouts = scanoutCommits;
+        const auto layerStats = window.layerTestStats(viewport);
+
+        // Keep scanning out while the client is updating
+        QTRY_VERIFY_WITH_TIMEOUT(scanoutCommits >= scanouts + 10, 10000);
+        QVERIFY(viewport->directScanout());
+        QCOMPARE(composedCommits, composed);
+
+        // Every client buffer is tested, the result of the swapchain buffers
+        // in the same format and size isn't reused for it
+        const auto newLayerStats = window.layerTestStats(viewport);
+        QCOMPARE(newLayerStats.value("cacheHits"), layerStats.value("cacheHits"));
+        QVERIFY(newLayerStats.value("tests").toULongLong() >= layerStats.value("tests").toULongLong() + 10);
+    }
+
+    // The surface isn't covering the output after it's moved, the output
+    // must go back to the composition.
+    void testFallbackToComposition()
+    {
+        QVERIFY(surface);
+        auto content = window.contentItem()->findChild<WSurfaceItemContent*>();
+        QVERIFY(content);
+        content->setX(10);
+
+        QTRY_VERIFY_WITH_TIMEOUT(!viewport->directScanout(), 10000);
+        const int composed = composedCommits;
+        QTRY_VERIFY_WITH_TIMEOUT(composedCommits >= composed + 3, 10000);
+
+        content->setX(0);
+        QTRY_VERIFY_WITH_TIMEOUT(viewport->directScanout(), 10000);
+    }
+
+private:
+    const QSize outputSize = QSize(640, 480);
+    WServer server;
+    WBackend *backend = nullptr;
+    WSocket *socket = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    qw_compositor *compositor = nullptr;
+    WOutputRenderWindow window;
+    WOutputViewport *viewport = nullptr;
+    QPointer<WSurface> surface;
+
+    QThread *clientThread = nullptr;
+    std::atomic<bool> quit = false;
+    int clientFrames = 0;
+    int scanoutCommits = 0;
+    int composedCommits = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    DirectScanoutTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
@@ -0,0 +1,132 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <wframescheduler_p.h>
+
+#include <QTest>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+static constexpr qint64 Ms = 1000000;
+static constexpr qint64 Refresh = 16666667; // 60Hz
+
+// Drive the scheduler by a synthetic clock, the frame event is sent 0.1ms
+// after each vblank, and the frame is presented on the first vblank after
+// the rendering is finished.
+class FakeOutput
+{
+public:
+    FakeOutput() {
+        scheduler.setRefreshInterval(Refresh);
+    }
+
+    // Returns true if the frame is presented on the next vblank
+    bool frame(qint64 renderTime) {
+        const qint64 frameEvent = vblank + Ms / 10;
+        const qint64 delay = scheduler.frameDelay(frameEvent);
+        const qint64 begin = frameEvent + delay;
+        const qint64 end = begin + renderTime;
+        scheduler.beginFrame(begin);
+        scheduler.endFrame(end);
+
+        qint64 next = vblank + Refresh;
+        const bool onTime = end <= next;
+        while (next < end)
+            next += Refresh;
+        scheduler.presented(next, Refresh, true);
+        vblank = next;
+
+        return onTime;
+    }
+
+    WFrameScheduler scheduler;
+    qint64 vblank = 1000 * Ms;
+};
+
+class FrameSchedulerTest : public QObject
+{
+    Q_OBJECT
+public:
+    FrameSchedulerTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void testFirstFrame()
+    {
+        FakeOutput output;
+        // The render time is unknown
+        QCOMPARE(output.scheduler.frameDelay(output.vblank), qint64(0));
+    }
+
+    void testSteadyRenderTime()
+    {
+        FakeOutput output;
+        for (int i = 0; i < 60; ++i)
+            QVERIFY(output.frame(3 * Ms));
+
+        const auto &stats = output.scheduler.stats();
+        QCOMPARE(stats.presentedFrames, quint64(60));
+        QCOMPARE(stats.missedFrames, quint64(0));
+        QCOMPARE(stats.lastRenderTime, 3 * Ms);
+        // Render time + 1ms safety margin before the next vblank
+        QCOMPARE(stats.predictedRenderTime, 4 * Ms);
+        QCOMPARE(stats.renderDelay, Refresh - Ms / 10 - 4 * Ms);
+    }
+
+    void testMissedDeadline()
+    {
+        FakeOutput output;
+        for (int i = 0; i < 10; ++i)
+            QVERIFY(output.frame(3 * Ms));
+
+        const qint64 delay = output.scheduler.stats().renderDelay;
+        QVERIFY(!output.frame(10 * Ms));
+        QCOMPARE(output.scheduler.stats().missedFrames, quint64(1));
+
+        // Learned the slower frame and the bigger margin
+        QVERIFY(output.frame(10 * Ms));
+        QVERIFY(output.scheduler.stats().renderDelay < delay);
+        QVERIFY(output.scheduler.stats().predictedRenderTime > 11 * Ms);
+        QCOMPARE(output.scheduler.stats().missedFrames, quint64(1));
+    }
+
+    void testSlowerThanRefresh()
+    {
+        FakeOutput output;
+        for (int i = 0; i < 5; ++i) {
+            output.frame(20 * Ms);
+            QCOMPARE(output.scheduler.stats().renderDelay, qint64(0));
+        }
+    }
+
+    void testDiscardedFrame()
+    {
+        FakeOutput output;
+        output.frame(3 * Ms);
+
+        const qint64 frameEvent = output.vblank + Ms / 10;
+        output.scheduler.frameDelay(frameEvent);
+        output.scheduler.beginFrame(frameEvent);
+        output.scheduler.endFrame(frameEvent + 3 * Ms);
+        output.scheduler.presented(output.vblank + 3 * Refresh, Refresh, false);
+
+        QCOMPARE(output.scheduler.stats().presentedFrames, quint64(1));
+        QCOMPARE(output.scheduler.stats().missedFrames, quint64(0));
+    }
+
+    void testRefreshFromPresent()
+    {
+        WFrameScheduler scheduler;
+        scheduler.setRefreshInterval(Refresh);
+        scheduler.presented(1000 * Ms, 8 * Ms, true);
+        QCOMPARE(scheduler.refreshInterval(), 8 * Ms);
+
+        scheduler.reset();
+        QCOMPARE(scheduler.refreshInterval(), Refresh);
+    }
+};
+
+QTEST_MAIN(FrameSchedulerTest)
+#include "main.moc"
@@ -0,0 +1,91 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <winputlatencystats.h>
+
+#include <QTest>
+#include <QSignalSpy>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+static constexpr qint64 Ms = 1000000;
+
+class InputLatencyStatsTest : public QObject
+{
+    Q_OBJECT
+public:
+    InputLatencyStatsTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void testEmpty()
+    {
+        WInputLatencyStats stats;
+        QCOMPARE(stats.samples(), quint64(0));
+        QCOMPARE(stats.p50(), 0.0);
+        QCOMPARE(stats.p99(), 0.0);
+        QCOMPARE(stats.max(), 0.0);
+    }
+
+    void testPercentiles()
+    {
+        WInputLatencyStats stats;
+        QSignalSpy spy(&stats, &WInputLatencyStats::changed);
+
+        // 1ms, 2ms ... 100ms
+        for (int i = 1; i <= 100; ++i)
+            stats.addSample(i * Ms);
+
+        QCOMPARE(spy.count(), 100);
+        QCOMPARE(stats.samples(), quint64(100));
+        // The upper bound of the bucket
+        QCOMPARE(stats.p50(), 50.25);
+        QCOMPARE(stats.p95(), 95.25);
+        QCOMPARE(stats.p99(), 99.25);
+        QCOMPARE(stats.max(), 100.0);
+        QCOMPARE(stats.percentile(0), 1.25);
+        QCOMPARE(stats.percentile(1), 100.0);
+    }
+
+    void testResolution()
+    {
+        WInputLatencyStats stats;
+        // In the bucket of [4ms, 4.25ms)
+        stats.addSample(4 * Ms + Ms / 10);
+        stats.addSample(4 * Ms + Ms / 5);
+        QCOMPARE(stats.p50(), 4.2);
+        QCOMPARE(stats.max(), 4.2);
+
+        stats.addSample(6 * Ms);
+        stats.addSample(8 * Ms);
+        QCOMPARE(stats.p50(), 4.25);
+    }
+
+    void testOverflow()
+    {
+        WInputLatencyStats stats;
+        stats.addSample(-Ms);
+        stats.addSample(500 * Ms);
+        QCOMPARE(stats.p50(), 0.25);
+        QCOMPARE(stats.p99(), 500.0);
+        QCOMPARE(stats.max(), 500.0);
+    }
+
+    void testReset()
+    {
+        WInputLatencyStats stats;
+        stats.addSample(3 * Ms);
+        stats.reset();
+        QCOMPARE(stats.samples(), quint64(0));
+        QCOMPARE(stats.p95(), 0.0);
+
+        stats.addSample(1 * Ms);
+        QCOMPARE(stats.max(), 1.0);
+        QCOMPARE(stats.p50(), 1.0);
+    }
+};
+
+QTEST_MAIN(InputLatencyStatsTest)
+#include "main.moc"
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct Surface
+{
+    wl_surface *handle = nullptr;
+    std::atomic<int> *frames = nullptr;
+    bool frameDone = true;
+    // Double buffering, the buffer maybe still used by the compositor
+    ShmBuffer buffers[2];
+};
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto surface = static_cast<Surface*>(data);
+    surface->frameDone = true;
+    surface->frames->fetch_add(1, std::memory_order_relaxed);
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+} // namespace
+
+bool runOpaqueSurfacesClient(const char *socket, int width, int height, int count,
+                             std::atomic<int> *frames, const std::atomic<bool> &quit)
+{
+    ClientConnection connection;
+    // The address of the surface is used by the listener, don't resize it
+    std::vector<Surface> surfaces(count);
+    bool ok = connectClient(socket, &connection) && connection.compositor && connection.shm;
+    for (auto &surface : surfaces) {
+        for (auto &buffer : surface.buffers)
+            ok = ok && createShmBuffer(connection.shm, width, height, 0xff336699, &buffer);
+    }
+
+    // The surfaces are created in order, the compositor receives them in the same order
+    for (int i = 0; ok && i < count; ++i) {
+        auto &surface = surfaces[i];
+        surface.frames = &frames[i];
+        surface.handle = wl_compositor_create_surface(connection.compositor);
+        auto opaque = wl_compositor_create_region(connection.compositor);
+        wl_region_add(opaque, 0, 0, width, height);
+        wl_surface_set_opaque_region(surface.handle, opaque);
+        wl_region_destroy(opaque);
+    }
+
+    while (ok && !quit.load(std::memory_order_relaxed)) {
+        for (auto &surface : surfaces) {
+            if (!surface.frameDone)
+                continue;
+
+            auto buffer = std::find_if(std::begin(surface.buffers), std::end(surface.buffers),
+                                       [] (const ShmBuffer &buffer) { return !buffer.busy; });
+            // Retry after a buffer is released
+            if (buffer == std::end(surface.buffers))
+                continue;
+
+            surface.frameDone = false;
+            auto callback = wl_surface_frame(surface.handle);
+            wl_callback_add_listener(callback, &frameListener, &surface);
+            commitShmBuffer(surface.handle, buffer);
+        }
+
+        // Wake up to check the quit even if no events
+        ok = dispatchClientEvents(connection.display, 100);
+    }
+
+    for (auto &surface : surfaces) {
+        if (surface.handle)
+            wl_surface_destroy(surface.handle);
+        for (auto &buffer : surface.buffers)
+            destroyShmBuffer(&buffer);
+    }
+    disconnectClient(&connection);
+
+    return ok;
+}
@@ -0,0 +1,16 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#pragma once
+
+// The client side is in its own translation unit, wayland-client.h and
+// wayland-server.h can't be used together.
+
+#include <atomic>
+
+// Show the opaque surfaces in the order of the frames, and commit a new
+// frame to each one on its frame callback until the quit is set. The frame
+// callbacks received by each surface are counted in the frames. Returns
+// false if failed. It's safe to run in a thread.
+bool runOpaqueSurfacesClient(const char *socket, int width, int height, int count,
+                             std::atomic<int> *frames, const std::atomic<bool> &quit);
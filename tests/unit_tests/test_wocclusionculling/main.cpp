@@ -0,0 +1,249 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Show two opaque shm surfaces on a headless output, the top one covering
+// the bottom one, and count the frame callbacks sent to the bottom one.
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSurface>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wsurfaceitem.h>
+#include <wsocket.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwcompositor.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QPointer>
+#include <QThread>
+#include <QTest>
+
+#include <atomic>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+class OcclusionCullingTest : public QObject
+{
+    Q_OBJECT
+public:
+    OcclusionCullingTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        qunsetenv("WAYLIB_ENABLE_OCCLUSION_CULLING");
+
+        backend = server.attach<WBackend>();
+        socket = new WSocket(false);
+        QVERIFY(socket->autoCreate());
+        server.addSocket(socket);
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+        compositor = qw_compositor::create(*server.handle(), 6, *renderer);
+        QVERIFY(compositor);
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+
+        // The later surface is stacked above the earlier one
+        QObject::connect(compositor, &qw_compositor::notify_new_surface, &window, [this] (wlr_surface *handle) {
+            auto surface = new WSurface(qw_surface::from(handle), &window);
+            auto content = new WSurfaceItemContent(window.contentItem());
+            content->setSurface(surface);
+            content->setSize(outputSize);
+            (bottom ? top : bottom) = content;
+        });
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+        QTRY_VERIFY(viewport);
+
+        const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+        clientThread = QThread::create([this, socketName] {
+            clientOk = runOpaqueSurfacesClient(socketName.constData(), outputSize.width(),
+                                               outputSize.height(), 2, frames, quit);
+        });
+        clientThread->start();
+
+        QTRY_VERIFY_WITH_TIMEOUT(bottom && top, 10000);
+    }
+
+    void cleanupTestCase()
+    {
+        if (clientThread) {
+            quit = true;
+            // The client only waits for the events of the compositor with a
+            // timeout, it's safe to block the event loop here.
+            QVERIFY(clientThread->wait(5000));
+            delete clientThread;
+            QVERIFY(clientOk);
+        }
+    }
+
+    // A client may rely on the frame callbacks while it's hidden
+    void testDisabledByDefault()
+    {
+        QVERIFY(!window.occlusionCulling());
+
+        const int bottomFrames = frames[BottomSurface];
+        const int topFrames = frames[TopSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[TopSurface] >= topFrames + 10, 10000);
+        QTRY_VERIFY_WITH_TIMEOUT(frames[BottomSurface] >= bottomFrames + 10, 10000);
+        QVERIFY(!bottom->isOccluded());
+    }
+
+    void testOccludedSurface()
+    {
+        window.setOccludedFrameCallbackInterval(0);
+        window.setOcclusionCulling(true);
+        QTRY_VERIFY_WITH_TIMEOUT(bottom->isOccluded(), 10000);
+        QVERIFY(!top->isOccluded());
+
+        // The frame callbacks sent before the occlusion maybe still on the way
+        int topFrames = frames[TopSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[TopSurface] >= topFrames + 5, 10000);
+
+        const int bottomFrames = frames[BottomSurface];
+        topFrames = frames[TopSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[TopSurface] >= topFrames + 30, 10000);
+        QCOMPARE(frames[BottomSurface].load(), bottomFrames);
+    }
+
+    void testKeepaliveFrameCallback()
+    {
+        QVERIFY(bottom->isOccluded());
+        window.setOccludedFrameCallbackInterval(100);
+
+        const int bottomFrames = frames[BottomSurface];
+        const int topFrames = frames[TopSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[BottomSurface] >= bottomFrames + 3, 10000);
+        // Much less than the frames of the visible surface
+        QTRY_VERIFY_WITH_TIMEOUT(frames[TopSurface] >= topFrames + 30, 10000);
+        QVERIFY(frames[BottomSurface] - bottomFrames < frames[TopSurface] - topFrames);
+        QVERIFY(bottom->isOccluded());
+
+        window.setOccludedFrameCallbackInterval(0);
+    }
+
+    void testUncoveredSurface()
+    {
+        // The occlusion is computed again after the interval is changed
+        QTRY_VERIFY_WITH_TIMEOUT(bottom->isOccluded(), 10000);
+        top->setVisible(false);
+        QTRY_VERIFY_WITH_TIMEOUT(!bottom->isOccluded(), 10000);
+
+        const int bottomFrames = frames[BottomSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[BottomSurface] >= bottomFrames + 10, 10000);
+
+        top->setVisible(true);
+        QTRY_VERIFY_WITH_TIMEOUT(bottom->isOccluded(), 10000);
+    }
+
+    void testDisableCulling()
+    {
+        QVERIFY(bottom->isOccluded());
+        window.setOcclusionCulling(false);
+        QVERIFY(!bottom->isOccluded());
+
+        const int bottomFrames = frames[BottomSurface];
+        QTRY_VERIFY_WITH_TIMEOUT(frames[BottomSurface] >= bottomFrames + 10, 10000);
+    }
+
+private:
+    enum {
+        BottomSurface,
+        TopSurface,
+    };
+
+    const QSize outputSize = QSize(640, 480);
+    WServer server;
+    WBackend *backend = nullptr;
+    WSocket *socket = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    qw_compositor *compositor = nullptr;
+    WOutputRenderWindow window;
+    WOutputViewport *viewport = nullptr;
+    QPointer<WSurfaceItemContent> bottom;
+    QPointer<WSurfaceItemContent> top;
+
+    QThread *clientThread = nullptr;
+    std::atomic<bool> quit = false;
+    bool clientOk = false;
+    std::atomic<int> frames[2] = {0, 0};
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    OcclusionCullingTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
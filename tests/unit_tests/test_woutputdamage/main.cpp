@@ -0,0 +1,200 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Render a static background and a small animation on a headless output by
+// the pixman renderer, and count the pixels repainted in each commit.
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QTest>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/types/wlr_output.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static const char sceneQml[] = R"(
+import QtQuick
+
+Rectangle {
+    color: "#203040"
+
+    Rectangle {
+        x: 40; y: 40
+        width: 400; height: 300
+        color: "steelblue"
+    }
+
+    Rectangle {
+        id: caret
+        x: 100; y: 400
+        width: 16; height: 16
+        color: "orange"
+
+        NumberAnimation on x {
+            from: 100
+            to: 600
+            duration: 5000
+            loops: Animation.Infinite
+        }
+    }
+}
+)";
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static qint64 regionArea(const pixman_region32_t *region)
+{
+    int count = 0;
+    const pixman_box32_t *boxes = pixman_region32_rectangles(const_cast<pixman_region32_t*>(region), &count);
+    qint64 area = 0;
+    for (int i = 0; i < count; ++i)
+        area += qint64(boxes[i].x2 - boxes[i].x1) * (boxes[i].y2 - boxes[i].y1);
+    return area;
+}
+
+class OutputDamageTest : public QObject
+{
+    Q_OBJECT
+public:
+    OutputDamageTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        backend = server.attach<WBackend>();
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+
+        QQmlComponent component(&engine);
+        component.setData(sceneQml, QUrl());
+        QVERIFY2(!component.isError(), qPrintable(component.errorString()));
+        auto scene = qobject_cast<QQuickItem*>(component.create());
+        QVERIFY(scene);
+        scene->setParent(&window);
+        scene->setParentItem(window.contentItem());
+        scene->setSize(outputSize);
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            auto viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+
+            QObject::connect(output->handle(), qOverload<wlr_output_event_commit*>(&qw_output::notify_commit),
+                             this, [this] (wlr_output_event_commit *event) {
+                if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER))
+                    return;
+                // No damage is the whole buffer
+                commitAreas.append(event->state->committed & WLR_OUTPUT_STATE_DAMAGE
+                                       ? regionArea(&event->state->damage)
+                                       : qint64(outputSize.width()) * outputSize.height());
+            });
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+    }
+
+    // Only the area of the animation is repainted after the first frames
+    void testPartialRepaint()
+    {
+        const int warmupFrames = 5;
+        const int frames = 30;
+        QTRY_VERIFY_WITH_TIMEOUT(commitAreas.size() >= warmupFrames + frames, 10000);
+
+        const qint64 outputArea = qint64(outputSize.width()) * outputSize.height();
+        QCOMPARE(commitAreas.first(), outputArea);
+
+        // The old and the new area of the caret, with the margin for the
+        // antialiasing and the alignment of the damage
+        const qint64 maxArea = 4 * 24 * 24;
+        for (int i = warmupFrames; i < warmupFrames + frames; ++i) {
+            QVERIFY2(commitAreas.at(i) > 0, qPrintable(QStringLiteral("frame %1 has no damage").arg(i)));
+            QVERIFY2(commitAreas.at(i) <= maxArea,
+                     qPrintable(QStringLiteral("frame %1 repaints %2 pixels").arg(i).arg(commitAreas.at(i))));
+        }
+    }
+
+private:
+    const QSize outputSize = QSize(800, 600);
+    WServer server;
+    WBackend *backend = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    WOutputRenderWindow window;
+    QQmlEngine engine;
+    QList<qint64> commitAreas;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    OutputDamageTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
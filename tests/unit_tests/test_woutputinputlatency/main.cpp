@@ -0,0 +1,262 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Move a synthetic pointer on the first of two headless outputs, the second
+// one is animated all the time, and check only the first output records the
+// latency from the motion to the commit.
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSeat>
+#include <WCursor>
+#include <winputdevice.h>
+#include <woutputlayout.h>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <winputlatencystats.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QTest>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/types/wlr_output.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+// The left half follows the pointer, the right half is always animated
+static const char sceneQml[] = R"(
+import QtQuick
+
+Item {
+    MouseArea {
+        id: area
+        width: 320; height: 240
+        hoverEnabled: true
+
+        Rectangle {
+            x: area.mouseX; y: area.mouseY
+            width: 8; height: 8
+            color: "orange"
+        }
+    }
+
+    Rectangle {
+        x: 320
+        width: 320; height: 240
+        color: "#203040"
+
+        Rectangle {
+            y: 100
+            width: 16; height: 16
+            color: "steelblue"
+
+            NumberAnimation on x {
+                from: 0
+                to: 300
+                duration: 2000
+                loops: Animation.Infinite
+            }
+        }
+    }
+}
+)";
+
+static const wlr_pointer_impl testPointerImpl = {
+    .name = "test-pointer",
+};
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+class OutputInputLatencyTest : public QObject
+{
+    Q_OBJECT
+public:
+    OutputInputLatencyTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        backend = server.attach<WBackend>();
+        seat = server.attach<WSeat>();
+        layout = new WOutputLayout(&server);
+        cursor = new WCursor(&server);
+        seat->setCursor(cursor);
+        cursor->setLayout(layout);
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+
+        window.setWidth(outputSize.width() * 2);
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+        cursor->setEventWindow(&window);
+
+        QQmlComponent component(&engine);
+        component.setData(sceneQml, QUrl());
+        QVERIFY2(!component.isError(), qPrintable(component.errorString()));
+        auto scene = qobject_cast<QQuickItem*>(component.create());
+        QVERIFY(scene);
+        scene->setParent(&window);
+        scene->setParentItem(window.contentItem());
+        scene->setSize(QSizeF(outputSize.width() * 2, outputSize.height()));
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            const QPoint position(outputSize.width() * viewports.size(), 0);
+            auto viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setPosition(position);
+            viewport->setSize(outputSize);
+            layout->add(output, position);
+            viewports.append(viewport);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+
+            QObject::connect(output->handle(), qOverload<wlr_output_event_commit*>(&qw_output::notify_commit),
+                             this, [this, viewport] (wlr_output_event_commit *event) {
+                if (event->state->committed & WLR_OUTPUT_STATE_BUFFER)
+                    ++commits[viewport];
+            });
+        });
+        QObject::connect(backend, &WBackend::inputAdded, seat, [this] (WInputDevice *device) {
+            seat->attachInputDevice(device);
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+        QTRY_COMPARE(viewports.size(), 2);
+
+        // The headless backend has no input devices
+        wlr_pointer_init(&pointer, &testPointerImpl, testPointerImpl.name);
+        pointerAdded = true;
+        wl_signal_emit_mutable(&backend->handle()->handle()->events.new_input, &pointer.base);
+        seat->setCursorPosition(QPointF(100, 100));
+
+        // Wait the startup frames
+        QTRY_VERIFY_WITH_TIMEOUT(commits.value(viewports.at(0)) >= 2
+                                 && commits.value(viewports.at(1)) >= 2, 10000);
+    }
+
+    void cleanupTestCase()
+    {
+        if (pointerAdded)
+            wlr_pointer_finish(&pointer);
+    }
+
+    void testOnlyAffectedOutput()
+    {
+        auto leftLatency = window.inputLatency(viewports.at(0));
+        auto rightLatency = window.inputLatency(viewports.at(1));
+        QVERIFY(leftLatency);
+        QVERIFY(rightLatency);
+        leftLatency->reset();
+        rightLatency->reset();
+        const int rightCommits = commits.value(viewports.at(1));
+
+        const int motions = 10;
+        for (int i = 1; i <= motions; ++i) {
+            wlr_pointer_motion_event event = {
+                .pointer = &pointer,
+                .time_msec = uint32_t(i * 16),
+                .delta_x = 5,
+                .delta_y = 3,
+                .unaccel_dx = 5,
+                .unaccel_dy = 3,
+            };
+            wl_signal_emit_mutable(&pointer.events.motion, &event);
+            wl_signal_emit_mutable(&pointer.events.frame, &pointer);
+
+            // Each motion moves the rectangle, it's committed in a frame
+            QTRY_VERIFY_WITH_TIMEOUT(leftLatency->samples() >= quint64(i), 5000);
+        }
+
+        QVERIFY(cursor->position().x() < outputSize.width());
+        QVERIFY(leftLatency->max() > 0);
+        // The motion can't wait for more than some frames
+        QVERIFY2(leftLatency->max() < 1000, qPrintable(QString::number(leftLatency->max())));
+
+        // The second output is committed in the meantime, but it doesn't
+        // show the pointer.
+        QVERIFY(commits.value(viewports.at(1)) > rightCommits);
+        QCOMPARE(rightLatency->samples(), quint64(0));
+    }
+
+private:
+    const QSize outputSize = QSize(320, 240);
+    WServer server;
+    WBackend *backend = nullptr;
+    WSeat *seat = nullptr;
+    WOutputLayout *layout = nullptr;
+    WCursor *cursor = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    WOutputRenderWindow window;
+    QQmlEngine engine;
+    QList<WOutputViewport*> viewports;
+    QHash<WOutputViewport*, int> commits;
+    wlr_pointer pointer;
+    bool pointerAdded = false;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    OutputInputLatencyTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
@@ -0,0 +1,241 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Play an animated xcursor by a Cursor on a headless output rendered by the
+// pixman renderer, the frames are only uploaded in the first loop.
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WCursor>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wquickcursor.h>
+#include <wsgtextureprovider.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+#include <QSet>
+#include <QtEndian>
+#include <QTest>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static constexpr int CursorFrames = 4;
+static constexpr int CursorSize = 24;
+// In milliseconds
+static constexpr int CursorFrameDelay = 30;
+static const char cursorTheme[] = "waylib-test";
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+static void appendUInt32(QByteArray *data, quint32 value)
+{
+    value = qToLittleEndian(value);
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// An xcursor file of the animated images in a color of each frame
+static bool writeAnimatedXCursor(const QString &fileName)
+{
+    const quint32 magic = 0x72756358; // "Xcur"
+    const quint32 fileHeaderSize = 16;
+    const quint32 imageType = 0xfffd0002;
+    const quint32 imageHeaderSize = 36;
+    const quint32 imageSize = imageHeaderSize + CursorSize * CursorSize * 4;
+
+    QByteArray data;
+    appendUInt32(&data, magic);
+    appendUInt32(&data, fileHeaderSize);
+    appendUInt32(&data, 0x10000);
+    appendUInt32(&data, CursorFrames);
+
+    // The table of contents
+    const quint32 firstImage = fileHeaderSize + CursorFrames * 12;
+    for (int i = 0; i < CursorFrames; ++i) {
+        appendUInt32(&data, imageType);
+        appendUInt32(&data, CursorSize);
+        appendUInt32(&data, firstImage + i * imageSize);
+    }
+
+    for (int i = 0; i < CursorFrames; ++i) {
+        appendUInt32(&data, imageHeaderSize);
+        appendUInt32(&data, imageType);
+        appendUInt32(&data, CursorSize);
+        appendUInt32(&data, 1);
+        appendUInt32(&data, CursorSize);
+        appendUInt32(&data, CursorSize);
+        appendUInt32(&data, CursorSize / 2);
+        appendUInt32(&data, CursorSize / 2);
+        appendUInt32(&data, CursorFrameDelay);
+
+        const QRgb color = qRgba(i * 60, 255 - i * 60, 128, 255);
+        for (int p = 0; p < CursorSize * CursorSize; ++p)
+            appendUInt32(&data, color);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(data) == data.size();
+}
+
+class QuickCursorTest : public QObject
+{
+    Q_OBJECT
+public:
+    QuickCursorTest(const QString &cursorPath, QObject *parent = nullptr)
+        : QObject(parent)
+        , cursorPath(cursorPath)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        const QString cursorsDir = cursorPath + "/" + cursorTheme + "/cursors";
+        QVERIFY(QDir().mkpath(cursorsDir));
+        QVERIFY(writeAnimatedXCursor(cursorsDir + "/wait"));
+
+        backend = server.attach<WBackend>();
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+
+        cursor = new WCursor(&window);
+        cursor->setCursor(QCursor(Qt::WaitCursor));
+        cursorItem = new WQuickCursor(window.contentItem());
+        cursorItem->setPosition(QPointF(40, 40));
+        cursorItem->setThemeName(cursorTheme);
+        cursorItem->setSourceSize(QSize(CursorSize, CursorSize));
+        cursorItem->setCursor(cursor);
+
+        // Record the texture shown in each frame
+        QObject::connect(&window, &WOutputRenderWindow::renderEnd, this, [this] {
+            auto tp = cursorItem->wTextureProvider();
+            if (!tp || !tp->qwTexture())
+                return;
+            textures.insert(tp->qwTexture());
+            buffers.insert(tp->qwBuffer());
+            shownTextures.insert(tp->qwTexture());
+            misses = tp->textureCacheMisses();
+        });
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            auto viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+    }
+
+    // The second loop of the animation only switches between the textures
+    // created in the first loop
+    void testAnimationLoops()
+    {
+        // The first loop
+        QTRY_COMPARE_WITH_TIMEOUT(shownTextures.size(), CursorFrames, 5000);
+        const auto firstMisses = misses;
+        const auto firstTextures = textures.size();
+        const auto firstBuffers = buffers.size();
+        QVERIFY(firstMisses >= quint64(CursorFrames));
+
+        // The second loop
+        shownTextures.clear();
+        QTRY_COMPARE_WITH_TIMEOUT(shownTextures.size(), CursorFrames, 5000);
+        QCOMPARE(misses, firstMisses);
+        QCOMPARE(textures.size(), firstTextures);
+        QCOMPARE(buffers.size(), firstBuffers);
+    }
+
+private:
+    const QString cursorPath;
+    const QSize outputSize = QSize(200, 200);
+    WServer server;
+    WBackend *backend = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    WOutputRenderWindow window;
+    WCursor *cursor = nullptr;
+    WQuickCursor *cursorItem = nullptr;
+
+    // All the textures and buffers shown since the start
+    QSet<qw_texture*> textures;
+    QSet<qw_buffer*> buffers;
+    // The textures shown in the current loop
+    QSet<qw_texture*> shownTextures;
+    quint64 misses = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    // The theme is created by the test, it must be found before any other
+    QTemporaryDir cursorDir;
+    if (!cursorDir.isValid())
+        qFatal("Failed to create the temporary directory");
+    qputenv("XCURSOR_PATH", QFile::encodeName(cursorDir.path()));
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    QuickCursorTest test(cursorDir.path());
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
@@ -0,0 +1,237 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Resize a RenderBufferBlitter on a headless output rendered by the pixman
+// renderer, and check the buffers of the pool of the window are reused.
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wrenderbufferblitter.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QQuickItem>
+#include <QSGTextureProvider>
+#include <QTest>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+struct PoolStats {
+    qint64 bytesHeld = 0;
+    qint64 bytesInUse = 0;
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+};
+
+class RenderBufferPoolTest : public QObject
+{
+    Q_OBJECT
+public:
+    RenderBufferPoolTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        backend = server.attach<WBackend>();
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+        defaultBudget = window.renderBufferPoolBudget();
+
+        blitter = new WRenderBufferBlitter(window.contentItem());
+        blitter->setPosition(QPointF(20, 20));
+
+        QObject::connect(&window, &WOutputRenderWindow::renderEnd, this, [this] {
+            ++frames;
+        });
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            auto viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+
+        QVERIFY(resizeBlitter(QSize(130, 100)));
+        // The buffer of 130x100 is rounded up to 192x128
+        bytesPerPixel = stats().bytesInUse / (192 * 128);
+        QVERIFY(bytesPerPixel > 0);
+        QCOMPARE(stats().bytesInUse, 192 * 128 * bytesPerPixel);
+    }
+
+    // The node keeps its buffer while its size is in the same bucket
+    void testResizeInBucket()
+    {
+        const auto before = stats();
+        for (int width = 140; width <= 190; width += 10)
+            QVERIFY(resizeBlitter(QSize(width, 100 + width / 10)));
+
+        const auto after = stats();
+        QCOMPARE(after.misses, before.misses);
+        QCOMPARE(after.bytesInUse, before.bytesInUse);
+    }
+
+    // The buffers of the sizes passed by the resize are reused when the node
+    // is resized back to them
+    void testResizeHits()
+    {
+        const QList<int> widths { 60, 120, 180, 240 };
+        for (int width : widths)
+            QVERIFY(resizeBlitter(QSize(width, 60)));
+
+        const auto before = stats();
+        for (int width : widths)
+            QVERIFY(resizeBlitter(QSize(width - 4, 56)));
+
+        const auto after = stats();
+        QCOMPARE(after.misses, before.misses);
+        QCOMPARE(after.hits, before.hits + widths.size());
+        QCOMPARE(after.bytesInUse, 256 * 64 * bytesPerPixel);
+    }
+
+    // The unused buffers exceeding the budget are destroyed, the least
+    // recently used one first
+    void testBudgetEviction()
+    {
+        window.setRenderBufferPoolBudget(0);
+        QVERIFY(resizeBlitter(QSize(60, 300)));
+        QTRY_COMPARE(stats().bytesHeld, stats().bytesInUse);
+
+        window.setRenderBufferPoolBudget(defaultBudget);
+        QVERIFY(resizeBlitter(QSize(120, 300)));
+        QVERIFY(resizeBlitter(QSize(180, 300)));
+
+        // Only the buffer of 64x320 is destroyed, it's the least recently used one
+        const auto before = stats();
+        QCOMPARE(before.bytesHeld, (64 + 128 + 192) * 320 * bytesPerPixel);
+        window.setRenderBufferPoolBudget(before.bytesHeld - 1);
+        QVERIFY(resizeBlitter(QSize(170, 300)));
+        QVERIFY(resizeBlitter(QSize(175, 300)));
+        QTRY_COMPARE(stats().evictions, before.evictions + 1);
+        QCOMPARE(stats().bytesHeld, (128 + 192) * 320 * bytesPerPixel);
+
+        auto last = stats();
+        QVERIFY(resizeBlitter(QSize(120, 300)));
+        QCOMPARE(stats().hits, last.hits + 1);
+        QCOMPARE(stats().misses, last.misses);
+
+        last = stats();
+        QVERIFY(resizeBlitter(QSize(60, 300)));
+        QCOMPARE(stats().misses, last.misses + 1);
+
+        window.setRenderBufferPoolBudget(defaultBudget);
+    }
+
+    // The consumers of the texture provider may sample the whole texture
+    void testExactSizeForTextureProvider()
+    {
+        QVERIFY(blitter->content()->textureProvider());
+        QVERIFY(resizeBlitter(QSize(130, 100)));
+        QCOMPARE(stats().bytesInUse, 130 * 100 * bytesPerPixel);
+    }
+
+private:
+    PoolStats stats() const
+    {
+        const auto map = window.renderBufferPoolStats();
+        PoolStats stats;
+        stats.bytesHeld = map.value("bytesHeld").toLongLong();
+        stats.bytesInUse = map.value("bytesInUse").toLongLong();
+        stats.hits = map.value("hits").toULongLong();
+        stats.misses = map.value("misses").toULongLong();
+        stats.evictions = map.value("evictions").toULongLong();
+        return stats;
+    }
+
+    // Returns after a frame is rendered in the new size
+    bool resizeBlitter(const QSize &size)
+    {
+        const int oldFrames = frames;
+        blitter->setSize(size);
+        return QTest::qWaitFor([&] { return frames > oldFrames; }, 5000);
+    }
+
+    const QSize outputSize = QSize(400, 400);
+    WServer server;
+    WBackend *backend = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    WOutputRenderWindow window;
+    WRenderBufferBlitter *blitter = nullptr;
+    qint64 defaultBudget = 0;
+    qint64 bytesPerPixel = 0;
+    int frames = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    RenderBufferPoolTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
@@ -0,0 +1,124 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <wsgdamagetracker_p.h>
+
+#include <QTest>
+#include <QSGNode>
+#include <QSGSimpleRectNode>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+// A window at (10, 10), the rect node is under a transform node like the
+// nodes of a QQuickItem.
+struct Scene
+{
+    Scene() {
+        root.appendChildNode(transform);
+        transform->appendChildNode(rect);
+    }
+
+    QSGRootNode root;
+    QSGTransformNode *transform = new QSGTransformNode;
+    QSGSimpleRectNode *rect = new QSGSimpleRectNode(QRectF(10, 10, 20, 20), Qt::red);
+};
+
+class SGDamageTrackerTest : public QObject
+{
+    Q_OBJECT
+public:
+    SGDamageTrackerTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void testFirstDamageIsFull()
+    {
+        Scene scene;
+        WSGDamageTracker tracker(&scene.root);
+
+        bool fullDamage = false;
+        tracker.takeDamage(&fullDamage);
+        QVERIFY(fullDamage);
+
+        tracker.takeDamage(&fullDamage);
+        QVERIFY(!fullDamage);
+    }
+
+    // The node existed before the tracker, its removal must damage the area
+    // it used to cover although it's never changed.
+    void testRemoveUnchangedNode()
+    {
+        Scene scene;
+        WSGDamageTracker tracker(&scene.root);
+        bool fullDamage = false;
+        tracker.takeDamage(&fullDamage);
+
+        scene.transform->removeChildNode(scene.rect);
+        delete scene.rect;
+
+        const QRegion damage = tracker.takeDamage(&fullDamage);
+        QVERIFY(!fullDamage);
+        QCOMPARE(damage, QRegion(10, 10, 20, 20));
+    }
+
+    // The first move of a node must damage both the old and the new area
+    void testMoveUnchangedNode()
+    {
+        Scene scene;
+        WSGDamageTracker tracker(&scene.root);
+        bool fullDamage = false;
+        tracker.takeDamage(&fullDamage);
+
+        QMatrix4x4 matrix;
+        matrix.translate(100, 0);
+        scene.transform->setMatrix(matrix);
+
+        const QRegion damage = tracker.takeDamage(&fullDamage);
+        QVERIFY(!fullDamage);
+        QCOMPARE(damage, QRegion(10, 10, 20, 20) + QRegion(110, 10, 20, 20));
+    }
+
+    // The area of the nodes is resynced after a full damage
+    void testRemoveAfterFullDamage()
+    {
+        Scene scene;
+        WSGDamageTracker tracker(&scene.root);
+        bool fullDamage = false;
+        tracker.takeDamage(&fullDamage);
+
+        QMatrix4x4 matrix;
+        matrix.translate(0, 50);
+        scene.transform->setMatrix(matrix);
+        tracker.markFullDamage();
+        tracker.takeDamage(&fullDamage);
+        QVERIFY(fullDamage);
+
+        scene.transform->removeChildNode(scene.rect);
+        delete scene.rect;
+
+        const QRegion damage = tracker.takeDamage(&fullDamage);
+        QVERIFY(!fullDamage);
+        QCOMPARE(damage, QRegion(10, 60, 20, 20));
+    }
+
+    void testChangeColor()
+    {
+        Scene scene;
+        auto other = new QSGSimpleRectNode(QRectF(200, 200, 50, 50), Qt::blue);
+        scene.root.appendChildNode(other);
+        WSGDamageTracker tracker(&scene.root);
+        bool fullDamage = false;
+        tracker.takeDamage(&fullDamage);
+
+        scene.rect->setColor(Qt::green);
+
+        const QRegion damage = tracker.takeDamage(&fullDamage);
+        QVERIFY(!fullDamage);
+        QCOMPARE(damage, QRegion(10, 10, 20, 20));
+    }
+};
+
+QTEST_MAIN(SGDamageTrackerTest)
+#include "main.moc"
@@ -0,0 +1,68 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "client.h"
+
+#include <testclient.h>
+
+#include <vector>
+
+namespace {
+
+struct ClientState
+{
+    bool frameDone = true;
+    std::atomic<int> *frames = nullptr;
+};
+
+void handleFrameDone(void *data, wl_callback *callback, uint32_t)
+{
+    auto state = static_cast<ClientState*>(data);
+    state->frameDone = true;
+    state->frames->fetch_add(1, std::memory_order_relaxed);
+    wl_callback_destroy(callback);
+}
+
+const wl_callback_listener frameListener = {
+    .done = handleFrameDone,
+};
+
+} // namespace
+
+bool runRotatingBuffersClient(const char *socket, int width, int height, int bufferCount,
+                              std::atomic<int> *frames, const std::atomic<bool> &quit)
+{
+    ClientConnection connection;
+    // The address of the buffer is used by the listener, don't resize it
+    std::vector<ShmBuffer> buffers(bufferCount);
+    bool ok = connectClient(socket, &connection) && connection.compositor && connection.shm;
+    for (int i = 0; ok && i < bufferCount; ++i)
+        ok = createShmBuffer(connection.shm, width, height, 0xff000000 | (0x304050 * (i + 1)), &buffers[i]);
+
+    ClientState state;
+    state.frames = frames;
+    wl_surface *surface = ok ? wl_compositor_create_surface(connection.compositor) : nullptr;
+    int next = 0;
+
+    while (ok && !quit.load(std::memory_order_relaxed)) {
+        // Always in the same order, wait for the next one if it's still used
+        if (state.frameDone && !buffers[next].busy) {
+            state.frameDone = false;
+            auto callback = wl_surface_frame(surface);
+            wl_callback_add_listener(callback, &frameListener, &state);
+            commitShmBuffer(surface, &buffers[next]);
+            next = (next + 1) % bufferCount;
+        }
+
+        // Wake up to check the quit even if no events
+        ok = dispatchClientEvents(connection.display, 100);
+    }
+
+    if (surface)
+        wl_surface_destroy(surface);
+    for (auto &buffer : buffers)
+        destroyShmBuffer(&buffer);
+    disconnectClient(&connection);
+
+    return ok;
+}
@@ -0,0 +1,196 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+// Show a shm client committing its wl_buffers in turn on a headless output,
+// and check the texture provider of the surface stops creating the textures
+// after the first cycle of the buffers.
+
+#include "client.h"
+
+#include <WServer>
+#include <WBackend>
+#include <WOutput>
+#include <WSurface>
+#include <wrenderhelper.h>
+#include <woutputrenderwindow.h>
+#include <woutputviewport.h>
+#include <wsurfaceitem.h>
+#include <wsgtextureprovider.h>
+#include <wsocket.h>
+
+#include <qwbackend.h>
+#include <qwoutput.h>
+#include <qwrenderer.h>
+#include <qwallocator.h>
+#include <qwcompositor.h>
+#include <qwdisplay.h>
+#include <qwlogging.h>
+
+#include <QGuiApplication>
+#include <QPointer>
+#include <QThread>
+#include <QTest>
+
+#include <atomic>
+
+extern "C" {
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+}
+
+WAYLIB_SERVER_USE_NAMESPACE
+QW_USE_NAMESPACE
+
+static wlr_backend *findHeadlessBackend(qw_backend *backend)
+{
+    if (wlr_backend_is_headless(backend->handle()))
+        return backend->handle();
+    if (!wlr_backend_is_multi(backend->handle()))
+        return nullptr;
+
+    wlr_backend *headless = nullptr;
+    wlr_multi_for_each_backend(backend->handle(), [] (wlr_backend *backend, void *data) {
+        if (wlr_backend_is_headless(backend))
+            *static_cast<wlr_backend**>(data) = backend;
+    }, &headless);
+
+    return headless;
+}
+
+class TextureProviderTest : public QObject
+{
+    Q_OBJECT
+public:
+    TextureProviderTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        backend = server.attach<WBackend>();
+        socket = new WSocket(false);
+        QVERIFY(socket->autoCreate());
+        server.addSocket(socket);
+        server.start();
+
+        renderer = WRenderHelper::createRenderer(backend->handle());
+        QVERIFY(renderer);
+        allocator = qw_allocator::autocreate(*backend->handle(), *renderer);
+        QVERIFY(allocator);
+        renderer->init_wl_display(*server.handle());
+        compositor = qw_compositor::create(*server.handle(), 6, *renderer);
+        QVERIFY(compositor);
+
+        window.setWidth(outputSize.width());
+        window.setHeight(outputSize.height());
+        window.init(renderer, allocator);
+
+        QObject::connect(compositor, &qw_compositor::notify_new_surface, &window, [this] (wlr_surface *handle) {
+            auto surface = new WSurface(qw_surface::from(handle), &window);
+            content = new WSurfaceItemContent(window.contentItem());
+            content->setSurface(surface);
+            content->setSize(outputSize);
+        });
+
+        QObject::connect(backend, &WBackend::outputAdded, &window, [this] (WOutput *output) {
+            viewport = new WOutputViewport(window.contentItem());
+            viewport->setOutput(output);
+            viewport->setSize(outputSize);
+
+            qw_output_state newState;
+            if (auto mode = output->handle()->preferred_mode())
+                newState.set_mode(mode);
+            newState.set_enabled(true);
+            QVERIFY(output->handle()->commit_state(newState));
+        });
+
+        backend->handle()->start();
+        auto headless = findHeadlessBackend(backend->handle());
+        QVERIFY2(headless, "The headless backend is not found");
+        wlr_headless_add_output(headless, outputSize.width(), outputSize.height());
+        QTRY_VERIFY(viewport);
+
+        const QByteArray socketName = socket->fullServerName().toLocal8Bit();
+        clientThread = QThread::create([this, socketName] {
+            clientOk = runRotatingBuffersClient(socketName.constData(), outputSize.width(),
+                                                outputSize.height(), BufferCount, &frames, quit);
+        });
+        clientThread->start();
+
+        QTRY_VERIFY_WITH_TIMEOUT(content && frames > 0, 10000);
+        // Created by the first rendering of the surface
+        provider = content->wTextureProvider();
+        QVERIFY(provider);
+    }
+
+    void cleanupTestCase()
+    {
+        if (clientThread) {
+            quit = true;
+            // The client only waits for the events of the compositor with a
+            // timeout, it's safe to block the event loop here.
+            QVERIFY(clientThread->wait(5000));
+            delete clientThread;
+            QVERIFY(clientOk);
+        }
+    }
+
+    // Each commit of the client gets a new wlr_client_buffer, but the
+    // textures are kept for its wl_buffers.
+    void testRotatingBuffers()
+    {
+        QVERIFY(BufferCount <= provider->textureCacheSize());
+
+        // The first cycle creates the textures
+        QTRY_VERIFY_WITH_TIMEOUT(frames >= BufferCount * 2, 10000);
+        const quint64 misses = provider->textureCacheMisses();
+        const quint64 hits = provider->textureCacheHits();
+        QVERIFY(misses >= quint64(BufferCount));
+
+        const int startFrames = frames;
+        QTRY_VERIFY_WITH_TIMEOUT(frames >= startFrames + BufferCount * 10, 10000);
+        QCOMPARE(provider->textureCacheMisses(), misses);
+        QVERIFY(provider->textureCacheHits() >= hits + quint64(BufferCount * 10));
+    }
+
+private:
+    static constexpr int BufferCount = 3;
+
+    const QSize outputSize = QSize(320, 240);
+    WServer server;
+    WBackend *backend = nullptr;
+    WSocket *socket = nullptr;
+    qw_renderer *renderer = nullptr;
+    qw_allocator *allocator = nullptr;
+    qw_compositor *compositor = nullptr;
+    WOutputRenderWindow window;
+    WOutputViewport *viewport = nullptr;
+    QPointer<WSurfaceItemContent> content;
+    WSGTextureProvider *provider = nullptr;
+
+    QThread *clientThread = nullptr;
+    std::atomic<bool> quit = false;
+    bool clientOk = false;
+    std::atomic<int> frames = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    qputenv("WLR_BACKENDS", "headless");
+    qputenv("WLR_RENDERER", "pixman");
+    qputenv("WLR_LIBINPUT_NO_DEVICES", "1");
+
+    qw_log::init();
+    WRenderHelper::setupRendererBackend();
+    WServer::initializeQPA();
+
+    QGuiApplication::setQuitOnLastWindowClosed(false);
+    QGuiApplication app(argc, argv);
+
+    TextureProviderTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "main.moc"
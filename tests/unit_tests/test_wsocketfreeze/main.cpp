@@ -0,0 +1,194 @@
+// Copyright (C) 2024 JiDe Zhang <zhangjide@deepin.org>.
+// SPDX-License-Identifier: Apache-2.0 OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include <wsocket.h>
+
+#include <QTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <wayland-server-core.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+WAYLIB_SERVER_USE_NAMESPACE
+
+// A dummy client process, it only connects to the socket and sleeps
+static pid_t spawnClient(const QByteArray &socketPath)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.constData(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        _exit(1);
+
+    for (;;)
+        pause();
+}
+
+static char processState(pid_t pid)
+{
+    QFile file(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    // The state is after the command, which is in parentheses
+    const QByteArray stat = file.readAll();
+    const int index = stat.lastIndexOf(')');
+    return index > 0 && index + 2 < stat.size() ? stat.at(index + 2) : 0;
+}
+
+static bool isCGroupFrozen(pid_t pid)
+{
+    QFile cgroupFile(QStringLiteral("/proc/%1/cgroup").arg(pid));
+    if (!cgroupFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray cgroup;
+    for (const auto &line : cgroupFile.readAll().split('\n')) {
+        if (line.startsWith("0::"))
+            cgroup = line.mid(3);
+    }
+    if (cgroup.isEmpty())
+        return false;
+
+    QFile events(QStringLiteral("/sys/fs/cgroup%1/cgroup.events").arg(QString::fromLocal8Bit(cgroup)));
+    if (!events.open(QIODevice::ReadOnly))
+        return false;
+    return events.readAll().contains("frozen 1");
+}
+
+// Either stopped by the signal or frozen by the cgroup freezer
+static bool isProcessFrozen(pid_t pid)
+{
+    return processState(pid) == 'T' || isCGroupFrozen(pid);
+}
+
+class SocketFreezeTest : public QObject
+{
+    Q_OBJECT
+public:
+    SocketFreezeTest(QObject *parent = nullptr)
+        : QObject(parent)
+    {
+    }
+
+private Q_SLOTS:
+    void init()
+    {
+        QVERIFY(tmpDir.isValid());
+        display = wl_display_create();
+        QVERIFY(display);
+    }
+
+    void cleanup()
+    {
+        for (pid_t pid : std::as_const(children)) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        children.clear();
+
+        delete socket;
+        socket = nullptr;
+        wl_display_destroy(display);
+        display = nullptr;
+    }
+
+    void testFreezeAndActivate()
+    {
+        WClient *client = connectClient(true);
+        QVERIFY(client);
+        const pid_t pid = client->credentials()->pid;
+        QCOMPARE(pid, children.first());
+        QVERIFY(!client->isFrozen());
+
+        client->freeze();
+        QVERIFY(client->isFrozen());
+        QTRY_VERIFY(isProcessFrozen(pid));
+
+        client->activate();
+        QVERIFY(!client->isFrozen());
+        QTRY_VERIFY(!isProcessFrozen(pid));
+    }
+
+    void testFreezeByDisableSocket()
+    {
+        WClient *client = connectClient(true);
+        QVERIFY(client);
+        const pid_t pid = client->credentials()->pid;
+
+        socket->setEnabled(false);
+        QVERIFY(client->isFrozen());
+        QTRY_VERIFY(isProcessFrozen(pid));
+
+        socket->setEnabled(true);
+        QVERIFY(!client->isFrozen());
+        QTRY_VERIFY(!isProcessFrozen(pid));
+    }
+
+    void testFreezeNewClientOfDisabledSocket()
+    {
+        QVERIFY(createSocket(true));
+        socket->setEnabled(false);
+
+        WClient *client = acceptClient();
+        QVERIFY(client);
+        QVERIFY(client->isFrozen());
+        QTRY_VERIFY(isProcessFrozen(client->credentials()->pid));
+    }
+
+    void testDontFreeze()
+    {
+        WClient *client = connectClient(false);
+        QVERIFY(client);
+
+        socket->setEnabled(false);
+        QVERIFY(!client->isFrozen());
+        QVERIFY(!isProcessFrozen(client->credentials()->pid));
+    }
+
+private:
+    bool createSocket(bool freezeClientWhenDisable) {
+        socket = new WSocket(freezeClientWhenDisable);
+        return socket->create(tmpDir.filePath(QStringLiteral("wayland-test-%1").arg(++socketIndex)))
+            && socket->listen(display);
+    }
+
+    WClient *acceptClient() {
+        const pid_t pid = spawnClient(QFile::encodeName(socket->fullServerName()));
+        if (pid < 0)
+            return nullptr;
+        children.append(pid);
+
+        auto loop = wl_display_get_event_loop(display);
+        for (int i = 0; i < 50 && socket->clients().isEmpty(); ++i)
+            wl_event_loop_dispatch(loop, 100);
+
+        return socket->clients().value(0);
+    }
+
+    WClient *connectClient(bool freezeClientWhenDisable) {
+        if (!createSocket(freezeClientWhenDisable))
+            return nullptr;
+        return acceptClient();
+    }
+
+    QTemporaryDir tmpDir;
+    int socketIndex = 0;
+    wl_display *display = nullptr;
+    WSocket *socket = nullptr;
+    QList<pid_t> children;
+};
+
+QTEST_MAIN(SocketFreezeTest)
+#include "main.moc"